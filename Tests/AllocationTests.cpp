@@ -0,0 +1,200 @@
+#include <cstdint>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+// This executable installs the counting operator new
+#define XT_ALLOCATION_HOOKS
+#include "AllocationCounter.h"
+#include "FrameArena.h"
+#include "Test.h"
+
+static bool IsAligned(const void* ptr, const size_t alignment)
+{
+	return reinterpret_cast<uintptr_t>(ptr) % alignment == 0;
+}
+
+static void TestAllocationScope()
+{
+	XT_CHECK(AllocationCounter::IsEnabled());
+	{
+		AllocationScope scope;
+		const auto array = new int[10];
+		delete[] array;
+		const auto delta = scope.GetDelta();
+		XT_CHECK(delta.count == 1 && delta.bytes == 10 * sizeof(int) && delta.frees == 1);
+	}
+
+	// Nested scopes, the outer one includes the inner ones and totals accumulate
+	AllocationStats total;
+	AllocationScope outer;
+	{
+		AllocationScope inner(total);
+		std::vector<int> values(100);
+	}
+	{
+		AllocationScope inner(total);
+		std::vector<int> values(50);
+	}
+	XT_CHECK(total.count == 2 && total.bytes == 150 * sizeof(int) && total.frees == 2);
+	outer.Stop();
+	XT_CHECK(outer.GetDelta().count == 2);
+	std::vector<int> after(10);
+	XT_CHECK(outer.GetDelta().count == 2);
+
+	// Counters are process wide, pool threads count too
+	AllocationScope threads;
+	std::thread worker([] { std::vector<char> scratch(1000); });
+	worker.join();
+	XT_CHECK(threads.GetDelta().bytes >= 1000);
+}
+
+static void TestFrameAllocationTracker()
+{
+	FrameAllocationTracker tracker(3);
+	std::vector<std::vector<int>> kept;
+	for (auto frame = 0; frame < 10; ++frame)
+	{
+		tracker.BeginFrame();
+		// Warm-up frames allocate, later ones only on frame 7
+		if (frame < 3 || frame == 7)
+		{
+			kept.emplace_back(16);
+			kept.emplace_back(16);
+		}
+		tracker.EndFrame();
+
+		XT_CHECK(tracker.LastFrameAllocated() == (frame == 7));
+		if (frame == 7)
+			XT_CHECK(tracker.GetLastFrame().count >= 2);
+		else if (frame > 3)
+			XT_CHECK(tracker.GetLastFrame().count == 0);
+	}
+	XT_CHECK(tracker.GetFrameCount() == 10);
+	XT_CHECK(tracker.GetAllocatingFrames() == 1 && !tracker.IsSteadyStateClean());
+}
+
+static void TestArenaAlignment()
+{
+	FrameArena arena(4096);
+	std::vector<std::pair<uint8_t*, size_t>> allocations;
+	for (size_t alignment = 1; alignment <= 64; alignment *= 2)
+	{
+		for (const size_t bytes : {1, 3, 17, 100})
+		{
+			const auto ptr = static_cast<uint8_t*>(arena.Allocate(bytes, alignment));
+			XT_CHECK(IsAligned(ptr, alignment));
+			std::memset(ptr, static_cast<int>(allocations.size()), bytes);
+			allocations.emplace_back(ptr, bytes);
+		}
+	}
+	XT_CHECK(IsAligned(arena.Allocate(8), alignof(std::max_align_t)));
+	XT_CHECK(IsAligned(arena.AllocateArray<double>(3), alignof(double)));
+
+	// Nothing overlaps, every allocation still holds its own pattern
+	for (size_t i = 0; i < allocations.size(); ++i)
+		for (size_t b = 0; b < allocations[i].second; ++b)
+			XT_CHECK(allocations[i].first[b] == static_cast<uint8_t>(i));
+}
+
+static void TestArenaReset()
+{
+	FrameArena arena(4096);
+	const auto first = arena.Allocate(100, 64);
+	arena.Allocate(200);
+	XT_CHECK(arena.GetUsed() >= 300);
+
+	arena.Reset();
+	XT_CHECK(arena.GetUsed() == 0 && arena.GetPeak() >= 300);
+	XT_CHECK(arena.Allocate(100, 64) == first);
+
+	// Deallocate only takes back the most recent allocation
+	const auto a = arena.Allocate(32, 1);
+	const auto b = arena.Allocate(32, 1);
+	const auto used = arena.GetUsed();
+	arena.Deallocate(a, 32);
+	XT_CHECK(arena.GetUsed() == used);
+	arena.Deallocate(b, 32);
+	XT_CHECK(arena.GetUsed() == used - 32);
+	XT_CHECK(arena.Allocate(32, 1) == b);
+
+	// Rewinding through a marker and a scope
+	const auto marker = arena.GetMarker();
+	const auto usedAtMarker = arena.GetUsed();
+	arena.Allocate(1000);
+	arena.Rewind(marker);
+	XT_CHECK(arena.GetUsed() == usedAtMarker);
+	{
+		FrameArenaScope scope(arena);
+		arena.Allocate(5000);
+		XT_CHECK(arena.GetBlockCount() == 2);
+	}
+	XT_CHECK(arena.GetUsed() == usedAtMarker);
+}
+
+static void TestArenaOverflow()
+{
+	FrameArena arena(4096);
+	const auto capacity = arena.GetCapacity();
+
+	// Overflowing the block chains a new one, larger than the block size when the request is
+	const auto a = static_cast<uint8_t*>(arena.Allocate(3000));
+	const auto b = static_cast<uint8_t*>(arena.Allocate(3000));
+	const auto c = static_cast<uint8_t*>(arena.Allocate(10000, 64));
+	XT_CHECK(arena.GetBlockCount() == 3);
+	XT_CHECK(IsAligned(c, 64));
+	std::memset(a, 1, 3000);
+	std::memset(b, 2, 3000);
+	std::memset(c, 3, 10000);
+	XT_CHECK(a[2999] == 1 && b[0] == 2 && b[2999] == 2 && c[9999] == 3);
+	const auto peak = arena.GetUsed();
+	XT_CHECK(peak >= 16000);
+
+	// Reset merges the chain into one block that holds the whole frame next time
+	arena.Reset();
+	XT_CHECK(arena.GetBlockCount() == 1 && arena.GetCapacity() >= peak && arena.GetCapacity() > capacity);
+	const auto merged = arena.GetCapacity();
+	for (auto frame = 0; frame < 3; ++frame)
+	{
+		arena.Allocate(3000);
+		arena.Allocate(3000);
+		arena.Allocate(10000, 64);
+		XT_CHECK(arena.GetBlockCount() == 1);
+		arena.Reset();
+	}
+	XT_CHECK(arena.GetCapacity() == merged && arena.GetPeak() >= peak);
+}
+
+// A steady-state frame of arena containers never reaches the heap
+static void TestArenaSteadyState()
+{
+	FrameArena arena(256);
+	FrameAllocationTracker tracker(2);
+	for (auto frame = 0; frame < 20; ++frame)
+	{
+		tracker.BeginFrame();
+		arena.Reset();
+		FrameVector<int> values{ArenaAllocator<int>(arena)};
+		for (auto i = 0; i < 1000; ++i)
+			values.push_back(i);
+		FrameString text{ArenaAllocator<char>(arena)};
+		text = "longer than any small string buffer, so it needs the allocator";
+		FrameVector<FrameVector<int>> nested{ArenaAllocator<FrameVector<int>>(arena)};
+		nested.emplace_back(100, 7, ArenaAllocator<int>(arena));
+		XT_CHECK(values[999] == 999 && text.size() > 40 && nested[0][99] == 7);
+		tracker.EndFrame();
+	}
+	XT_CHECK(tracker.IsSteadyStateClean());
+	XT_CHECK(arena.GetBlockCount() == 1);
+}
+
+int main()
+{
+	TestAllocationScope();
+	TestFrameAllocationTracker();
+	TestArenaAlignment();
+	TestArenaReset();
+	TestArenaOverflow();
+	TestArenaSteadyState();
+	return Test::Finish("AllocationTests");
+}
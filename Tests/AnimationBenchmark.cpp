@@ -0,0 +1,61 @@
+#include <cstdio>
+#include <vector>
+
+#include "Benchmark.h"
+#include "CharacterScene.h"
+#include "Test.h"
+
+// Characters per millisecond for animation (two clip blend, 64 bones) and CPU skinning (6000 vertices)
+// at every SIMD level, on the default pool
+int main()
+{
+	CharacterScene scene(6000, 3);
+	const auto boneCount = CharacterScene::BoneCount;
+	const Skeleton skeleton(scene.parents, scene.bindPose);
+	const AnimationClip walk(boneCount, CharacterScene::FrameCount, 30.f, scene.walkFrames.data());
+	const AnimationClip run(boneCount, CharacterScene::FrameCount, 30.f, scene.runFrames.data());
+	const Animator animator(skeleton);
+
+	const size_t characters = 256;
+	std::vector<Float4x4> palettes(characters * boneCount);
+	std::vector<AnimationJob> jobs(characters);
+	for (size_t c = 0; c < characters; ++c)
+	{
+		jobs[c].clip = &walk;
+		jobs[c].time = 0.013f * c;
+		jobs[c].blendClip = &run;
+		jobs[c].blendTime = 0.007f * c;
+		jobs[c].blendWeight = (c % 5) / 4.f;
+		jobs[c].palette = &palettes[c * boneCount];
+	}
+
+	using Vertex = CharacterScene::Vertex;
+	const auto& mesh = scene.mesh;
+	std::vector<float> skinned(mesh.size() * 3);
+
+	std::printf("AnimationBenchmark: %zu characters, %zu bones, %zu vertices, %zu threads, clip %zu of %zu key bytes\n",
+	            characters, static_cast<size_t>(boneCount), mesh.size(), ThreadPool::GetDefault().GetThreadCount(),
+	            walk.GetKeyBytes(), CharacterScene::FrameCount * boneCount * sizeof(BoneTransform));
+	Test::ForEachLevel([&](const SimdLevel level)
+	{
+		const auto animate = Benchmark::Time([&]
+		{
+			for (auto& job : jobs)
+				job.time += 0.016f;
+			animator.Evaluate(jobs.data(), characters);
+		});
+
+		size_t character = 0;
+		const auto skin = Benchmark::Time([&]
+		{
+			Skinning::SkinPositions(mesh[0].position, sizeof(Vertex), &mesh[0].skin, sizeof(Vertex), mesh.size(),
+			                        &palettes[(character++ % characters) * boneCount], skinned.data(), 3 * sizeof(float));
+		});
+		Benchmark::Use(skinned[0]);
+
+		const auto perCharacter = animate / characters + skin;
+		std::printf("  %-7s animate %8.1f chars/ms, skin %6.2f chars/ms, both %6.2f chars/ms\n", Test::LevelName(level),
+		            characters / animate * 1e-3, 1e-3 / skin, 1e-3 / perCharacter);
+	});
+	return 0;
+}
@@ -0,0 +1,272 @@
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "CharacterScene.h"
+#include "Test.h"
+
+// Largest component difference, q and -q are the same rotation
+static float RotationDistance(const Float4& a, const Float4& b)
+{
+	const auto sign = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w < 0.f ? -1.f : 1.f;
+	return std::max(std::max(std::fabs(a.x - sign * b.x), std::fabs(a.y - sign * b.y)),
+	                std::max(std::fabs(a.z - sign * b.z), std::fabs(a.w - sign * b.w)));
+}
+
+static float TransformDistance(const BoneTransform& a, const BoneTransform& b)
+{
+	return std::max({RotationDistance(a.rotation, b.rotation), std::fabs(a.translation.x - b.translation.x),
+	                 std::fabs(a.translation.y - b.translation.y), std::fabs(a.translation.z - b.translation.z),
+	                 std::fabs(a.scale - b.scale)});
+}
+
+// nlerp over the shorter arc in double precision
+static BoneTransform ReferenceBlend(const BoneTransform& a, const BoneTransform& b, const double weight)
+{
+	const double qa[4] = {a.rotation.x, a.rotation.y, a.rotation.z, a.rotation.w};
+	const double qb[4] = {b.rotation.x, b.rotation.y, b.rotation.z, b.rotation.w};
+	const auto sign = qa[0] * qb[0] + qa[1] * qb[1] + qa[2] * qb[2] + qa[3] * qb[3] < 0.0 ? -1.0 : 1.0;
+	double q[4], length = 0.0;
+	for (auto i = 0; i < 4; ++i)
+	{
+		q[i] = qa[i] + (sign * qb[i] - qa[i]) * weight;
+		length += q[i] * q[i];
+	}
+	length = std::sqrt(length);
+	const auto lerp = [weight](const double x, const double y) { return static_cast<float>(x + (y - x) * weight); };
+
+	BoneTransform result;
+	result.rotation = Float4{static_cast<float>(q[0] / length), static_cast<float>(q[1] / length),
+	                         static_cast<float>(q[2] / length), static_cast<float>(q[3] / length)};
+	result.translation = Float3{lerp(a.translation.x, b.translation.x), lerp(a.translation.y, b.translation.y),
+	                            lerp(a.translation.z, b.translation.z)};
+	result.scale = lerp(a.scale, b.scale);
+	return result;
+}
+
+static void TestQuantization()
+{
+	CharacterScene scene(0, 3);
+	auto error = 0.f;
+	for (auto i = 0; i < 100000; ++i)
+	{
+		Float4 q{scene.Next(), scene.Next(), scene.Next(), scene.Next()};
+		const auto length = std::sqrt(q.x * q.x + q.y * q.y + q.z * q.z + q.w * q.w);
+		if (length < 1e-3f)
+			continue;
+		q = Float4{q.x / length, q.y / length, q.z / length, q.w / length};
+		error = std::max(error, RotationDistance(q, QuantizedQuaternion::Encode(q).Decode()));
+	}
+	XT_CHECK(error < 7e-5f);
+
+	// Each axis and its negation, the dropped component is rebuilt positive
+	const Float4 axes[] = {{1.f, 0.f, 0.f, 0.f}, {0.f, -1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}, {0.f, 0.f, 0.f, -1.f}};
+	for (const auto& axis : axes)
+		XT_CHECK(RotationDistance(axis, QuantizedQuaternion::Encode(axis).Decode()) < 7e-5f);
+}
+
+static void TestSampling()
+{
+	const CharacterScene scene(0, 3);
+	const auto boneCount = CharacterScene::BoneCount, frameCount = CharacterScene::FrameCount;
+	const AnimationClip walk(boneCount, frameCount, 30.f, scene.walkFrames.data());
+	XT_CHECK_NEAR(walk.GetDuration(), 2.0, 1e-6);
+	XT_CHECK(walk.GetKeyBytes() < frameCount * boneCount * sizeof(BoneTransform) / 2);
+
+	std::vector<BoneTransform> pose(boneCount);
+	auto decodeError = 0.f;
+	for (size_t frame = 0; frame < frameCount; ++frame)
+	{
+		walk.Decode(frame, pose.data());
+		for (size_t bone = 0; bone < boneCount; ++bone)
+			decodeError = std::max(decodeError, TransformDistance(pose[bone], scene.walkFrames[frame * boneCount + bone]));
+	}
+	XT_CHECK(decodeError < 7e-5f);
+
+	// Looping wraps negative and late times, a clamped clip holds its last frame
+	Test::ForEachLevel([&](const SimdLevel)
+	{
+		auto error = 0.f;
+		for (const auto time : {0.f, 0.37f, 1.f, 1.9999f, 2.f, 2.5f, -0.3f, 13.31f})
+		{
+			walk.Sample(time, pose.data());
+			auto wrapped = std::fmod(time, 2.f);
+			wrapped = wrapped < 0.f ? wrapped + 2.f : wrapped;
+			const auto position = wrapped * 30.f;
+			const auto frame0 = std::min(static_cast<size_t>(position), frameCount - 1);
+			const auto frame1 = std::min(frame0 + 1, frameCount - 1);
+			for (size_t bone = 0; bone < boneCount; ++bone)
+			{
+				const auto expected = ReferenceBlend(scene.walkFrames[frame0 * boneCount + bone],
+				                                     scene.walkFrames[frame1 * boneCount + bone], position - frame0);
+				error = std::max(error, TransformDistance(pose[bone], expected));
+			}
+		}
+		XT_CHECK(error < 1e-4f);
+
+		walk.Sample(5.f, pose.data(), false);
+		auto clampError = 0.f;
+		for (size_t bone = 0; bone < boneCount; ++bone)
+			clampError = std::max(clampError, TransformDistance(pose[bone], scene.walkFrames[(frameCount - 1) * boneCount + bone]));
+		XT_CHECK(clampError < 7e-5f);
+	});
+}
+
+// BlendPoses at every level returns the scalar bits, odd counts and in place output included
+static void TestBlend()
+{
+	const CharacterScene scene(0, 3);
+	const auto boneCount = CharacterScene::BoneCount;
+	const AnimationClip walk(boneCount, CharacterScene::FrameCount, 30.f, scene.walkFrames.data());
+	const AnimationClip run(boneCount, CharacterScene::FrameCount, 30.f, scene.runFrames.data());
+	std::vector<BoneTransform> a(boneCount), b(boneCount);
+	walk.Sample(0.4f, a.data());
+	run.Sample(1.3f, b.data());
+	// Opposite hemispheres force the shorter arc flip
+	b[3].rotation = Float4{-a[3].rotation.x, -a[3].rotation.y, -a[3].rotation.z, -a[3].rotation.w};
+
+	for (const auto weight : {0.f, 0.3f, 1.f})
+	{
+		std::vector<std::vector<BoneTransform>> results;
+		Test::ForEachLevel([&](const SimdLevel)
+		{
+			std::vector<BoneTransform> out(boneCount);
+			AnimationClip::BlendPoses(a.data(), b.data(), weight, out.data(), boneCount - 1);
+			auto inPlace = a;
+			AnimationClip::BlendPoses(inPlace.data(), b.data(), weight, inPlace.data(), boneCount - 1);
+			XT_CHECK(std::memcmp(inPlace.data(), out.data(), (boneCount - 1) * sizeof(BoneTransform)) == 0);
+			results.push_back(out);
+		});
+		for (const auto& result : results)
+			XT_CHECK(std::memcmp(result.data(), results[0].data(), boneCount * sizeof(BoneTransform)) == 0);
+
+		auto error = 0.f;
+		for (size_t bone = 0; bone + 1 < boneCount; ++bone)
+			error = std::max(error, TransformDistance(results[0][bone], ReferenceBlend(a[bone], b[bone], weight)));
+		XT_CHECK(error < 1e-6f);
+	}
+}
+
+// The bind pose palette is the identity, jobs give the same palettes on any pool, and the palette of a
+// blended job matches one composed by hand
+static void TestAnimator()
+{
+	const CharacterScene scene(0, 3);
+	const auto boneCount = CharacterScene::BoneCount;
+	const Skeleton skeleton(scene.parents, scene.bindPose);
+	const AnimationClip walk(boneCount, CharacterScene::FrameCount, 30.f, scene.walkFrames.data());
+	const AnimationClip run(boneCount, CharacterScene::FrameCount, 30.f, scene.runFrames.data());
+
+	std::vector<Float4x4> model(boneCount), palette(boneCount);
+	skeleton.LocalToModel(scene.bindPose.data(), model.data());
+	skeleton.ModelToPalette(model.data(), palette.data());
+	auto identityError = 0.f;
+	const auto identity = VectorMath::Identity();
+	for (const auto& matrix : palette)
+		for (auto i = 0; i < 16; ++i)
+			identityError = std::max(identityError, std::fabs(matrix.Data()[i] - identity.Data()[i]));
+	XT_CHECK(identityError < 1e-4f);
+
+	const size_t characters = 40;
+	std::vector<AnimationJob> jobs(characters);
+	std::vector<Float4x4> single(characters * boneCount), four(characters * boneCount);
+	for (size_t c = 0; c < characters; ++c)
+	{
+		jobs[c].clip = &walk;
+		jobs[c].time = 0.013f * c;
+		jobs[c].blendClip = &run;
+		jobs[c].blendTime = 0.007f * c;
+		jobs[c].blendWeight = (c % 5) / 4.f;
+	}
+
+	ThreadPool onePool(1), fourPool(4);
+	for (auto* pool : {&onePool, &fourPool})
+	{
+		auto& palettes = pool == &onePool ? single : four;
+		for (size_t c = 0; c < characters; ++c)
+			jobs[c].palette = &palettes[c * boneCount];
+		Animator(skeleton, *pool).Evaluate(jobs.data(), characters);
+	}
+	XT_CHECK(std::memcmp(single.data(), four.data(), single.size() * sizeof(Float4x4)) == 0);
+
+	const auto& job = jobs[7];
+	std::vector<BoneTransform> a(boneCount), b(boneCount);
+	walk.Sample(job.time, a.data());
+	run.Sample(job.blendTime, b.data());
+	for (size_t bone = 0; bone < boneCount; ++bone)
+		a[bone] = ReferenceBlend(a[bone], b[bone], job.blendWeight);
+	skeleton.LocalToModel(a.data(), model.data());
+	auto paletteError = 0.f;
+	for (size_t bone = 0; bone < boneCount; ++bone)
+	{
+		const auto expected = VectorMath::Multiply(skeleton.GetInverseBind()[bone], model[bone]);
+		for (auto i = 0; i < 16; ++i)
+			paletteError = std::max(paletteError, std::fabs(expected.Data()[i] - single[7 * boneCount + bone].Data()[i]));
+	}
+	XT_CHECK(paletteError < 1e-4f);
+}
+
+// SkinPositions at every level returns the scalar bits for strided and in place output,
+// and the scalar result matches a double precision reference
+static void TestSkinning()
+{
+	const CharacterScene scene(1001, 5);
+	const auto boneCount = CharacterScene::BoneCount;
+	const Skeleton skeleton(scene.parents, scene.bindPose);
+	const AnimationClip walk(boneCount, CharacterScene::FrameCount, 30.f, scene.walkFrames.data());
+	std::vector<Float4x4> palette(boneCount);
+	AnimationJob job;
+	job.clip = &walk;
+	job.time = 0.77f;
+	job.palette = palette.data();
+	Animator(skeleton).Evaluate(job);
+
+	const auto& mesh = scene.mesh;
+	const auto count = mesh.size();
+	using Vertex = CharacterScene::Vertex;
+	std::vector<std::vector<float>> results;
+	Test::ForEachLevel([&](const SimdLevel)
+	{
+		std::vector<float> out(count * 3);
+		Skinning::SkinPositions(mesh[0].position, sizeof(Vertex), &mesh[0].skin, sizeof(Vertex), count, palette.data(),
+		                        out.data(), 3 * sizeof(float));
+		auto inPlace = mesh;
+		Skinning::SkinPositions(inPlace[0].position, sizeof(Vertex), &inPlace[0].skin, sizeof(Vertex), count,
+		                        palette.data(), inPlace[0].position, sizeof(Vertex));
+		for (size_t i = 0; i < count; ++i)
+			XT_CHECK(std::memcmp(inPlace[i].position, &out[i * 3], 3 * sizeof(float)) == 0);
+		results.push_back(out);
+	});
+	for (const auto& result : results)
+		XT_CHECK(result == results[0]);
+
+	auto error = 0.0;
+	for (size_t i = 0; i < count; ++i)
+	{
+		double expected[3] = {};
+		for (auto k = 0; k < 4; ++k)
+		{
+			const auto& bone = palette[mesh[i].skin.bones[k]];
+			const auto* p = mesh[i].position;
+			for (auto column = 0; column < 3; ++column)
+			{
+				expected[column] += mesh[i].skin.weights[k] *
+					(double{p[0]} * bone.m[0][column] + double{p[1]} * bone.m[1][column] +
+					 double{p[2]} * bone.m[2][column] + bone.m[3][column]);
+			}
+		}
+		for (auto column = 0; column < 3; ++column)
+			error = std::max(error, std::fabs(expected[column] - results[0][i * 3 + column]));
+	}
+	XT_CHECK(error < 1e-4);
+}
+
+int main()
+{
+	TestQuantization();
+	TestSampling();
+	TestBlend();
+	TestAnimator();
+	TestSkinning();
+	return Test::Finish("AnimationTests");
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+
+// Timing for the benchmark executables
+struct Benchmark
+{
+	Benchmark() = delete;
+
+	// Seconds per call of func, after one warm-up call, over enough calls to run for at least minSeconds
+	template <class Func>
+	static double Time(Func&& func, const double minSeconds = 0.25)
+	{
+		func();
+		size_t calls = 0;
+		const auto start = Clock::now();
+		double elapsed = 0.0;
+		do
+		{
+			func();
+			++calls;
+			elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+		} while (elapsed < minSeconds);
+		return elapsed / static_cast<double>(calls);
+	}
+
+	// Keeps the compiler from dropping a computation whose result is otherwise unused
+	template <class T>
+	static void Use(const T& value)
+	{
+		static volatile char sink;
+		sink = *reinterpret_cast<const volatile char*>(&value);
+		static_cast<void>(sink);
+	}
+
+private:
+	using Clock = std::chrono::steady_clock;
+};
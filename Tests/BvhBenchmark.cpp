@@ -0,0 +1,157 @@
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "DynamicBvh.h"
+#include "MeshBvh.h"
+
+struct Vertex
+{
+	float position[3];
+	float color[4];
+};
+
+static float RayEntry(const Ray& ray, const float* inverse, const Aabb& box, const float maxT)
+{
+	auto tNear = 0.f, tFar = maxT;
+	for (auto axis = 0; axis < 3; ++axis)
+	{
+		const auto t0 = (box.min[axis] - ray.origin[axis]) * inverse[axis];
+		const auto t1 = (box.max[axis] - ray.origin[axis]) * inverse[axis];
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+	}
+	return tNear <= tFar ? tNear : -1.f;
+}
+
+// Build time and query throughput of a 100k triangle MeshBvh and a 10k proxy DynamicBvh,
+// the dynamic tree both flattened into a Bvh4 and stale, against brute force
+int main()
+{
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> unit(-1.f, 1.f);
+	const auto next = [&] { return unit(random); };
+
+	const size_t triangleCount = 100000;
+	std::vector<Vertex> vertices;
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		const float center[3] = {next() * 50.f, next() * 50.f, next() * 50.f};
+		for (auto corner = 0; corner < 3; ++corner)
+			vertices.push_back(Vertex{{center[0] + next(), center[1] + next(), center[2] + next()}, {}});
+	}
+
+	std::vector<Ray> rays(100000);
+	for (auto& ray : rays)
+		ray = Ray{{next() * 60.f, next() * 60.f, next() * 60.f}, {next(), next(), next()}, 1000.f};
+	std::vector<Aabb> queries(100000);
+	for (auto& query : queries)
+	{
+		const float center[3] = {next() * 50.f, next() * 50.f, next() * 50.f};
+		query = Aabb{{center[0] - 1.f, center[1] - 1.f, center[2] - 1.f}, {center[0] + 1.f, center[1] + 1.f, center[2] + 1.f}};
+	}
+
+	std::printf("BvhBenchmark:\n");
+	MeshBvh mesh;
+	const auto build = Benchmark::Time([&] { mesh.Build(vertices[0].position, sizeof(Vertex), vertices.size(), nullptr, 0); });
+	std::printf("  MeshBvh build     %zu triangles %8.2f ms\n", triangleCount, build * 1e3);
+
+	size_t hits = 0;
+	const auto meshRays = Benchmark::Time([&]
+	{
+		for (const auto& ray : rays)
+		{
+			MeshHit hit;
+			hits += mesh.Raycast(ray, hit) ? 1 : 0;
+		}
+	});
+	size_t found = 0;
+	const auto meshQueries = Benchmark::Time([&]
+	{
+		for (const auto& query : queries)
+			mesh.Query(query, [&](uint32_t) { ++found; });
+	});
+	Benchmark::Use(hits);
+	Benchmark::Use(found);
+	std::printf("  MeshBvh raycast   %8.2f Mrays/s\n", rays.size() / meshRays * 1e-6);
+	std::printf("  MeshBvh query     %8.2f Mqueries/s\n", queries.size() / meshQueries * 1e-6);
+
+	const size_t proxyCount = 10000;
+	DynamicBvh tree(0.1f);
+	std::vector<Aabb> boxes;
+	std::vector<DynamicBvh::ProxyId> ids;
+	const auto randomBox = [&]
+	{
+		const float center[3] = {next() * 100.f, next() * 100.f, next() * 100.f};
+		const auto extent = std::fabs(next()) + 0.05f;
+		return Aabb{{center[0] - extent, center[1] - extent, center[2] - extent},
+		            {center[0] + extent, center[1] + extent, center[2] + extent}};
+	};
+	for (size_t i = 0; i < proxyCount; ++i)
+	{
+		boxes.push_back(randomBox());
+		ids.push_back(tree.Insert(boxes[i], reinterpret_cast<void*>(uintptr_t{i})));
+	}
+	std::printf("  DynamicBvh        %zu proxies, height %d, area ratio %.1f\n", proxyCount, tree.GetHeight(),
+	            tree.GetAreaRatio());
+
+	// One frame of coherent motion: every proxy drifts and is moved, then the snapshot is rebuilt
+	const auto update = Benchmark::Time([&]
+	{
+		for (size_t i = 0; i < proxyCount; ++i)
+		{
+			const float delta[3] = {next() * 0.05f, next() * 0.05f, next() * 0.05f};
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				boxes[i].min[axis] += delta[axis];
+				boxes[i].max[axis] += delta[axis];
+			}
+			tree.Move(ids[i], boxes[i]);
+		}
+		tree.Flatten();
+	});
+	std::printf("  DynamicBvh update %8.2f ms/frame (move all + flatten)\n", update * 1e3);
+
+	for (const auto flattened : {true, false})
+	{
+		if (flattened)
+			tree.Flatten();
+		else
+			tree.Refit(ids[0], boxes[0]);
+
+		const auto raySeconds = Benchmark::Time([&]
+		{
+			for (const auto& ray : rays)
+			{
+				float inverse[3];
+				ray.InverseDirection(inverse);
+				tree.Raycast(ray, [&](const DynamicBvh::ProxyId id, const float maxT)
+				{
+					return RayEntry(ray, inverse, boxes[reinterpret_cast<uintptr_t>(tree.GetUserData(id))], maxT);
+				});
+			}
+		});
+		const auto querySeconds = Benchmark::Time([&]
+		{
+			for (const auto& query : queries)
+				tree.Query(query, [&](DynamicBvh::ProxyId) { ++found; });
+		});
+		const auto name = flattened ? "Bvh4  " : "binary";
+		std::printf("  DynamicBvh %s raycast %8.2f Mrays/s\n", name, rays.size() / raySeconds * 1e-6);
+		std::printf("  DynamicBvh %s query   %8.2f Mqueries/s\n", name, queries.size() / querySeconds * 1e-6);
+	}
+
+	const size_t bruteCount = 1000;
+	const auto brute = Benchmark::Time([&]
+	{
+		for (size_t q = 0; q < bruteCount; ++q)
+			for (const auto& box : boxes)
+				found += box.Overlaps(queries[q]) ? 1 : 0;
+	});
+	Benchmark::Use(found);
+	std::printf("  brute force query        %8.3f Mqueries/s\n", bruteCount / brute * 1e-6);
+	return 0;
+}
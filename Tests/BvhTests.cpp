@@ -0,0 +1,355 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <random>
+#include <set>
+#include <vector>
+
+#include "DynamicBvh.h"
+#include "MeshBvh.h"
+#include "Test.h"
+
+// Entry distance of the ray segment into box, negative on a miss, the same slab test as Aabb::IntersectRay
+static float RayEntry(const Ray& ray, const Aabb& box, const float maxT)
+{
+	float inverse[3];
+	ray.InverseDirection(inverse);
+	auto tNear = 0.f, tFar = maxT;
+	for (auto axis = 0; axis < 3; ++axis)
+	{
+		const auto t0 = (box.min[axis] - ray.origin[axis]) * inverse[axis];
+		const auto t1 = (box.max[axis] - ray.origin[axis]) * inverse[axis];
+		tNear = std::max(tNear, std::min(t0, t1));
+		tFar = std::min(tFar, std::max(t0, t1));
+	}
+	return tNear <= tFar ? tNear : -1.f;
+}
+
+// Moller-Trumbore over the original vertices, accepting both windings like MeshBvh
+static bool RayTriangle(const float* a, const float* b, const float* c, const Ray& ray, float& t)
+{
+	float e1[3], e2[3];
+	for (auto i = 0; i < 3; ++i)
+	{
+		e1[i] = b[i] - a[i];
+		e2[i] = c[i] - a[i];
+	}
+	const auto* d = ray.direction;
+	const float p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+	const auto det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+	if (std::fabs(det) < 1e-12f)
+		return false;
+	const auto invDet = 1.f / det;
+	const float s[3] = {ray.origin[0] - a[0], ray.origin[1] - a[1], ray.origin[2] - a[2]};
+	const auto u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+	if (u < 0.f || u > 1.f)
+		return false;
+	const float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+	const auto v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+	if (v < 0.f || u + v > 1.f)
+		return false;
+	t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+	return t >= 0.f && t <= ray.maxT;
+}
+
+struct Scene
+{
+	std::mt19937 random;
+	std::uniform_real_distribution<float> unit{-1.f, 1.f};
+
+	explicit Scene(const unsigned seed) : random(seed) {}
+
+	float Next() { return unit(random); }
+
+	Aabb RandomBox(const float range, const float maxExtent)
+	{
+		const float center[3] = {Next() * range, Next() * range, Next() * range};
+		const auto extent = std::fabs(Next()) * maxExtent + 0.05f;
+		return Aabb{{center[0] - extent, center[1] - extent, center[2] - extent},
+		            {center[0] + extent, center[1] + extent, center[2] + extent}};
+	}
+
+	// Every tenth ray runs parallel to two axes, every seventh is a short segment
+	Ray RandomRay(const float range, const size_t index)
+	{
+		Ray ray{{Next() * range, Next() * range, Next() * range}, {Next(), Next(), Next()}, 1000.f};
+		if (index % 10 == 0)
+			ray.direction[0] = ray.direction[1] = 0.f;
+		if (index % 7 == 0)
+			ray.maxT = 20.f;
+		return ray;
+	}
+};
+
+// Dynamic tree against brute force over the live proxies, both on the stale binary tree and after Flatten
+struct DynamicChecker
+{
+	DynamicBvh tree{0.1f};
+	std::vector<Aabb> boxes;
+	std::vector<DynamicBvh::ProxyId> ids;
+	std::vector<bool> alive;
+
+	static size_t Index(const DynamicBvh& tree, const DynamicBvh::ProxyId id)
+	{
+		return reinterpret_cast<uintptr_t>(tree.GetUserData(id));
+	}
+
+	void Verify(Scene& scene)
+	{
+		size_t live = 0;
+		for (size_t i = 0; i < boxes.size(); ++i)
+		{
+			if (!alive[i])
+				continue;
+			++live;
+			XT_CHECK(tree.GetFatBounds(ids[i]).Contains(boxes[i]));
+		}
+		XT_CHECK(tree.GetProxyCount() == live);
+
+		// Infinite and +-FLT_MAX queries report every proxy, the inverted boxes of empty Bvh4 slots must not match
+		const auto inf = std::numeric_limits<float>::infinity();
+		const auto big = std::numeric_limits<float>::max();
+		for (const auto& everything : {Aabb{{-inf, -inf, -inf}, {inf, inf, inf}}, Aabb{{-big, -big, -big}, {big, big, big}}})
+		{
+			size_t visited = 0;
+			tree.Query(everything, [&](DynamicBvh::ProxyId) { ++visited; });
+			XT_CHECK(visited == live);
+		}
+
+		for (auto k = 0; k < 100; ++k)
+		{
+			// Queries report fat boxes, so every proxy whose own box overlaps must be among them
+			const auto query = scene.RandomBox(100.f, 1.f).Expanded(3.f);
+			std::set<size_t> found, expected;
+			tree.Query(query, [&](const DynamicBvh::ProxyId id) { XT_CHECK(found.insert(Index(tree, id)).second); });
+			for (size_t i = 0; i < boxes.size(); ++i)
+			{
+				if (alive[i] && tree.GetFatBounds(ids[i]).Overlaps(query))
+					expected.insert(i);
+				if (alive[i] && boxes[i].Overlaps(query))
+					XT_CHECK(found.count(i) == 1);
+			}
+			XT_CHECK(found == expected);
+
+			// Nearest hit against the proxies' own boxes
+			const auto ray = scene.RandomRay(120.f, static_cast<size_t>(k));
+			auto nearest = -1.f;
+			tree.Raycast(ray, [&](const DynamicBvh::ProxyId id, const float maxT)
+			{
+				const auto t = RayEntry(ray, boxes[Index(tree, id)], maxT);
+				if (t >= 0.f && (nearest < 0.f || t < nearest))
+					nearest = t;
+				return t;
+			});
+			auto expectedNearest = -1.f;
+			for (size_t i = 0; i < boxes.size(); ++i)
+			{
+				const auto t = alive[i] ? RayEntry(ray, boxes[i], ray.maxT) : -1.f;
+				if (t >= 0.f && (expectedNearest < 0.f || t < expectedNearest))
+					expectedNearest = t;
+			}
+			XT_CHECK(nearest == expectedNearest);
+		}
+	}
+
+	void VerifyBoth(Scene& scene)
+	{
+		Verify(scene);
+		tree.Flatten();
+		Verify(scene);
+	}
+};
+
+static void TestDynamicBvh()
+{
+	Scene scene(7);
+	DynamicChecker checker;
+	const size_t count = 3000;
+
+	// An empty tree and a single proxy are the degenerate layouts of Bvh4::Build
+	checker.VerifyBoth(scene);
+	for (size_t i = 0; i < count; ++i)
+	{
+		checker.boxes.push_back(scene.RandomBox(100.f, 1.f));
+		checker.ids.push_back(checker.tree.Insert(checker.boxes[i], reinterpret_cast<void*>(uintptr_t{i})));
+		checker.alive.push_back(true);
+		if (i == 0)
+			checker.VerifyBoth(scene);
+	}
+	checker.VerifyBoth(scene);
+
+	// Removes, small moves inside and outside the fat box, teleports and refits, checked every few thousand updates
+	std::uniform_int_distribution<size_t> pick(0, count - 1);
+	auto reinserts = 0;
+	for (auto update = 0; update < 12000; ++update)
+	{
+		const auto i = pick(scene.random);
+		auto& box = checker.boxes[i];
+		if (!checker.alive[i])
+		{
+			box = scene.RandomBox(100.f, 1.f);
+			checker.ids[i] = checker.tree.Insert(box, reinterpret_cast<void*>(uintptr_t{i}));
+			checker.alive[i] = true;
+			continue;
+		}
+
+		const auto operation = update % 5;
+		if (operation == 0)
+		{
+			checker.tree.Remove(checker.ids[i]);
+			checker.alive[i] = false;
+		}
+		else if (operation == 3)
+		{
+			box = scene.RandomBox(100.f, 1.f);
+			reinserts += checker.tree.Move(checker.ids[i], box) ? 1 : 0;
+		}
+		else
+		{
+			const float delta[3] = {scene.Next() * 0.3f, scene.Next() * 0.3f, scene.Next() * 0.3f};
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				box.min[axis] += delta[axis];
+				box.max[axis] += delta[axis];
+			}
+			if (operation == 4)
+				checker.tree.Refit(checker.ids[i], box);
+			else
+				reinserts += checker.tree.Move(checker.ids[i], box) ? 1 : 0;
+		}
+		if (update % 4000 == 3999)
+			checker.VerifyBoth(scene);
+	}
+	XT_CHECK(reinserts > 0);
+
+	// Rotations keep the tree shallow, a 3000 proxy tree is far from degenerate
+	XT_CHECK(checker.tree.GetHeight() < 40);
+
+	// Queries started from inside a query callback
+	const auto outer = scene.RandomBox(100.f, 1.f).Expanded(10.f);
+	size_t nested = 0, direct = 0;
+	checker.tree.Query(outer, [&](const DynamicBvh::ProxyId id)
+	{
+		++direct;
+		checker.tree.Query(checker.tree.GetFatBounds(id), [&](DynamicBvh::ProxyId) { ++nested; });
+	});
+	XT_CHECK(nested >= direct);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		if (checker.alive[i])
+			checker.tree.Remove(checker.ids[i]);
+		checker.alive[i] = false;
+	}
+	checker.VerifyBoth(scene);
+	XT_CHECK(checker.tree.GetHeight() == 0);
+}
+
+struct Vertex
+{
+	float position[3];
+	float color[4];
+};
+
+static void TestMeshBvh()
+{
+	Scene scene(11);
+	const size_t triangleCount = 20000;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	for (size_t i = 0; i < triangleCount; ++i)
+	{
+		const float center[3] = {scene.Next() * 50.f, scene.Next() * 50.f, scene.Next() * 50.f};
+		for (auto corner = 0; corner < 3; ++corner)
+		{
+			indices.push_back(static_cast<uint32_t>(vertices.size()));
+			vertices.push_back(Vertex{{center[0] + scene.Next(), center[1] + scene.Next(), center[2] + scene.Next()}, {}});
+		}
+	}
+	// Indexed and unindexed builds of the same triangles, with the indices reversed so leaf order differs
+	std::reverse(indices.begin(), indices.end());
+	const MeshBvh indexed(vertices[0].position, sizeof(Vertex), vertices.size(), indices.data(), indices.size());
+	const MeshBvh unindexed(vertices[0].position, sizeof(Vertex), vertices.size(), nullptr, 0);
+	XT_CHECK(indexed.GetTriangleCount() == triangleCount && unindexed.GetTriangleCount() == triangleCount);
+
+	const auto corner = [&](const size_t triangle, const int k) { return vertices[indices[triangle * 3 + k]].position; };
+
+	auto hits = 0;
+	for (size_t r = 0; r < 1000; ++r)
+	{
+		const auto ray = scene.RandomRay(60.f, r);
+		auto expected = ray.maxT;
+		auto expectedTriangle = -1;
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			float distance;
+			if (RayTriangle(corner(t, 0), corner(t, 1), corner(t, 2), ray, distance) && distance <= expected)
+			{
+				expected = distance;
+				expectedTriangle = static_cast<int>(t);
+			}
+		}
+
+		MeshHit hit{}, unindexedHit{};
+		const auto found = indexed.Raycast(ray, hit);
+		XT_CHECK(found == (expectedTriangle >= 0));
+		XT_CHECK(unindexed.Raycast(ray, unindexedHit) == found);
+		if (!found || expectedTriangle < 0)
+			continue;
+		++hits;
+		XT_CHECK_NEAR(hit.t, expected, 1e-4 * std::max(1.f, expected));
+		XT_CHECK_NEAR(unindexedHit.t, expected, 1e-4 * std::max(1.f, expected));
+
+		// The reported barycentrics reconstruct the hit point
+		const auto* a = corner(hit.triangle, 0);
+		const auto* b = corner(hit.triangle, 1);
+		const auto* c = corner(hit.triangle, 2);
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			const auto point = a[axis] + hit.u * (b[axis] - a[axis]) + hit.v * (c[axis] - a[axis]);
+			XT_CHECK_NEAR(point, ray.origin[axis] + hit.t * ray.direction[axis], 1e-3);
+		}
+	}
+	XT_CHECK(hits > 50);
+
+	for (auto q = 0; q < 200; ++q)
+	{
+		const auto query = scene.RandomBox(50.f, 5.f);
+		std::set<uint32_t> found, expected;
+		indexed.Query(query, [&](const uint32_t triangle) { XT_CHECK(found.insert(triangle).second); });
+		for (size_t t = 0; t < triangleCount; ++t)
+		{
+			auto bounds = Aabb::Empty();
+			for (auto k = 0; k < 3; ++k)
+				bounds.Extend(corner(t, k));
+			if (bounds.Overlaps(query))
+				expected.insert(static_cast<uint32_t>(t));
+		}
+		XT_CHECK(found == expected);
+	}
+
+	// Empty and single triangle meshes
+	const MeshBvh empty(nullptr, sizeof(Vertex), 0, nullptr, 0);
+	MeshHit hit{};
+	XT_CHECK(empty.IsEmpty() && !empty.Raycast(scene.RandomRay(60.f, 1), hit));
+	size_t visited = 0;
+	empty.Query(Aabb{{-1e9f, -1e9f, -1e9f}, {1e9f, 1e9f, 1e9f}}, [&](uint32_t) { ++visited; });
+	XT_CHECK(visited == 0);
+
+	const MeshBvh single(vertices[0].position, sizeof(Vertex), 3, nullptr, 0);
+	Ray ray{{0.f, 0.f, -100.f}, {0.f, 0.f, 1.f}, 1e9f};
+	for (auto axis = 0; axis < 2; ++axis)
+		ray.origin[axis] = (vertices[0].position[axis] + vertices[1].position[axis] + vertices[2].position[axis]) / 3.f;
+	XT_CHECK(single.Raycast(ray, hit) && hit.triangle == 0);
+	const auto inf = std::numeric_limits<float>::infinity();
+	single.Query(Aabb{{-inf, -inf, -inf}, {inf, inf, inf}}, [&](uint32_t) { ++visited; });
+	XT_CHECK(visited == 1);
+}
+
+int main()
+{
+	TestDynamicBvh();
+	TestMeshBvh();
+	return Test::Finish("BvhTests");
+}
@@ -0,0 +1,78 @@
+#include <algorithm>
+#include <cstdio>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "Benchmark.h"
+#include "ColorConvert.h"
+#include "FrameEncoder.h"
+#include "FrameWriter.h"
+#include "Test.h"
+
+// 1080p conversion throughput per SIMD level, encoder bandwidth and end-to-end writer frame rate
+int main()
+{
+	const uint32_t width = 1920, height = 1080;
+	const auto pitch = size_t{width} * 4;
+	std::vector<uint8_t> rgba(pitch * height);
+	std::mt19937 random(1);
+	for (auto& byte : rgba)
+		byte = static_cast<uint8_t>(random());
+
+	const auto lumaSize = ColorConvert::LumaSize(width, height);
+	const auto chromaSize = ColorConvert::ChromaSize(width, height);
+	const size_t chromaWidth = (width + 1) / 2;
+	std::vector<uint8_t> yuv(lumaSize + chromaSize * 2);
+	const auto y = yuv.data();
+	const ColorConvert::Planes i420{y, width, y + lumaSize, chromaWidth, y + lumaSize + chromaSize, chromaWidth};
+	const ColorConvert::Planes nv12{y, width, y + lumaSize, chromaWidth * 2, nullptr, 0};
+	const auto megapixels = static_cast<double>(width) * height * 1e-6;
+
+	std::printf("CaptureBenchmark: %ux%u\n", width, height);
+	Test::ForEachLevel([&](const SimdLevel level)
+	{
+		const auto i420Seconds = Benchmark::Time([&] { ColorConvert::RgbaToI420(rgba.data(), pitch, width, height, i420); });
+		const auto nv12Seconds = Benchmark::Time([&] { ColorConvert::RgbaToNv12(rgba.data(), pitch, width, height, nv12); });
+		std::printf("  I420 %-7s %8.1f Mpix/s\n", Test::LevelName(level), megapixels / i420Seconds);
+		std::printf("  NV12 %-7s %8.1f Mpix/s\n", Test::LevelName(level), megapixels / nv12Seconds);
+	});
+
+	std::vector<uint8_t> encoded;
+	const auto megabytes = static_cast<double>(rgba.size()) * 1e-6;
+	const auto pngSeconds = Benchmark::Time([&]
+	{
+		encoded.clear();
+		FrameEncoder::Png(encoded, rgba.data(), pitch, width, height);
+	});
+	const auto y4mSeconds = Benchmark::Time([&]
+	{
+		encoded.clear();
+		FrameEncoder::Y4MFrame(encoded, rgba.data(), pitch, width, height);
+	});
+	std::printf("  PNG encode   %8.1f MB/s\n", megabytes / pngSeconds);
+	std::printf("  Y4M encode   %8.1f MB/s\n", megabytes / y4mSeconds);
+
+	// The writer drops frames when the pool runs dry, the producer here waits instead to measure throughput
+	const auto path = "CaptureBenchmark.y4m";
+	const size_t frames = 60;
+	const auto writerSeconds = Benchmark::Time([&]
+	{
+		FrameWriter writer(path, CaptureFormat::Y4M, 60, 2, 4);
+		for (size_t i = 0; i < frames; ++i)
+		{
+			auto frame = writer.AcquireFrame(width, height);
+			while (!frame)
+			{
+				std::this_thread::yield();
+				frame = writer.AcquireFrame(width, height);
+			}
+			std::copy(rgba.begin(), rgba.end(), frame->rgba.begin());
+			writer.Submit(std::move(frame));
+		}
+		writer.Close();
+	}, 1.0);
+	std::remove(path);
+	std::printf("  Y4M writer   %8.1f frames/s\n", static_cast<double>(frames) / writerSeconds);
+	return 0;
+}
@@ -0,0 +1,386 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <sys/stat.h>
+
+#include "ColorConvert.h"
+#include "FrameEncoder.h"
+#include "FrameWriter.h"
+#include "Test.h"
+
+// A synthetic frame: gradients with noise, rows padded to pitch bytes with garbage
+struct SyntheticFrame
+{
+	std::vector<uint8_t> rgba;
+	size_t pitch;
+	uint32_t width;
+	uint32_t height;
+
+	SyntheticFrame(const uint32_t width, const uint32_t height, const size_t padding, const unsigned seed)
+		: pitch(size_t{width} * 4 + padding), width(width), height(height)
+	{
+		std::mt19937 random(seed);
+		rgba.resize(pitch * height);
+		for (auto& byte : rgba)
+			byte = static_cast<uint8_t>(random());
+		for (uint32_t y = 0; y < height; ++y)
+		{
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				auto* pixel = rgba.data() + y * pitch + x * 4;
+				pixel[0] = static_cast<uint8_t>(x * 255 / std::max(width, 1u));
+				pixel[1] = static_cast<uint8_t>(y * 255 / std::max(height, 1u));
+				pixel[2] = static_cast<uint8_t>(pixel[2] / 2 + 64);
+			}
+		}
+	}
+
+	const uint8_t* Pixel(const uint32_t x, const uint32_t y) const { return rgba.data() + y * pitch + x * 4; }
+};
+
+struct YuvImage
+{
+	std::vector<uint8_t> data;
+	ColorConvert::Planes planes;
+
+	YuvImage(const uint32_t width, const uint32_t height, const bool nv12)
+	{
+		const auto lumaSize = ColorConvert::LumaSize(width, height);
+		const auto chromaSize = ColorConvert::ChromaSize(width, height);
+		const auto chromaWidth = size_t{(width + 1) / 2};
+		data.assign(lumaSize + chromaSize * 2, 0);
+		auto* y = data.data();
+		if (nv12)
+			planes = ColorConvert::Planes{y, width, y + lumaSize, chromaWidth * 2, nullptr, 0};
+		else
+			planes = ColorConvert::Planes{y, width, y + lumaSize, chromaWidth, y + lumaSize + chromaSize, chromaWidth};
+	}
+};
+
+// The AVX2 path against the scalar path, and both against the BT.601 formulas in floating point
+static void TestColorConvert()
+{
+	const uint32_t widths[] = {1, 2, 15, 16, 17, 31, 33, 64, 333};
+	const uint32_t heights[] = {1, 2, 3, 16, 37};
+	unsigned seed = 0;
+
+	for (const auto width : widths)
+	{
+		for (const auto height : heights)
+		{
+			const SyntheticFrame frame(width, height, width % 3 * 4, ++seed);
+			for (const auto nv12 : {false, true})
+			{
+				std::vector<YuvImage> results;
+				Test::ForEachLevel([&](const SimdLevel)
+				{
+					results.emplace_back(width, height, nv12);
+					auto& image = results.back();
+					if (nv12)
+						ColorConvert::RgbaToNv12(frame.rgba.data(), frame.pitch, width, height, image.planes);
+					else
+						ColorConvert::RgbaToI420(frame.rgba.data(), frame.pitch, width, height, image.planes);
+				});
+				for (const auto& result : results)
+					XT_CHECK(result.data == results.front().data);
+
+				const auto& planes = results.front().planes;
+				auto lumaError = 0.0, chromaError = 0.0;
+				for (uint32_t y = 0; y < height; ++y)
+				{
+					for (uint32_t x = 0; x < width; ++x)
+					{
+						const auto* p = frame.Pixel(x, y);
+						const auto luma = 16.0 + (65.738 * p[0] + 129.057 * p[1] + 25.064 * p[2]) / 256.0;
+						lumaError = std::max(lumaError, std::fabs(planes.y[y * planes.yPitch + x] - luma));
+					}
+				}
+				for (uint32_t y = 0; y < height; y += 2)
+				{
+					for (uint32_t x = 0; x < width; x += 2)
+					{
+						double r = 0, g = 0, b = 0;
+						for (const auto dy : {0u, 1u})
+						{
+							for (const auto dx : {0u, 1u})
+							{
+								const auto* p = frame.Pixel(std::min(x + dx, width - 1), std::min(y + dy, height - 1));
+								r += p[0] / 4.0;
+								g += p[1] / 4.0;
+								b += p[2] / 4.0;
+							}
+						}
+						const auto u = 128.0 + (-37.945 * r - 74.494 * g + 112.439 * b) / 256.0;
+						const auto v = 128.0 + (112.439 * r - 94.154 * g - 18.285 * b) / 256.0;
+						const auto row = (y / 2) * planes.uPitch;
+						const auto actualU = nv12 ? planes.u[row + x] : planes.u[row + x / 2];
+						const auto actualV = nv12 ? planes.u[row + x + 1] : planes.v[(y / 2) * planes.vPitch + x / 2];
+						chromaError = std::max(chromaError, std::max(std::fabs(actualU - u), std::fabs(actualV - v)));
+					}
+				}
+				XT_CHECK(lumaError <= 1.0);
+				XT_CHECK(chromaError <= 1.5);
+			}
+		}
+	}
+
+	// White and black map to the ends of the limited range with neutral chroma
+	const uint8_t pixels[16] = {255, 255, 255, 255, 255, 255, 255, 255, 0, 0, 0, 255, 0, 0, 0, 255};
+	uint8_t out[6];
+	ColorConvert::RgbaToI420(pixels, 8, 2, 2, {out, 2, out + 4, 1, out + 5, 1});
+	XT_CHECK(out[0] == 235 && out[1] == 235 && out[2] == 16 && out[3] == 16);
+	XT_CHECK(out[4] == 128 && out[5] == 128);
+}
+
+static uint32_t ReadBigEndian(const uint8_t* src)
+{
+	return uint32_t{src[0]} << 24 | uint32_t{src[1]} << 16 | uint32_t{src[2]} << 8 | src[3];
+}
+
+// Bitwise CRC-32, independent of the table driven one in FrameEncoder
+static uint32_t ReferenceCrc32(const uint8_t* data, const size_t size)
+{
+	uint32_t crc = 0xFFFFFFFFu;
+	for (size_t i = 0; i < size; ++i)
+	{
+		crc ^= data[i];
+		for (auto bit = 0; bit < 8; ++bit)
+			crc = crc & 1 ? 0xEDB88320u ^ (crc >> 1) : crc >> 1;
+	}
+	return ~crc;
+}
+
+// Decodes a PNG made of stored deflate blocks with filter type 0, checking every CRC and the Adler-32.
+// Returns false on anything the encoder should never produce.
+static bool DecodeStoredPng(const std::vector<uint8_t>& png, uint32_t& width, uint32_t& height,
+                            std::vector<uint8_t>& rgba)
+{
+	static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+	if (png.size() < 8 || std::memcmp(png.data(), signature, 8) != 0)
+		return false;
+
+	std::vector<uint8_t> zlib;
+	auto sawEnd = false;
+	for (size_t offset = 8; offset < png.size() && !sawEnd;)
+	{
+		if (offset + 12 > png.size())
+			return false;
+		const auto length = ReadBigEndian(png.data() + offset);
+		const auto* type = png.data() + offset + 4;
+		if (offset + 12 + length > png.size())
+			return false;
+		if (ReadBigEndian(type + 4 + length) != ReferenceCrc32(type, 4 + length))
+			return false;
+
+		const auto* data = type + 4;
+		if (std::memcmp(type, "IHDR", 4) == 0)
+		{
+			width = ReadBigEndian(data);
+			height = ReadBigEndian(data + 4);
+			if (data[8] != 8 || data[9] != 6)
+				return false;
+		}
+		else if (std::memcmp(type, "IDAT", 4) == 0)
+		{
+			zlib.insert(zlib.end(), data, data + length);
+		}
+		else if (std::memcmp(type, "IEND", 4) == 0)
+		{
+			sawEnd = true;
+		}
+		offset += 12 + length;
+	}
+	if (!sawEnd || zlib.size() < 6 || ((zlib[0] << 8) | zlib[1]) % 31 != 0)
+		return false;
+
+	std::vector<uint8_t> raw;
+	size_t offset = 2;
+	for (auto last = false; !last;)
+	{
+		if (offset + 5 > zlib.size() || (zlib[offset] & 6) != 0)
+			return false;
+		last = (zlib[offset] & 1) != 0;
+		const auto length = zlib[offset + 1] | zlib[offset + 2] << 8;
+		const auto inverse = zlib[offset + 3] | zlib[offset + 4] << 8;
+		if ((length ^ 0xFFFF) != inverse || offset + 5 + length > zlib.size())
+			return false;
+		raw.insert(raw.end(), zlib.begin() + offset + 5, zlib.begin() + offset + 5 + length);
+		offset += 5 + length;
+	}
+
+	uint32_t a = 1, b = 0;
+	for (const auto byte : raw)
+	{
+		a = (a + byte) % 65521;
+		b = (b + a) % 65521;
+	}
+	if (offset + 4 != zlib.size() || ReadBigEndian(zlib.data() + offset) != (b << 16 | a))
+		return false;
+
+	const auto rowBytes = size_t{width} * 4;
+	if (raw.size() != (rowBytes + 1) * height)
+		return false;
+	rgba.clear();
+	for (uint32_t y = 0; y < height; ++y)
+	{
+		const auto* row = raw.data() + y * (rowBytes + 1);
+		if (row[0] != 0)
+			return false;
+		rgba.insert(rgba.end(), row + 1, row + 1 + rowBytes);
+	}
+	return true;
+}
+
+static std::vector<uint8_t> Packed(const SyntheticFrame& frame)
+{
+	std::vector<uint8_t> packed;
+	for (uint32_t y = 0; y < frame.height; ++y)
+		packed.insert(packed.end(), frame.Pixel(0, y), frame.Pixel(0, y) + size_t{frame.width} * 4);
+	return packed;
+}
+
+static void TestPngRoundTrip()
+{
+	// 200 x 100 spans two stored blocks, 1 x 1 and 0 rows are the edge cases
+	const uint32_t sizes[][2] = {{1, 1}, {7, 3}, {200, 100}, {333, 37}, {5, 0}};
+	unsigned seed = 100;
+	for (const auto& size : sizes)
+	{
+		const SyntheticFrame frame(size[0], size[1], 12, ++seed);
+		std::vector<uint8_t> png;
+		FrameEncoder::Png(png, frame.rgba.data(), frame.pitch, frame.width, frame.height);
+
+		uint32_t width = 0, height = 0;
+		std::vector<uint8_t> decoded;
+		XT_CHECK(DecodeStoredPng(png, width, height, decoded));
+		XT_CHECK(width == frame.width && height == frame.height);
+		XT_CHECK(decoded == Packed(frame));
+	}
+}
+
+static bool ReadFile(const std::string& path, std::vector<uint8_t>& data)
+{
+	const auto file = std::fopen(path.c_str(), "rb");
+	if (!file)
+		return false;
+	uint8_t buffer[4096];
+	data.clear();
+	size_t read;
+	while ((read = std::fread(buffer, 1, sizeof(buffer), file)) > 0)
+		data.insert(data.end(), buffer, buffer + read);
+	std::fclose(file);
+	return true;
+}
+
+// Frames go through the writer's worker threads and come out of the Y4M stream in submission order
+static void TestY4MRoundTrip()
+{
+	const uint32_t width = 97, height = 45;
+	const std::string path = "CaptureTests.y4m";
+	std::vector<std::vector<uint8_t>> expected;
+	{
+		FrameWriter writer(path, CaptureFormat::Y4M, 30, 3, 4);
+		for (unsigned index = 0; index < 12; ++index)
+		{
+			const SyntheticFrame frame(width, height, 0, 200 + index);
+			auto captured = writer.AcquireFrame(width, height);
+			if (!captured)
+			{
+				writer.Flush();
+				captured = writer.AcquireFrame(width, height);
+			}
+			XT_CHECK(captured != nullptr);
+			if (!captured)
+				return;
+			captured->rgba = frame.rgba;
+			writer.Submit(std::move(captured));
+
+			YuvImage image(width, height, false);
+			ColorConvert::RgbaToI420(frame.rgba.data(), frame.pitch, width, height, image.planes);
+			expected.push_back(image.data);
+		}
+		writer.Flush();
+		XT_CHECK(writer.GetWrittenFrames() == expected.size());
+		XT_CHECK(!writer.HasError());
+	}
+
+	std::vector<uint8_t> file;
+	XT_CHECK(ReadFile(path, file));
+	std::remove(path.c_str());
+
+	std::vector<uint8_t> header;
+	FrameEncoder::Y4MHeader(header, width, height, 30);
+	XT_CHECK(file.size() >= header.size() && std::equal(header.begin(), header.end(), file.begin()));
+
+	static const char marker[] = "FRAME\n";
+	auto offset = header.size();
+	for (const auto& planes : expected)
+	{
+		XT_CHECK(offset + 6 + planes.size() <= file.size());
+		if (offset + 6 + planes.size() > file.size())
+			return;
+		XT_CHECK(std::memcmp(file.data() + offset, marker, 6) == 0);
+		XT_CHECK(std::equal(planes.begin(), planes.end(), file.begin() + offset + 6));
+		offset += 6 + planes.size();
+	}
+	XT_CHECK(offset == file.size());
+}
+
+// A Y4M stream that failed to open stays closed, a later frame must not start the file without the earlier ones
+static void TestY4MOpenFailure()
+{
+	// A directory in the way makes fopen fail until it is removed
+	const std::string path = "CaptureTestsFailure.y4m";
+	XT_CHECK(mkdir(path.c_str(), 0700) == 0);
+	{
+		FrameWriter writer(path, CaptureFormat::Y4M, 30, 1, 2);
+		auto first = writer.AcquireFrame(8, 8);
+		writer.Submit(std::move(first));
+		writer.Flush();
+		XT_CHECK(writer.HasError());
+
+		std::remove(path.c_str());
+		auto second = writer.AcquireFrame(8, 8);
+		writer.Submit(std::move(second));
+		writer.Flush();
+		XT_CHECK(writer.GetWrittenFrames() == 2);
+	}
+
+	std::vector<uint8_t> file;
+	XT_CHECK(!ReadFile(path, file));
+	std::remove(path.c_str());
+}
+
+// A dry pool drops frames, ReleaseFrame puts an unsubmitted frame back
+static void TestFramePool()
+{
+	FrameWriter writer("CaptureTests", CaptureFormat::Png, 30, 1, 2);
+	auto first = writer.AcquireFrame(4, 4);
+	auto second = writer.AcquireFrame(4, 4);
+	XT_CHECK(first && second);
+	XT_CHECK(writer.AcquireFrame(4, 4) == nullptr);
+	XT_CHECK(writer.GetDroppedFrames() == 1);
+
+	writer.ReleaseFrame(std::move(second));
+	XT_CHECK(writer.GetDroppedFrames() == 2);
+	auto third = writer.AcquireFrame(8, 2);
+	XT_CHECK(third && third->rgba.size() == 8 * 2 * 4);
+	writer.ReleaseFrame(std::move(first));
+	writer.ReleaseFrame(std::move(third));
+	XT_CHECK(writer.GetWrittenFrames() == 0);
+}
+
+int main()
+{
+	TestColorConvert();
+	TestPngRoundTrip();
+	TestY4MRoundTrip();
+	TestY4MOpenFailure();
+	TestFramePool();
+	return Test::Finish("CaptureTests");
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Animation.h"
+#include "Skinning.h"
+
+// A 64 bone skeleton with two 61 frame clips and a skinned mesh interleaved like the GPU vertex.
+// In the walk clip bones from 48 on never move and only the root translates and scales,
+// so the clip exercises the constant track compression.
+struct CharacterScene
+{
+	struct Vertex
+	{
+		float position[3];
+		float color[4];
+		SkinInfluence skin;
+	};
+
+	enum : size_t
+	{
+		BoneCount = 64,
+		FrameCount = 61
+	};
+
+	std::mt19937 random;
+	std::vector<int32_t> parents;
+	std::vector<BoneTransform> bindPose;
+	std::vector<BoneTransform> walkFrames;
+	std::vector<BoneTransform> runFrames;
+	std::vector<Vertex> mesh;
+
+	CharacterScene(const size_t vertexCount, const unsigned seed)
+		: random(seed), parents(BoneCount), bindPose(BoneCount), walkFrames(FrameCount * BoneCount),
+		  runFrames(FrameCount * BoneCount), mesh(vertexCount)
+	{
+		// A spine chain of eight bones, the rest hang off random earlier bones
+		for (size_t bone = 0; bone < BoneCount; ++bone)
+		{
+			parents[bone] = bone == 0 ? -1 : bone < 8 ? static_cast<int32_t>(bone - 1) : static_cast<int32_t>(random() % bone);
+			bindPose[bone].rotation = VectorMath::QuaternionRotationAxis(Float3{Next(), Next(), Next()}, Next());
+			bindPose[bone].translation = Float3{Next(), 1.f + Next() * 0.2f, Next()};
+			bindPose[bone].scale = 1.f;
+		}
+
+		for (size_t frame = 0; frame < FrameCount; ++frame)
+		{
+			for (size_t bone = 0; bone < BoneCount; ++bone)
+			{
+				const auto f = static_cast<float>(frame), b = static_cast<float>(bone);
+				auto walk = bindPose[bone];
+				if (bone < 48)
+				{
+					const auto swing = VectorMath::QuaternionRotationAxis(Float3{0.3f, 1.f, 0.1f * b}, 0.5f * std::sin(f * 0.2f + b));
+					walk.rotation = VectorMath::QuaternionMultiply(swing, bindPose[bone].rotation);
+				}
+				if (bone == 0)
+				{
+					walk.translation.x = 0.05f * f;
+					walk.scale = 1.f + 0.01f * f;
+				}
+				walkFrames[frame * BoneCount + bone] = walk;
+
+				auto run = bindPose[bone];
+				const auto swing = VectorMath::QuaternionRotationAxis(Float3{1.f, 0.f, 0.2f}, 0.8f * std::cos(f * 0.1f - b));
+				run.rotation = VectorMath::QuaternionMultiply(swing, bindPose[bone].rotation);
+				runFrames[frame * BoneCount + bone] = run;
+			}
+		}
+
+		// Two or three influences per vertex with weights summing to one
+		for (auto& vertex : mesh)
+		{
+			vertex.position[0] = Next();
+			vertex.position[1] = Next() * 3.f;
+			vertex.position[2] = Next();
+			float weights[4] = {std::fabs(Next()), std::fabs(Next()), std::fabs(Next()), 0.f};
+			if (random() % 2)
+				weights[2] = 0.f;
+			const auto sum = weights[0] + weights[1] + weights[2] + 1e-6f;
+			for (auto k = 0; k < 4; ++k)
+			{
+				vertex.skin.bones[k] = static_cast<uint16_t>(random() % BoneCount);
+				vertex.skin.weights[k] = weights[k] / sum;
+			}
+		}
+	}
+
+	float Next() { return std::uniform_real_distribution<float>(-1.f, 1.f)(random); }
+};
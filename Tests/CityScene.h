@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "Aabb.h"
+#include "VectorMath.h"
+
+// A grid of box buildings with small props scattered in the streets between them,
+// seen from street level looking down the blocks
+struct CityScene
+{
+	// Unit cube, clockwise when seen from outside
+	std::vector<Float3> cubeVertices{
+		{-1, -1, -1}, {-1, 1, -1}, {1, 1, -1}, {1, -1, -1}, {-1, -1, 1}, {-1, 1, 1}, {1, 1, 1}, {1, -1, 1}
+	};
+	std::vector<uint32_t> cubeIndices{
+		0, 1, 2, 0, 2, 3, 4, 6, 5, 4, 7, 6, 4, 5, 1, 4, 1, 0, 3, 2, 6, 3, 6, 7, 1, 5, 6, 1, 6, 2, 4, 0, 3, 4, 3, 7
+	};
+
+	std::vector<Float4x4> buildingWorlds;
+	std::vector<Aabb> buildings;
+	std::vector<Aabb> props;
+	Float3 eye{3.f, 2.f, -20.f};
+	Float4x4 viewProjection;
+
+	CityScene(const int blocksX, const int blocksZ, const int propsPerBlock, const unsigned seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> unit(0.f, 1.f);
+		for (auto gx = -blocksX / 2; gx < blocksX - blocksX / 2; ++gx)
+		{
+			for (auto gz = 0; gz < blocksZ; ++gz)
+			{
+				const auto x = gx * 10.f, z = gz * 10.f;
+				const auto halfHeight = 5.f + unit(random) * 30.f;
+				const auto halfX = 3.f + unit(random), halfZ = 3.f + unit(random);
+				buildingWorlds.push_back(Float4x4{{
+					{halfX, 0.f, 0.f, 0.f}, {0.f, halfHeight, 0.f, 0.f}, {0.f, 0.f, halfZ, 0.f}, {x, halfHeight, z, 1.f}
+				}});
+				buildings.push_back(Aabb{{x - halfX, 0.f, z - halfZ}, {x + halfX, 2.f * halfHeight, z + halfZ}});
+
+				for (auto i = 0; i < propsPerBlock; ++i)
+				{
+					const auto px = x + 5.f + unit(random) * 4.f - 2.f;
+					const auto pz = z + 5.f + unit(random) * 4.f - 2.f;
+					props.push_back(Aabb{{px - 0.5f, 0.f, pz - 0.5f}, {px + 0.5f, 2.f, pz + 0.5f}});
+				}
+			}
+		}
+
+		const auto view = VectorMath::LookAtLH(eye, Float3{eye.x, eye.y, 100.f}, Float3{0.f, 1.f, 0.f});
+		const auto projection = VectorMath::PerspectiveFovLH(1.2f, 16.f / 9.f, 0.5f, 2000.f);
+		viewProjection = VectorMath::Multiply(view, projection);
+	}
+};
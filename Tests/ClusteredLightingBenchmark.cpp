@@ -0,0 +1,36 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "LightScene.h"
+#include "Test.h"
+
+// Assign() time for 256 to 4096 mixed point and spot lights on a 16 x 9 x 24 grid at every SIMD level,
+// on one thread and on the default pool
+int main()
+{
+	const size_t lightCounts[] = {256, 1024, 4096};
+	ThreadPool single(1);
+	auto& pool = ThreadPool::GetDefault();
+	std::printf("ClusteredLightingBenchmark: %u clusters, %zu threads\n",
+	            LightScene::TilesX * LightScene::TilesY * LightScene::Slices, pool.GetThreadCount());
+
+	for (const auto count : lightCounts)
+	{
+		const LightScene scene(count, 99);
+		Test::ForEachLevel([&](const SimdLevel level)
+		{
+			for (auto* threads : {&single, &pool})
+			{
+				ClusteredLighting lighting(scene.projection, scene.nearZ, scene.farZ, LightScene::TilesX,
+				                           LightScene::TilesY, LightScene::Slices, *threads);
+				const auto seconds = Benchmark::Time([&]
+				{
+					lighting.Assign(scene.lights.data(), scene.lights.size(), scene.overview);
+				});
+				std::printf("  %4zu lights %-7s %2zu threads %8.1f us, %zu light indices\n", count, Test::LevelName(level),
+				            threads->GetThreadCount(), seconds * 1e6, lighting.GetLightIndices().size());
+			}
+		});
+	}
+	return 0;
+}
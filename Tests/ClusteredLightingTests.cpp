@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "LightScene.h"
+#include "Test.h"
+
+// View space box of cluster (x, y, slice), from the tile's corners at both slice depths, in double
+struct ClusterBox
+{
+	double min[3];
+	double max[3];
+	double left, right, bottom, top;
+};
+
+static ClusterBox ReferenceBox(const ClusteredLighting& lighting, const Float4x4& projection, const uint32_t x,
+                               const uint32_t y, const uint32_t slice)
+{
+	const double tilesX = lighting.GetTilesX(), tilesY = lighting.GetTilesY();
+	const double z0 = lighting.SliceDepth(slice), z1 = lighting.SliceDepth(slice + 1);
+	const double p00 = projection.m[0][0], p11 = projection.m[1][1];
+
+	ClusterBox box{};
+	box.left = -1.0 + 2.0 * x / tilesX;
+	box.right = -1.0 + 2.0 * (x + 1) / tilesX;
+	box.top = 1.0 - 2.0 * y / tilesY;
+	box.bottom = 1.0 - 2.0 * (y + 1) / tilesY;
+	box.min[0] = std::min(box.left * z0, box.left * z1) / p00;
+	box.max[0] = std::max(box.right * z0, box.right * z1) / p00;
+	box.min[1] = std::min(box.bottom * z0, box.bottom * z1) / p11;
+	box.max[1] = std::max(box.top * z0, box.top * z1) / p11;
+	box.min[2] = z0;
+	box.max[2] = z1;
+	return box;
+}
+
+static bool SphereTouchesBox(const Light& light, const ClusterBox& box)
+{
+	const double center[3] = {light.position.x, light.position.y, light.position.z};
+	double distance = 0.0;
+	for (auto axis = 0; axis < 3; ++axis)
+	{
+		const auto d = std::max({box.min[axis] - center[axis], center[axis] - box.max[axis], 0.0});
+		distance += d * d;
+	}
+	const double range = light.range;
+	return distance <= range * range * 1.0001;
+}
+
+// True when one of 7^3 points spread over the cluster's frustum cell is clearly lit, i.e. inside the range and,
+// for spot lights, inside the outer cone. Such a pair must never be missed.
+static bool ClearlyLit(const Light& light, const Float4x4& projection, const ClusterBox& box)
+{
+	const auto steps = 6;
+	const double p00 = projection.m[0][0], p11 = projection.m[1][1];
+	for (auto i = 0; i <= steps; ++i)
+		for (auto j = 0; j <= steps; ++j)
+			for (auto k = 0; k <= steps; ++k)
+			{
+				const auto z = box.min[2] + (box.max[2] - box.min[2]) * k / steps;
+				const auto x = (box.left + (box.right - box.left) * i / steps) * z / p00;
+				const auto y = (box.bottom + (box.top - box.bottom) * j / steps) * z / p11;
+				const auto dx = x - light.position.x, dy = y - light.position.y, dz = z - light.position.z;
+				const auto distance = std::sqrt(dx * dx + dy * dy + dz * dz);
+				if (distance > light.range * 0.999)
+					continue;
+				if (light.type == LightType::Spot && distance > 0.0)
+				{
+					const auto cosine = (dx * light.direction.x + dy * light.direction.y + dz * light.direction.z) / distance;
+					if (cosine < light.cosOuter + 1e-3)
+						continue;
+				}
+				return true;
+			}
+	return false;
+}
+
+static bool SameAssignment(const ClusteredLighting& a, const ClusteredLighting& b)
+{
+	if (a.GetLightIndices() != b.GetLightIndices())
+		return false;
+	for (size_t i = 0; i < a.GetClusterCount(); ++i)
+	{
+		const auto& x = a.GetClusterRanges()[i];
+		const auto& y = b.GetClusterRanges()[i];
+		if (x.offset != y.offset || x.count != y.count)
+			return false;
+	}
+	return true;
+}
+
+// Every cluster's list is in light order, holds only lights whose sphere touches the cluster's box,
+// and misses no light that clearly lights a point of the cluster
+static void CheckAgainstBruteForce(const ClusteredLighting& lighting, const Float4x4& projection)
+{
+	const auto& ranges = lighting.GetClusterRanges();
+	const auto& indices = lighting.GetLightIndices();
+	const auto& lights = lighting.GetViewLights();
+	size_t assigned = 0, missed = 0, outside = 0, unordered = 0;
+	std::vector<bool> listed(lights.size());
+
+	for (uint32_t slice = 0; slice < lighting.GetSlices(); ++slice)
+		for (uint32_t y = 0; y < lighting.GetTilesY(); ++y)
+			for (uint32_t x = 0; x < lighting.GetTilesX(); ++x)
+			{
+				const auto& range = ranges[(size_t{slice} * lighting.GetTilesY() + y) * lighting.GetTilesX() + x];
+				std::fill(listed.begin(), listed.end(), false);
+				for (uint32_t k = 0; k < range.count; ++k)
+				{
+					const auto light = indices[range.offset + k];
+					listed[light] = true;
+					unordered += k > 0 && light <= indices[range.offset + k - 1] ? 1 : 0;
+				}
+				assigned += range.count;
+
+				const auto box = ReferenceBox(lighting, projection, x, y, slice);
+				for (size_t light = 0; light < lights.size(); ++light)
+				{
+					const auto touches = SphereTouchesBox(lights[light], box);
+					outside += listed[light] && !touches ? 1 : 0;
+					if (touches && !listed[light] && ClearlyLit(lights[light], projection, box))
+						++missed;
+				}
+			}
+
+	XT_CHECK(assigned > 0);
+	XT_CHECK(unordered == 0);
+	XT_CHECK(outside == 0);
+	XT_CHECK(missed == 0);
+}
+
+static void TestAssignment(const size_t lightCount)
+{
+	const LightScene scene(lightCount, 7 + static_cast<unsigned>(lightCount));
+	ThreadPool single(1);
+	ThreadPool four(4);
+
+	for (const auto& view : {scene.overview, scene.inside})
+	{
+		ClusteredLighting reference(scene.projection, scene.nearZ, scene.farZ, LightScene::TilesX, LightScene::TilesY,
+		                            LightScene::Slices, single);
+		Simd::SetLevel(SimdLevel::Scalar);
+		reference.Assign(scene.lights.data(), scene.lights.size(), view);
+		Simd::ResetLevel();
+		CheckAgainstBruteForce(reference, scene.projection);
+
+		// Every level on one and on four threads gives the scalar result, also when the buffers are reused
+		Test::ForEachLevel([&](const SimdLevel)
+		{
+			for (auto* pool : {&single, &four})
+			{
+				ClusteredLighting lighting(scene.projection, scene.nearZ, scene.farZ, LightScene::TilesX,
+				                           LightScene::TilesY, LightScene::Slices, *pool);
+				lighting.Assign(scene.lights.data(), scene.lights.size(), view);
+				XT_CHECK(SameAssignment(lighting, reference));
+				lighting.Assign(scene.lights.data(), scene.lights.size(), view);
+				XT_CHECK(SameAssignment(lighting, reference));
+			}
+		});
+	}
+}
+
+static void TestSlices()
+{
+	const LightScene scene(0, 1);
+	const ClusteredLighting lighting(scene.projection, scene.nearZ, scene.farZ);
+	XT_CHECK_NEAR(lighting.SliceDepth(0), scene.nearZ, 1e-6);
+	XT_CHECK_NEAR(lighting.SliceDepth(lighting.GetSlices()), scene.farZ, 1e-3);
+	for (uint32_t slice = 0; slice < lighting.GetSlices(); ++slice)
+	{
+		const auto middle = 0.5f * (lighting.SliceDepth(slice) + lighting.SliceDepth(slice + 1));
+		XT_CHECK(lighting.SliceOf(middle) == slice);
+	}
+	XT_CHECK(lighting.SliceOf(0.f) == 0);
+	XT_CHECK(lighting.SliceOf(1e6f) == lighting.GetSlices() - 1);
+}
+
+// No lights and lights all behind the camera leave every cluster empty
+static void TestEmpty()
+{
+	LightScene scene(0, 1);
+	ClusteredLighting lighting(scene.projection, scene.nearZ, scene.farZ);
+	lighting.Assign(scene.lights.data(), 0, scene.overview);
+	XT_CHECK(lighting.GetLightIndices().empty());
+
+	scene.lights.push_back(Light::Point(Float3{0.f, 5.f, -200.f}, 10.f, Float3{1.f, 1.f, 1.f}));
+	lighting.Assign(scene.lights.data(), scene.lights.size(), scene.overview);
+	XT_CHECK(lighting.GetLightIndices().empty());
+	auto empty = true;
+	for (const auto& range : lighting.GetClusterRanges())
+		empty = empty && range.count == 0;
+	XT_CHECK(empty);
+}
+
+int main()
+{
+	TestAssignment(64);
+	TestAssignment(1000);
+	TestSlices();
+	TestEmpty();
+	return Test::Finish("ClusteredLightingTests");
+}
@@ -0,0 +1,37 @@
+#include <cstdio>
+
+#include "Benchmark.h"
+#include "Gemm.h"
+#include "Test.h"
+
+// GFLOP/s of the blocked Multiply at every SIMD level, on the default pool, against the naive triple loop
+int main()
+{
+	const size_t sizes[] = {128, 256, 512, 1024};
+	std::printf("GemmBenchmark: %zu threads\n", ThreadPool::GetDefault().GetThreadCount());
+
+	for (const auto size : sizes)
+	{
+		const auto a = Test::RandomTensor({size, size}, 1);
+		const auto b = Test::RandomTensor({size, size}, 2);
+		Tensor c({size, size});
+		const auto flops = 2.0 * static_cast<double>(size) * static_cast<double>(size) * static_cast<double>(size);
+
+		Test::ForEachLevel([&](const SimdLevel level)
+		{
+			const auto seconds = Benchmark::Time([&] { Gemm::MatMulInto(c, a, b); });
+			std::printf("  %4zu^3 %-7s %8.2f GFLOP/s\n", size, Test::LevelName(level), flops / seconds * 1e-9);
+		});
+
+		if (size <= 512)
+		{
+			const auto seconds = Benchmark::Time([&]
+			{
+				Gemm::MultiplyNaive(size, size, size, 1.f, Gemm::ToMatrix(a), Gemm::ToMatrix(b), 0.f, c.Data(),
+				                    static_cast<ptrdiff_t>(size));
+			});
+			std::printf("  %4zu^3 %-7s %8.2f GFLOP/s\n", size, "naive", flops / seconds * 1e-9);
+		}
+	}
+	return 0;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "ClusteredLighting.h"
+
+// Point and spot lights scattered over a 200 x 40 x 200 box around the origin, every third one a spot,
+// with two cameras: one looking across the whole box and one standing inside it
+struct LightScene
+{
+	enum : uint32_t
+	{
+		TilesX = 16,
+		TilesY = 9,
+		Slices = 24
+	};
+
+	const float nearZ = 0.1f;
+	const float farZ = 300.f;
+	Float4x4 projection;
+	Float4x4 overview;
+	Float4x4 inside;
+	std::vector<Light> lights;
+
+	LightScene(const size_t lightCount, const unsigned seed)
+		: projection(VectorMath::PerspectiveFovLH(1.f, 16.f / 9.f, nearZ, farZ)),
+		  overview(VectorMath::LookAtLH(Float3{0.f, 5.f, -120.f}, Float3{0.f, 0.f, 0.f}, Float3{0.f, 1.f, 0.f})),
+		  inside(VectorMath::LookAtLH(Float3{3.f, 1.f, 2.f}, Float3{40.f, -3.f, 30.f}, Float3{0.f, 1.f, 0.f}))
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> position(-100.f, 100.f), range(2.f, 15.f), angle(0.1f, 1.2f),
+		                                      axis(-1.f, 1.f);
+		const Float3 white{1.f, 1.f, 1.f};
+		for (size_t i = 0; i < lightCount; ++i)
+		{
+			const Float3 center{position(random), position(random) * 0.2f, position(random)};
+			if (i % 3 == 0)
+			{
+				const auto outer = angle(random);
+				const Float3 direction{axis(random), axis(random) - 0.5f, axis(random)};
+				lights.push_back(Light::Spot(center, direction, range(random) * 2.f, outer, outer * 0.7f, white));
+			}
+			else
+			{
+				lights.push_back(Light::Point(center, range(random), white));
+			}
+		}
+	}
+};
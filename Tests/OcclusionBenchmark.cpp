@@ -0,0 +1,56 @@
+#include <chrono>
+#include <cstdio>
+#include <vector>
+
+#include "Benchmark.h"
+#include "CityScene.h"
+#include "OcclusionCuller.h"
+#include "Test.h"
+
+// Per-phase timings of a street level city frame at every SIMD level and on 1 and 4 threads
+int main()
+{
+	const CityScene scene(80, 80, 4, 3);
+	std::vector<uint8_t> visible(scene.props.size());
+	std::printf("OcclusionBenchmark: %zu buildings, %zu props\n", scene.buildings.size(), scene.props.size());
+
+	ThreadPool single(1), four(4);
+	for (auto* pool : {&single, &four})
+	{
+		Test::ForEachLevel([&](const SimdLevel level)
+		{
+			OcclusionCuller culler(320, 192, *pool);
+			double add = 0.0, render = 0.0, test = 0.0;
+			size_t frames = 0;
+			const auto frame = Benchmark::Time([&]
+			{
+				using Clock = std::chrono::steady_clock;
+				const auto start = Clock::now();
+				culler.BeginFrame(scene.viewProjection.Data());
+				for (const auto& world : scene.buildingWorlds)
+				{
+					culler.AddOccluder(&scene.cubeVertices[0].x, sizeof(Float3), scene.cubeVertices.size(),
+					                   scene.cubeIndices.data(), scene.cubeIndices.size(), world.Data());
+				}
+				const auto added = Clock::now();
+				culler.RenderOccluders();
+				const auto rendered = Clock::now();
+				culler.TestVisibility(scene.props.data(), scene.props.size(), visible.data());
+				const auto tested = Clock::now();
+
+				add += std::chrono::duration<double>(added - start).count();
+				render += std::chrono::duration<double>(rendered - added).count();
+				test += std::chrono::duration<double>(tested - rendered).count();
+				++frames;
+			});
+
+			const auto& stats = culler.GetStats();
+			std::printf("  %-7s %zu threads: %6.2f ms/frame (add %.2f, rasterize %.2f, test %.2f), "
+			            "%zu/%zu triangles rasterized, %zu occluded, %zu offscreen\n",
+			            Test::LevelName(level), pool->GetThreadCount(), frame * 1e3, add / frames * 1e3,
+			            render / frames * 1e3, test / frames * 1e3, stats.rasterizedTriangles, stats.occluderTriangles,
+			            stats.occludedObjects, stats.offscreenObjects);
+		});
+	}
+	return 0;
+}
@@ -0,0 +1,219 @@
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "CityScene.h"
+#include "OcclusionCuller.h"
+#include "Test.h"
+
+static void RenderCity(OcclusionCuller& culler, const CityScene& scene)
+{
+	culler.BeginFrame(scene.viewProjection.Data());
+	for (const auto& world : scene.buildingWorlds)
+	{
+		culler.AddOccluder(&scene.cubeVertices[0].x, sizeof(Float3), scene.cubeVertices.size(), scene.cubeIndices.data(),
+		                   scene.cubeIndices.size(), world.Data());
+	}
+	culler.RenderOccluders();
+}
+
+// Slab test, returns the entry distance along the ray or a negative value on a miss
+static float RayBox(const Float3& origin, const Float3& direction, const Aabb& box)
+{
+	const float o[3] = {origin.x, origin.y, origin.z};
+	const float d[3] = {direction.x, direction.y, direction.z};
+	auto enter = 0.f, exit = 1e30f;
+	for (auto axis = 0; axis < 3; ++axis)
+	{
+		const auto inverse = 1.f / d[axis];
+		auto t0 = (box.min[axis] - o[axis]) * inverse;
+		auto t1 = (box.max[axis] - o[axis]) * inverse;
+		if (t0 > t1)
+			std::swap(t0, t1);
+		enter = std::max(enter, t0);
+		exit = std::min(exit, t1);
+	}
+	return enter <= exit ? enter : -1.f;
+}
+
+// An object may only be culled when no pixel centre ray of the culler's buffer reaches it before a building.
+// Buildings are grown slightly so rays grazing their silhouette count as blocked either way.
+// probed counts the culled props that at least one pixel centre ray hits, props smaller than a pixel may have none.
+static size_t CountWronglyOccluded(const OcclusionCuller& culler, const CityScene& scene,
+                                   const std::vector<uint8_t>& visible, size_t& probed)
+{
+	const auto inverse = VectorMath::Inverse(scene.viewProjection);
+	const auto width = static_cast<float>(culler.GetWidth());
+	const auto height = static_cast<float>(culler.GetHeight());
+	std::vector<Aabb> grown;
+	for (const auto& building : scene.buildings)
+		grown.push_back(building.Expanded(1e-3f));
+
+	size_t wrong = 0;
+	probed = 0;
+	for (size_t i = 0; i < scene.props.size(); ++i)
+	{
+		if (visible[i])
+			continue;
+
+		// Screen rectangle of the prop, the same corner projection the culler uses
+		const auto& prop = scene.props[i];
+		auto minX = width, minY = height, maxX = 0.f, maxY = 0.f;
+		for (auto corner = 0; corner < 8; ++corner)
+		{
+			const Float4 p{corner & 1 ? prop.max[0] : prop.min[0], corner & 2 ? prop.max[1] : prop.min[1],
+			               corner & 4 ? prop.max[2] : prop.min[2], 1.f};
+			const auto clip = VectorMath::Transform(p, scene.viewProjection);
+			const auto x = (clip.x / clip.w * 0.5f + 0.5f) * width;
+			const auto y = (0.5f - clip.y / clip.w * 0.5f) * height;
+			minX = std::min(minX, x);
+			maxX = std::max(maxX, x);
+			minY = std::min(minY, y);
+			maxY = std::max(maxY, y);
+		}
+
+		auto reached = false, hitAny = false;
+		for (auto py = std::max(0.f, std::floor(minY)); py <= std::min(height - 1.f, maxY) && !reached; ++py)
+		{
+			for (auto px = std::max(0.f, std::floor(minX)); px <= std::min(width - 1.f, maxX) && !reached; ++px)
+			{
+				const Float4 ndc{((px + 0.5f) / width) * 2.f - 1.f, 1.f - ((py + 0.5f) / height) * 2.f, 1.f, 1.f};
+				const auto far = VectorMath::Transform(ndc, inverse);
+				const auto direction = VectorMath::Normalize(
+					Float3{far.x / far.w - scene.eye.x, far.y / far.w - scene.eye.y, far.z / far.w - scene.eye.z});
+				const auto hit = RayBox(scene.eye, direction, prop);
+				if (hit < 0.f)
+					continue;
+				reached = true;
+				hitAny = true;
+				for (const auto& building : grown)
+				{
+					const auto blocked = RayBox(scene.eye, direction, building);
+					if (blocked >= 0.f && blocked <= hit)
+					{
+						reached = false;
+						break;
+					}
+				}
+			}
+		}
+		wrong += reached ? 1 : 0;
+		probed += hitAny ? 1 : 0;
+	}
+	return wrong;
+}
+
+// A single wall: boxes behind it are occluded, in front of it, beside it or reaching the camera are not
+static void TestWall()
+{
+	const CityScene scene(0, 0, 0, 1);
+	const auto view = VectorMath::LookAtLH(Float3{0.f, 0.f, -10.f}, Float3{0.f, 0.f, 0.f}, Float3{0.f, 1.f, 0.f});
+	const auto viewProjection = VectorMath::Multiply(view, VectorMath::PerspectiveFovLH(1.2f, 320.f / 192.f, 0.5f, 500.f));
+	const auto wall = VectorMath::Scaling(5.f, 5.f, 0.2f);
+
+	Test::ForEachLevel([&](const SimdLevel)
+	{
+		OcclusionCuller culler(320, 192);
+		culler.BeginFrame(viewProjection.Data());
+		culler.AddOccluder(&scene.cubeVertices[0].x, sizeof(Float3), scene.cubeVertices.size(), scene.cubeIndices.data(),
+		                   scene.cubeIndices.size(), wall.Data());
+		culler.RenderOccluders();
+		XT_CHECK(culler.GetStats().rasterizedTriangles > 0);
+
+		XT_CHECK(!culler.IsVisible(OcclusionBounds{{-1, -1, 5}, {1, 1, 7}}));
+		XT_CHECK(!culler.IsVisible(OcclusionBounds{{-4.5f, -4.5f, 1}, {4.5f, 4.5f, 2}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-1, -1, -5}, {1, 1, -3}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{7, -1, 5}, {9, 1, 7}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{4.5f, -1, 5}, {8, 1, 7}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-1, -1, -11}, {1, 1, -9}}));
+
+		uint8_t visible[2] = {};
+		const OcclusionBounds offscreen[2] = {{{-1, -1, 600}, {1, 1, 602}}, {{200, -1, 5}, {202, 1, 7}}};
+		culler.TestVisibility(offscreen, 2, visible);
+		XT_CHECK(!visible[0] && !visible[1] && culler.GetStats().offscreenObjects == 2);
+	});
+}
+
+// Boxes and occluders reaching billions of pixels off screen, whose bounds do not fit an int before clamping.
+// The view projection is the identity, so x and y are NDC and z is the depth.
+static void TestHugeBounds()
+{
+	const auto identity = VectorMath::Identity();
+
+	// A huge visible box must not be culled against an empty buffer
+	Test::ForEachLevel([&](const SimdLevel)
+	{
+		OcclusionCuller culler(320, 192);
+		culler.BeginFrame(identity.Data());
+		culler.RenderOccluders();
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-0.5f, -0.5f, 0.2f}, {3e7f, 0.5f, 0.4f}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-3e7f, -0.5f, 0.2f}, {0.5f, 0.5f, 0.4f}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-0.5f, -3e7f, 0.2f}, {0.5f, 3e7f, 0.4f}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-0.5f, -0.5f, 0.2f}, {0.5f, 0.5f, 0.4f}}));
+	});
+
+	// A quad just past the near plane that runs far off the right edge still hides what is behind it
+	const Float3 quad[4] = {{-0.9f, -0.9f, 0.01f}, {-0.9f, 0.9f, 0.01f}, {3e7f, 0.9f, 0.01f}, {3e7f, -0.9f, 0.01f}};
+	const uint32_t indices[6] = {0, 1, 2, 0, 2, 3};
+	Test::ForEachLevel([&](const SimdLevel)
+	{
+		OcclusionCuller culler(320, 192);
+		culler.BeginFrame(identity.Data());
+		culler.AddOccluder(&quad[0].x, sizeof(Float3), 4, indices, 6, identity.Data(), true);
+		culler.RenderOccluders();
+		XT_CHECK(culler.GetStats().rasterizedTriangles == 2);
+		XT_CHECK(!culler.IsVisible(OcclusionBounds{{-0.5f, -0.5f, 0.5f}, {0.5f, 0.5f, 0.6f}}));
+		XT_CHECK(!culler.IsVisible(OcclusionBounds{{-0.5f, -0.5f, 0.5f}, {3e7f, 0.5f, 0.6f}}));
+		XT_CHECK(culler.IsVisible(OcclusionBounds{{-0.5f, -0.5f, 0.005f}, {0.5f, 0.5f, 0.6f}}));
+	});
+}
+
+// The street level city: the culler must be conservative against ray casts, hide most of the props,
+// and produce the same depth buffer at every SIMD level and thread count
+static void TestCity()
+{
+	const CityScene scene(40, 40, 4, 3);
+	std::vector<std::vector<float>> depths;
+	std::vector<std::vector<uint8_t>> results;
+
+	ThreadPool single(1), four(4);
+	for (auto* pool : {&single, &four})
+	{
+		Test::ForEachLevel([&](const SimdLevel level)
+		{
+			OcclusionCuller culler(320, 192, *pool);
+			RenderCity(culler, scene);
+			std::vector<uint8_t> visible(scene.props.size());
+			culler.TestVisibility(scene.props.data(), scene.props.size(), visible.data());
+			depths.push_back(culler.GetDepthBuffer());
+			results.push_back(visible);
+
+			const auto& stats = culler.GetStats();
+			std::printf("OcclusionTests: %s, %zu threads, %zu of %zu props occluded, %zu offscreen\n",
+			            Test::LevelName(level), pool->GetThreadCount(), stats.occludedObjects, stats.testedObjects,
+			            stats.offscreenObjects);
+			XT_CHECK(stats.occluderTriangles == scene.buildings.size() * 12);
+			XT_CHECK(stats.occludedObjects > scene.props.size() / 2);
+			if (pool == &four && level == SimdLevel::Scalar)
+			{
+				size_t probed;
+				XT_CHECK(CountWronglyOccluded(culler, scene, visible, probed) == 0);
+				XT_CHECK(probed > stats.occludedObjects / 4);
+			}
+		});
+	}
+
+	for (size_t i = 1; i < depths.size(); ++i)
+	{
+		XT_CHECK(depths[i] == depths[0]);
+		XT_CHECK(results[i] == results[0]);
+	}
+}
+
+int main()
+{
+	TestWall();
+	TestHugeBounds();
+	TestCity();
+	return Test::Finish("OcclusionTests");
+}
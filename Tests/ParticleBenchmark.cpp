@@ -0,0 +1,64 @@
+#include <cstdio>
+#include <vector>
+
+#include "Benchmark.h"
+#include "ParticleSystem.h"
+#include "Test.h"
+
+// Update and vertex write time per 60 Hz frame for about a million live particles at every SIMD level,
+// spread over 16 emitters on the default pool and in one emitter on one thread
+int main()
+{
+	const size_t total = size_t{1} << 20;
+	const size_t emitterCounts[] = {16, 1};
+	std::printf("ParticleBenchmark: %zu particles, %zu threads\n", total, ThreadPool::GetDefault().GetThreadCount());
+
+	for (const auto emitters : emitterCounts)
+	{
+		Test::ForEachLevel([&](const SimdLevel level)
+		{
+			// Lifetimes of one to two seconds and a rate that replaces them keep the emitters close to full
+			ParticleSystem system;
+			const auto capacity = total / emitters;
+			for (size_t i = 0; i < emitters; ++i)
+			{
+				ParticleEmitterDesc desc{};
+				desc.capacity = capacity;
+				desc.rate = static_cast<float>(capacity) / 1.5f;
+				desc.drag = 0.9f;
+				desc.seed = static_cast<uint32_t>(i + 1);
+				system.AddEmitter(desc).Spawn(capacity);
+			}
+
+			std::vector<ParticleVertex> vertices(total);
+			size_t live = 0;
+			size_t frames = 0;
+			const auto update = Benchmark::Time([&]
+			{
+				system.Update(1.f / 60.f);
+				live += system.GetParticleCount();
+				++frames;
+			});
+
+			// The same split as ParticleRenderer::Upload, one emitter range per pool task
+			std::vector<size_t> starts(emitters);
+			for (size_t i = 1; i < emitters; ++i)
+				starts[i] = starts[i - 1] + system.GetEmitter(i - 1).GetCount();
+			const auto write = Benchmark::Time([&]
+			{
+				system.GetPool().ParallelFor(emitters, 1, [&](const size_t begin, const size_t end)
+				{
+					for (auto i = begin; i < end; ++i)
+						system.GetEmitter(i).WriteVertices(vertices.data() + starts[i], total - starts[i]);
+				});
+			});
+			Benchmark::Use(vertices[0]);
+
+			const auto average = static_cast<double>(live) / static_cast<double>(frames);
+			std::printf("  %2zu emitters %-7s %.2fM live, update %6.2f ms (%6.1f M/s), vertex write %6.2f ms (%6.1f M/s)\n",
+			            emitters, Test::LevelName(level), average * 1e-6, update * 1e3, average / update * 1e-6,
+			            write * 1e3, system.GetParticleCount() / write * 1e-6);
+		});
+	}
+	return 0;
+}
@@ -0,0 +1,189 @@
+#include <cstring>
+#include <vector>
+
+#include "ParticleSystem.h"
+#include "Test.h"
+
+static std::vector<float> Lives(const ParticleEmitter& emitter)
+{
+	return std::vector<float>(emitter.GetLife(), emitter.GetLife() + emitter.GetCount());
+}
+
+// Updates emitter with the SIMD level forced, returns false when the CPU does not support it
+static bool UpdateAt(ParticleEmitter& emitter, const SimdLevel level, const float dt)
+{
+	const auto previous = Simd::GetLevel();
+	Simd::SetLevel(level);
+	const auto supported = Simd::GetLevel() == level;
+	if (supported)
+		emitter.Update(dt);
+	Simd::SetLevel(previous);
+	return supported;
+}
+
+// Survivors keep their order, and the AVX2 path keeps exactly the particles the scalar loop keeps.
+// Both paths multiply and add in the same order without fusing, so lives and positions compare bit for bit.
+static void TestCompaction()
+{
+	ParticleEmitterDesc desc{};
+	desc.capacity = 5003;
+	desc.rate = 20000.f;
+	desc.minLifetime = 0.02f;
+	desc.maxLifetime = 0.6f;
+	desc.drag = 0.7f;
+	desc.radius = 0.3f;
+	desc.seed = 9;
+
+	ParticleEmitter scalar(desc);
+	ParticleEmitter avx2(desc);
+	auto avx2Supported = true;
+	size_t maxCount = 0, maxDeaths = 0;
+	for (auto frame = 0; frame < 300; ++frame)
+	{
+		const auto dt = frame % 7 == 0 ? 0.05f : 0.016f;
+
+		std::vector<float> survivors;
+		for (const auto life : Lives(scalar))
+			if (life - dt > 0.f)
+				survivors.push_back(life - dt);
+		maxDeaths = std::max(maxDeaths, scalar.GetCount() - survivors.size());
+
+		UpdateAt(scalar, SimdLevel::Scalar, dt);
+		XT_CHECK(scalar.GetCount() >= survivors.size());
+		XT_CHECK(scalar.GetCount() <= scalar.GetCapacity());
+		XT_CHECK(std::memcmp(scalar.GetLife(), survivors.data(), survivors.size() * sizeof(float)) == 0);
+		maxCount = std::max(maxCount, scalar.GetCount());
+
+		avx2Supported = avx2Supported && UpdateAt(avx2, SimdLevel::Avx2, dt);
+		if (!avx2Supported)
+			continue;
+		XT_CHECK(avx2.GetCount() == scalar.GetCount());
+		if (avx2.GetCount() != scalar.GetCount())
+			return;
+		XT_CHECK(Lives(avx2) == Lives(scalar));
+		const auto bytes = scalar.GetCount() * sizeof(float);
+		XT_CHECK(std::memcmp(avx2.GetPositionX(), scalar.GetPositionX(), bytes) == 0);
+		XT_CHECK(std::memcmp(avx2.GetPositionY(), scalar.GetPositionY(), bytes) == 0);
+		XT_CHECK(std::memcmp(avx2.GetPositionZ(), scalar.GetPositionZ(), bytes) == 0);
+	}
+
+	// The emitter filled up and particles died every frame, so every group shape was packed
+	XT_CHECK(maxCount == scalar.GetCapacity());
+	XT_CHECK(maxDeaths > 100);
+	if (!avx2Supported)
+		std::printf("ParticleTests: AVX2 not supported, compaction compared against the reference only\n");
+}
+
+static void TestCapacity()
+{
+	Test::ForEachLevel([](const SimdLevel)
+	{
+		// Nothing is ever stored, but every entry point still works
+		ParticleEmitterDesc empty{};
+		empty.capacity = 0;
+		empty.rate = 1000.f;
+		ParticleEmitter none(empty);
+		XT_CHECK(none.GetCapacity() == 0);
+		none.Update(1.f);
+		none.Spawn(100);
+		none.Update(0.016f);
+		XT_CHECK(none.GetCount() == 0);
+		ParticleVertex vertex{};
+		XT_CHECK(none.WriteVertices(&vertex, 1) == 0);
+
+		// Rounded up to whole groups of eight, the tail group is only partly live most of the time
+		ParticleEmitterDesc desc{};
+		desc.capacity = 13;
+		desc.rate = 0.f;
+		desc.minLifetime = 0.1f;
+		desc.maxLifetime = 1.f;
+		ParticleEmitter odd(desc);
+		XT_CHECK(odd.GetCapacity() == 16);
+		odd.Spawn(100);
+		XT_CHECK(odd.GetCount() == odd.GetCapacity());
+
+		ParticleEmitter reference(desc);
+		reference.Spawn(100);
+		for (auto step = 0; step < 25; ++step)
+		{
+			odd.Update(0.05f);
+			UpdateAt(reference, SimdLevel::Scalar, 0.05f);
+			XT_CHECK(odd.GetCount() == reference.GetCount());
+			XT_CHECK(Lives(odd) == Lives(reference));
+		}
+		XT_CHECK(odd.GetCount() == 0);
+
+		odd.Spawn(5);
+		odd.Update(0.f);
+		XT_CHECK(odd.GetCount() == 5);
+	});
+}
+
+static void TestVertices()
+{
+	ParticleEmitterDesc desc{};
+	desc.capacity = 100;
+	desc.color = Float4{0.2f, 0.4f, 0.6f, 0.8f};
+	ParticleEmitter emitter(desc);
+	emitter.Spawn(100);
+	emitter.Update(0.5f);
+	XT_CHECK(emitter.GetCount() > 10);
+
+	std::vector<ParticleVertex> vertices(emitter.GetCount());
+	XT_CHECK(emitter.WriteVertices(vertices.data(), vertices.size()) == emitter.GetCount());
+	XT_CHECK(emitter.WriteVertices(vertices.data(), 10) == 10);
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		XT_CHECK(vertices[i].position[0] == emitter.GetPositionX()[i]);
+		XT_CHECK(vertices[i].position[1] == emitter.GetPositionY()[i]);
+		XT_CHECK(vertices[i].position[2] == emitter.GetPositionZ()[i]);
+		XT_CHECK(vertices[i].size == desc.size);
+		XT_CHECK(vertices[i].color[0] == desc.color.x);
+		XT_CHECK(vertices[i].color[3] > 0.f && vertices[i].color[3] <= desc.color.w);
+	}
+}
+
+// Emitters are independent, so the pool size cannot change the result
+static void TestThreads()
+{
+	ThreadPool single(1);
+	ThreadPool four(4);
+	ParticleSystem a(single);
+	ParticleSystem b(four);
+	for (uint32_t i = 0; i < 12; ++i)
+	{
+		ParticleEmitterDesc desc{};
+		desc.capacity = 3000 + i * 17;
+		desc.rate = 4000.f;
+		desc.minLifetime = 0.05f;
+		desc.maxLifetime = 0.5f;
+		desc.seed = i + 1;
+		a.AddEmitter(desc);
+		b.AddEmitter(desc);
+	}
+	for (auto frame = 0; frame < 50; ++frame)
+	{
+		a.Update(0.016f);
+		b.Update(0.016f);
+	}
+
+	XT_CHECK(a.GetParticleCount() > 0);
+	XT_CHECK(a.GetParticleCount() == b.GetParticleCount());
+	for (size_t i = 0; i < a.GetEmitterCount(); ++i)
+	{
+		const auto& x = a.GetEmitter(i);
+		const auto& y = b.GetEmitter(i);
+		XT_CHECK(x.GetCount() == y.GetCount());
+		XT_CHECK(std::memcmp(x.GetPositionX(), y.GetPositionX(), x.GetCount() * sizeof(float)) == 0);
+		XT_CHECK(std::memcmp(x.GetLife(), y.GetLife(), x.GetCount() * sizeof(float)) == 0);
+	}
+}
+
+int main()
+{
+	TestCompaction();
+	TestCapacity();
+	TestVertices();
+	TestThreads();
+	return Test::Finish("ParticleTests");
+}
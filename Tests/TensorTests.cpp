@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+
+#include "Gemm.h"
+#include "TensorOps.h"
+#include "Test.h"
+
+static float MaxDifference(const Tensor& a, const float* b)
+{
+	auto difference = 0.f;
+	for (size_t i = 0; i < a.GetSize(); ++i)
+		difference = std::max(difference, std::fabs(a.Data()[i] - b[i]));
+	return difference;
+}
+
+static void TestViews()
+{
+	const Tensor a({3, 4}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+
+	const auto slice = a.Slice(1, 1, 4, 2);
+	XT_CHECK(slice.GetDim(1) == 2 && slice.At({2, 1}) == 11);
+
+	const auto transposed = a.Transpose(0, 1);
+	XT_CHECK(transposed.At({3, 2}) == 11 && !transposed.IsContiguous());
+
+	const auto contiguous = transposed.Contiguous();
+	XT_CHECK(contiguous.IsContiguous() && contiguous.At({1, 2}) == 9);
+
+	const auto row = a.Index(0, 1);
+	XT_CHECK(row.GetRank() == 1 && row.At({3}) == 7);
+}
+
+static void TestElementwise()
+{
+	const Tensor a({3, 4}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+	const Tensor row({4}, {1, 2, 3, 4});
+	const Tensor column({3, 1}, {10, 20, 30});
+
+	XT_CHECK(TensorOps::Add(a, row).At({2, 3}) == 15);
+	XT_CHECK(TensorOps::MulAdd(a, column, row).At({1, 2}) == 6 * 20 + 3);
+
+	// Strided inputs take the scalar row loop, the result must not depend on it
+	const auto big = Test::RandomTensor({300, 257}, 1);
+	const auto bigT = big.Transpose(0, 1);
+	const auto lerp = TensorOps::Map(TensorOp::Lerp{}, bigT, bigT, Tensor({1}, {0.5f}));
+	XT_CHECK(lerp.At({7, 9}) == big.At({9, 7}));
+
+	const auto doubled = TensorOps::Transform([](const float x) { return x * 2.f; }, big.Slice(0, 0, 10));
+	XT_CHECK(doubled.At({3, 4}) == 2.f * big.At({3, 4}));
+}
+
+static void TestReductions()
+{
+	const Tensor a({3, 4}, {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11});
+	XT_CHECK(TensorOps::Sum(a) == 66);
+	XT_CHECK(TensorOps::Max(a) == 11);
+	XT_CHECK(TensorOps::Min(a.Transpose(0, 1)) == 0);
+
+	const auto columns = TensorOps::Sum(a, 0);
+	XT_CHECK(columns.GetRank() == 1 && columns.At({1}) == 15);
+	XT_CHECK_NEAR(TensorOps::Mean(a, 1).At({2}), 9.5, 1e-6);
+
+	const auto big = Test::RandomTensor({1000, 257}, 2);
+	double reference = 0.0;
+	for (size_t i = 0; i < big.GetSize(); ++i)
+		reference += big.Data()[i];
+	XT_CHECK_NEAR(TensorOps::Sum(big), reference, 1e-2);
+}
+
+// Rank-0 tensors are single rows, reductions and maps see one element
+static void TestRankZero()
+{
+	const Tensor a({4}, {1, 2, 3, 4});
+	const auto scalar = a.Index(0, 2);
+	XT_CHECK(scalar.GetRank() == 0 && scalar.GetSize() == 1);
+
+	XT_CHECK(TensorOps::Sum(scalar) == 3);
+	XT_CHECK(TensorOps::Max(scalar) == 3);
+	XT_CHECK(TensorOps::Mean(scalar) == 3);
+
+	const auto sum = TensorOps::Add(scalar, scalar);
+	XT_CHECK(sum.GetRank() == 0 && sum.Data()[0] == 6);
+
+	const auto broadcast = TensorOps::Add(a, scalar);
+	XT_CHECK(broadcast.GetRank() == 1 && broadcast.At({0}) == 4 && broadcast.At({3}) == 7);
+
+	const auto matrix = Tensor({2, 2}, {1, 2, 3, 4});
+	XT_CHECK(TensorOps::Sum(matrix.Index(0, 1).Index(0, 0)) == 3);
+}
+
+// Multiply against MultiplyNaive over odd shapes that leave partial register tiles and cache blocks,
+// with contiguous, transposed and column-strided operands
+static void TestGemm()
+{
+	const size_t shapes[][3] = {
+		{1, 1, 1}, {7, 17, 5}, {13, 1, 300}, {1, 45, 31}, {150, 33, 300}, {200, 300, 517}, {64, 3100, 20}
+	};
+
+	unsigned seed = 10;
+	for (const auto& shape : shapes)
+	{
+		const auto m = shape[0], n = shape[1], k = shape[2];
+		const auto tolerance = 1e-5f * static_cast<float>(k) + 1e-5f;
+
+		const auto a = Test::RandomTensor({m, k}, ++seed);
+		const auto b = Test::RandomTensor({k, n}, ++seed);
+		const auto c = Gemm::MatMul(a, b);
+		Tensor reference({m, n});
+		Gemm::MultiplyNaive(m, n, k, 1.f, Gemm::ToMatrix(a), Gemm::ToMatrix(b), 0.f, reference.Data(),
+		                    static_cast<ptrdiff_t>(n));
+		XT_CHECK(MaxDifference(c, reference.Data()) <= tolerance);
+
+		// Transposed a, b read every second column, alpha and beta applied on top of existing values
+		const auto aT = Test::RandomTensor({k, m}, ++seed).Transpose(0, 1);
+		const auto bWide = Test::RandomTensor({k, 2 * n}, ++seed);
+		const auto bStrided = bWide.Slice(1, 0, 2 * n, 2);
+		auto accumulated = Test::RandomTensor({m, n}, ++seed);
+		auto expected = accumulated.Clone();
+		Gemm::MatMulInto(accumulated, aT, bStrided, 0.5f, 2.f);
+		Gemm::MultiplyNaive(m, n, k, 0.5f, Gemm::ToMatrix(aT), Gemm::ToMatrix(bStrided), 2.f, expected.Data(),
+		                    static_cast<ptrdiff_t>(n));
+		XT_CHECK(MaxDifference(accumulated, expected.Data()) <= tolerance);
+
+		// Transposed b and an output that is a row slice of a larger matrix
+		const auto bT = Test::RandomTensor({n, k}, ++seed).Transpose(0, 1);
+		Tensor wide({m, n + 3}, 0.f);
+		auto window = wide.Slice(1, 1, n + 1);
+		Gemm::MatMulInto(window, a, bT);
+		Tensor windowExpected({m, n});
+		Gemm::MultiplyNaive(m, n, k, 1.f, Gemm::ToMatrix(a), Gemm::ToMatrix(bT), 0.f, windowExpected.Data(),
+		                    static_cast<ptrdiff_t>(n));
+		XT_CHECK(MaxDifference(window.Contiguous(), windowExpected.Data()) <= tolerance);
+		XT_CHECK(wide.At({m - 1, 0}) == 0.f && wide.At({m - 1, n + 1}) == 0.f && wide.At({m - 1, n + 2}) == 0.f);
+	}
+
+	// k == 0 only scales c by beta
+	Tensor scaled({2, 2}, 3.f);
+	Gemm::MatMulInto(scaled, Tensor({2, 0}), Tensor({0, 2}), 1.f, 0.5f);
+	XT_CHECK(scaled.At({1, 1}) == 1.5f);
+}
+
+int main()
+{
+	Test::ForEachLevel([](const SimdLevel level)
+	{
+		std::printf("TensorTests: %s\n", Test::LevelName(level));
+		TestViews();
+		TestElementwise();
+		TestReductions();
+		TestRankZero();
+		TestGemm();
+	});
+	return Test::Finish("TensorTests");
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Simd.h"
+#include "Tensor.h"
+
+// Checks for the test executables. A failed check is reported and the test keeps going,
+// Finish() returns the exit code.
+struct Test
+{
+	Test() = delete;
+
+	static void Check(const bool passed, const char* expression, const char* file, const int line)
+	{
+		if (passed)
+			return;
+		std::printf("%s:%d: check failed: %s\n", file, line, expression);
+		++Failures();
+	}
+
+	static void CheckNear(const double actual, const double expected, const double tolerance, const char* expression,
+	                      const char* file, const int line)
+	{
+		if (std::fabs(actual - expected) <= tolerance)
+			return;
+		std::printf("%s:%d: check failed: %s, %g is not within %g of %g\n", file, line, expression, actual, tolerance,
+		            expected);
+		++Failures();
+	}
+
+	// Runs func once for every SIMD level the CPU supports, with the level forced through Simd::SetLevel
+	template <class Func>
+	static void ForEachLevel(Func&& func)
+	{
+		const SimdLevel levels[] = {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2};
+		for (const auto level : levels)
+		{
+			Simd::SetLevel(level);
+			if (Simd::GetLevel() == level)
+				func(level);
+		}
+		Simd::ResetLevel();
+	}
+
+	static const char* LevelName(const SimdLevel level)
+	{
+		return level == SimdLevel::Avx2 ? "AVX2" : level == SimdLevel::Sse41 ? "SSE4.1" : "scalar";
+	}
+
+	static std::vector<float> RandomFloats(const size_t count, const float low, const float high, const unsigned seed)
+	{
+		std::mt19937 random(seed);
+		std::uniform_real_distribution<float> distribution(low, high);
+		std::vector<float> values(count);
+		for (auto& value : values)
+			value = distribution(random);
+		return values;
+	}
+
+	// Values uniform in [-1, 1)
+	static Tensor RandomTensor(const TensorShape& shape, const unsigned seed)
+	{
+		Tensor tensor(shape);
+		const auto values = RandomFloats(tensor.GetSize(), -1.f, 1.f, seed);
+		std::copy(values.begin(), values.end(), tensor.Data());
+		return tensor;
+	}
+
+	static int Finish(const char* name)
+	{
+		if (Failures() == 0)
+			std::printf("%s: all checks passed\n", name);
+		else
+			std::printf("%s: %d checks failed\n", name, Failures());
+		return Failures() == 0 ? 0 : 1;
+	}
+
+private:
+	static int& Failures()
+	{
+		static int failures = 0;
+		return failures;
+	}
+};
+
+#define XT_CHECK(expression) Test::Check((expression), #expression, __FILE__, __LINE__)
+#define XT_CHECK_NEAR(actual, expected, tolerance) \
+	Test::CheckNear((actual), (expected), (tolerance), #actual " ~ " #expected, __FILE__, __LINE__)
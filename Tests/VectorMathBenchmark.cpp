@@ -0,0 +1,46 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+
+#include "Benchmark.h"
+#include "Test.h"
+#include "VectorMath.h"
+
+// Nanoseconds per element of each batch operation at every SIMD level, over a batch that stays in L2
+int main()
+{
+	const size_t count = 4096;
+	std::mt19937 random(7);
+	std::uniform_real_distribution<float> distribution(-2.f, 2.f);
+	std::vector<Float4x4> a(count), b(count), out(count);
+	std::vector<Float4> vectors(count), transformed(count);
+	for (size_t i = 0; i < count; ++i)
+	{
+		for (auto row = 0; row < 4; ++row)
+		{
+			for (auto column = 0; column < 4; ++column)
+			{
+				a[i].m[row][column] = distribution(random);
+				b[i].m[row][column] = distribution(random);
+			}
+		}
+		vectors[i] = Float4{distribution(random), distribution(random), distribution(random), 1.f};
+	}
+
+	std::printf("VectorMathBenchmark: %zu elements\n", count);
+	Test::ForEachLevel([&](const SimdLevel level)
+	{
+		const auto report = [&](const char* operation, const double seconds)
+		{
+			std::printf("  %-7s %-16s %7.2f ns\n", Test::LevelName(level), operation, seconds / count * 1e9);
+		};
+		report("multiply", Benchmark::Time([&] { VectorMath::MultiplyBatch(a.data(), b.data(), out.data(), count); }));
+		report("multiply shared", Benchmark::Time([&] { VectorMath::MultiplyBatch(a.data(), b[0], out.data(), count); }));
+		report("transpose", Benchmark::Time([&] { VectorMath::TransposeBatch(a.data(), out.data(), count); }));
+		report("inverse", Benchmark::Time([&] { VectorMath::InverseBatch(a.data(), out.data(), count); }));
+		report("transform", Benchmark::Time([&] { VectorMath::TransformBatch(vectors.data(), b[0], transformed.data(), count); }));
+		Benchmark::Use(out[count - 1]);
+		Benchmark::Use(transformed[count - 1]);
+	});
+	return 0;
+}
@@ -0,0 +1,177 @@
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "Test.h"
+#include "VectorMath.h"
+
+static Float4x4 RandomMatrix(std::mt19937& random)
+{
+	std::uniform_real_distribution<float> distribution(-2.f, 2.f);
+	Float4x4 matrix;
+	for (auto& row : matrix.m)
+		for (auto& value : row)
+			value = distribution(random);
+	return matrix;
+}
+
+template <class T>
+static bool SameBits(const std::vector<T>& a, const std::vector<T>& b)
+{
+	return a.size() == b.size() && (a.empty() || std::memcmp(a.data(), b.data(), a.size() * sizeof(T)) == 0);
+}
+
+struct BatchResults
+{
+	std::vector<Float4x4> multiplied;
+	std::vector<Float4x4> multipliedShared;
+	std::vector<Float4x4> transposed;
+	std::vector<Float4x4> inverted;
+	std::vector<float> determinants;
+	std::vector<Float4> transformed;
+};
+
+// Every batch operation at every SIMD level must reproduce the scalar bits, including the odd tails
+// of the AVX2 loops, in place use and the single matrix wrappers
+static void TestLevelsMatch()
+{
+	std::mt19937 random(7);
+	const size_t counts[] = {0, 1, 2, 3, 7, 1025};
+	for (const auto count : counts)
+	{
+		std::vector<Float4x4> a(count), b(count);
+		std::vector<Float4> vectors(count);
+		for (size_t i = 0; i < count; ++i)
+		{
+			a[i] = RandomMatrix(random);
+			b[i] = RandomMatrix(random);
+			const auto source = RandomMatrix(random);
+			vectors[i] = Float4{source.m[0][0], source.m[0][1], source.m[0][2], source.m[0][3]};
+		}
+		// A singular matrix, its inverse is inf/NaN on every level
+		if (count > 2)
+			a[2].m[3][0] = a[2].m[3][1] = a[2].m[3][2] = a[2].m[3][3] = 0.f;
+		const auto shared = RandomMatrix(random);
+
+		std::vector<BatchResults> results;
+		Test::ForEachLevel([&](const SimdLevel)
+		{
+			BatchResults r;
+			r.multiplied.resize(count);
+			VectorMath::MultiplyBatch(a.data(), b.data(), r.multiplied.data(), count);
+			r.multipliedShared.resize(count);
+			VectorMath::MultiplyBatch(a.data(), shared, r.multipliedShared.data(), count);
+			r.transposed.resize(count);
+			VectorMath::TransposeBatch(a.data(), r.transposed.data(), count);
+			r.inverted.resize(count);
+			r.determinants.resize(count);
+			VectorMath::InverseBatch(a.data(), r.inverted.data(), count, r.determinants.data());
+			r.transformed = vectors;
+			VectorMath::TransformBatch(r.transformed.data(), shared, r.transformed.data(), count);
+
+			// In place batches and the single matrix calls agree with the batch results
+			auto inPlace = a;
+			VectorMath::MultiplyBatch(inPlace.data(), b.data(), inPlace.data(), count);
+			XT_CHECK(SameBits(inPlace, r.multiplied));
+			inPlace = a;
+			VectorMath::TransposeBatch(inPlace.data(), inPlace.data(), count);
+			XT_CHECK(SameBits(inPlace, r.transposed));
+			inPlace = a;
+			VectorMath::InverseBatch(inPlace.data(), inPlace.data(), count);
+			XT_CHECK(SameBits(inPlace, r.inverted));
+			if (count > 4)
+			{
+				const auto single = VectorMath::Multiply(a[4], b[4]);
+				XT_CHECK(std::memcmp(&single, &r.multiplied[4], sizeof(Float4x4)) == 0);
+				float determinant;
+				const auto inverse = VectorMath::Inverse(a[4], &determinant);
+				XT_CHECK(std::memcmp(&inverse, &r.inverted[4], sizeof(Float4x4)) == 0);
+				XT_CHECK(determinant == r.determinants[4]);
+				const auto transformed = VectorMath::Transform(vectors[4], shared);
+				XT_CHECK(std::memcmp(&transformed, &r.transformed[4], sizeof(Float4)) == 0);
+			}
+			results.push_back(std::move(r));
+		});
+
+		for (const auto& r : results)
+		{
+			XT_CHECK(SameBits(r.multiplied, results[0].multiplied));
+			XT_CHECK(SameBits(r.multipliedShared, results[0].multipliedShared));
+			XT_CHECK(SameBits(r.transposed, results[0].transposed));
+			XT_CHECK(SameBits(r.inverted, results[0].inverted));
+			XT_CHECK(SameBits(r.determinants, results[0].determinants));
+			XT_CHECK(SameBits(r.transformed, results[0].transformed));
+		}
+		if (count > 2)
+			XT_CHECK(results[0].determinants[2] == 0.f);
+	}
+}
+
+// The scalar reference against double precision
+static void TestAccuracy()
+{
+	std::mt19937 random(11);
+	auto multiplyError = 0.0, inverseError = 0.0;
+	for (auto i = 0; i < 2000; ++i)
+	{
+		const auto a = RandomMatrix(random);
+		const auto b = RandomMatrix(random);
+		float determinant;
+		const auto product = VectorMath::Multiply(a, b);
+		const auto inverse = VectorMath::Inverse(a, &determinant);
+		const auto transposed = VectorMath::Transpose(a);
+		for (auto row = 0; row < 4; ++row)
+		{
+			for (auto column = 0; column < 4; ++column)
+			{
+				auto expected = 0.0, identity = 0.0;
+				for (auto k = 0; k < 4; ++k)
+				{
+					expected += static_cast<double>(a.m[row][k]) * b.m[k][column];
+					identity += static_cast<double>(a.m[row][k]) * inverse.m[k][column];
+				}
+				multiplyError = std::max(multiplyError, std::fabs(expected - product.m[row][column]));
+				if (std::fabs(determinant) > 0.5f)
+					inverseError = std::max(inverseError, std::fabs(identity - (row == column ? 1.0 : 0.0)));
+				XT_CHECK(transposed.m[row][column] == a.m[column][row]);
+			}
+		}
+	}
+	XT_CHECK(multiplyError < 1e-5);
+	XT_CHECK(inverseError < 1e-3);
+}
+
+// Constructors match the DirectXMath conventions they replace
+static void TestConstructors()
+{
+	const auto view = VectorMath::LookAtLH(Float3{0.f, 3.f, -8.f}, Float3{0.f, 0.f, 0.f}, Float3{0.f, 1.f, 0.f});
+	const auto origin = VectorMath::Transform(Float4{0.f, 0.f, 0.f, 1.f}, view);
+	XT_CHECK_NEAR(origin.z, std::sqrt(73.0), 1e-4);
+	XT_CHECK_NEAR(origin.x, 0.0, 1e-6);
+	XT_CHECK_NEAR(origin.y, 0.0, 1e-5);
+
+	const auto projection = VectorMath::PerspectiveFovLH(0.4f * 3.14f, 1280.f / 720.f, 1.f, 1000.f);
+	const auto nearPoint = VectorMath::Transform(Float4{0.f, 0.f, 1.f, 1.f}, projection);
+	const auto farPoint = VectorMath::Transform(Float4{0.f, 0.f, 1000.f, 1.f}, projection);
+	XT_CHECK_NEAR(nearPoint.z / nearPoint.w, 0.0, 1e-6);
+	XT_CHECK_NEAR(farPoint.z / farPoint.w, 1.0, 1e-6);
+
+	// XMMatrixRotationY takes +x to -z, XMMatrixRotationX and Z put sin at [1][2] and [0][1]
+	const auto rotated = VectorMath::Transform(Float4{1.f, 0.f, 0.f, 1.f}, VectorMath::RotationAxis(Float3{0.f, 1.f, 0.f}, 1.5707963f));
+	XT_CHECK_NEAR(rotated.z, -1.0, 1e-6);
+	XT_CHECK_NEAR(VectorMath::RotationAxis(Float3{1.f, 0.f, 0.f}, 0.3f).m[1][2], std::sin(0.3f), 1e-7);
+	XT_CHECK_NEAR(VectorMath::RotationAxis(Float3{0.f, 0.f, 2.f}, 0.3f).m[0][1], std::sin(0.3f), 1e-7);
+
+	const auto scaledThenMoved = VectorMath::Multiply(VectorMath::Scaling(2.f, 2.f, 2.f), VectorMath::Translation(1.f, 2.f, 3.f));
+	const auto point = VectorMath::Transform(Float4{1.f, 1.f, 1.f, 1.f}, scaledThenMoved);
+	XT_CHECK(point.x == 3.f && point.y == 4.f && point.z == 5.f && point.w == 1.f);
+}
+
+int main()
+{
+	TestLevelsMatch();
+	TestAccuracy();
+	TestConstructors();
+	return Test::Finish("VectorMathTests");
+}
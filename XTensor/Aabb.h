@@ -0,0 +1,99 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+// Axis aligned bounding box, min > max on any axis means empty
+struct Aabb
+{
+	float min[3];
+	float max[3];
+
+	static Aabb Empty()
+	{
+		return Aabb{{FLT_MAX, FLT_MAX, FLT_MAX}, {-FLT_MAX, -FLT_MAX, -FLT_MAX}};
+	}
+
+	static Aabb Union(const Aabb& a, const Aabb& b)
+	{
+		return Aabb{
+			{std::min(a.min[0], b.min[0]), std::min(a.min[1], b.min[1]), std::min(a.min[2], b.min[2])},
+			{std::max(a.max[0], b.max[0]), std::max(a.max[1], b.max[1]), std::max(a.max[2], b.max[2])}
+		};
+	}
+
+	void Extend(const float* point)
+	{
+		for (auto i = 0; i < 3; ++i)
+		{
+			min[i] = std::min(min[i], point[i]);
+			max[i] = std::max(max[i], point[i]);
+		}
+	}
+
+	Aabb Expanded(const float margin) const
+	{
+		return Aabb{
+			{min[0] - margin, min[1] - margin, min[2] - margin},
+			{max[0] + margin, max[1] + margin, max[2] + margin}
+		};
+	}
+
+	// Half the surface area, SAH only compares ratios so the factor of two is dropped
+	float HalfArea() const
+	{
+		const auto dx = max[0] - min[0];
+		const auto dy = max[1] - min[1];
+		const auto dz = max[2] - min[2];
+		return dx * dy + dy * dz + dz * dx;
+	}
+
+	float Center(const int axis) const { return (min[axis] + max[axis]) * 0.5f; }
+
+	bool Contains(const Aabb& other) const
+	{
+		return min[0] <= other.min[0] && min[1] <= other.min[1] && min[2] <= other.min[2] &&
+			max[0] >= other.max[0] && max[1] >= other.max[1] && max[2] >= other.max[2];
+	}
+
+	bool Overlaps(const Aabb& other) const
+	{
+		return min[0] <= other.max[0] && max[0] >= other.min[0] &&
+			min[1] <= other.max[1] && max[1] >= other.min[1] &&
+			min[2] <= other.max[2] && max[2] >= other.min[2];
+	}
+
+	// Slab test against the ray segment [0, maxT], inverse is Ray::InverseDirection
+	bool IntersectRay(const float* origin, const float* inverse, const float maxT) const
+	{
+		auto tNear = 0.f;
+		auto tFar = maxT;
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			const auto t0 = (min[axis] - origin[axis]) * inverse[axis];
+			const auto t1 = (max[axis] - origin[axis]) * inverse[axis];
+			tNear = std::max(tNear, std::min(t0, t1));
+			tFar = std::min(tFar, std::max(t0, t1));
+		}
+		return tNear <= tFar;
+	}
+};
+
+// Half line origin + t * direction for t in [0, maxT]
+struct Ray
+{
+	float origin[3];
+	float direction[3];
+	float maxT;
+
+	// Zero components are nudged away from zero so slab tests never compute 0 * inf = NaN
+	void InverseDirection(float* inverse) const
+	{
+		for (auto i = 0; i < 3; ++i)
+		{
+			const auto d = std::fabs(direction[i]) < 1e-20f ? std::copysign(1e-20f, direction[i]) : direction[i];
+			inverse[i] = 1.f / d;
+		}
+	}
+};
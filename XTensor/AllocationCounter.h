@@ -0,0 +1,224 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+struct AllocationStats
+{
+	uint64_t count = 0;
+	uint64_t bytes = 0;
+	uint64_t frees = 0;
+};
+
+// Counts every global operator new and delete of the process.
+// The counting operators are only compiled into the one translation unit that defines
+// XT_ALLOCATION_HOOKS before including this header, every other file just reads the counters.
+// Counters are process wide, so allocations made by pool threads during a frame are included.
+struct AllocationCounter
+{
+	AllocationCounter() = delete;
+
+	static AllocationStats GetTotals()
+	{
+		AllocationStats stats;
+		stats.count = Counters().count.load(std::memory_order_relaxed);
+		stats.bytes = Counters().bytes.load(std::memory_order_relaxed);
+		stats.frees = Counters().frees.load(std::memory_order_relaxed);
+		return stats;
+	}
+
+	// False when no translation unit installed the hooks, the counters then stay at zero
+	static bool IsEnabled() { return Counters().enabled.load(std::memory_order_relaxed); }
+
+	static void RecordAllocation(const size_t bytes)
+	{
+		Counters().count.fetch_add(1, std::memory_order_relaxed);
+		Counters().bytes.fetch_add(bytes, std::memory_order_relaxed);
+	}
+
+	static void RecordFree() { Counters().frees.fetch_add(1, std::memory_order_relaxed); }
+
+	static void Enable() { Counters().enabled.store(true, std::memory_order_relaxed); }
+
+private:
+	struct State
+	{
+		std::atomic<uint64_t> count{0};
+		std::atomic<uint64_t> bytes{0};
+		std::atomic<uint64_t> frees{0};
+		std::atomic<bool> enabled{false};
+	};
+
+	// Constant initialized, so it is usable from operator new during static initialization
+	static State& Counters()
+	{
+		static State state;
+		return state;
+	}
+};
+
+// Heap activity between construction and Stop() or destruction.
+// Scopes nest, an outer scope includes what its inner scopes counted.
+struct AllocationScope
+{
+	AllocationScope()
+		: m_start(AllocationCounter::GetTotals())
+	{
+	}
+
+	// The delta is added to total when the scope ends, e.g. to accumulate one system over a frame
+	explicit AllocationScope(AllocationStats& total)
+		: m_start(AllocationCounter::GetTotals()), m_total(&total)
+	{
+	}
+
+	~AllocationScope() { Stop(); }
+
+	AllocationScope(const AllocationScope&) = delete;
+	AllocationScope& operator=(const AllocationScope&) = delete;
+
+	AllocationStats GetDelta() const
+	{
+		if (m_stopped)
+			return m_delta;
+
+		const auto now = AllocationCounter::GetTotals();
+		AllocationStats delta;
+		delta.count = now.count - m_start.count;
+		delta.bytes = now.bytes - m_start.bytes;
+		delta.frees = now.frees - m_start.frees;
+		return delta;
+	}
+
+	void Stop()
+	{
+		if (m_stopped)
+			return;
+
+		m_delta = GetDelta();
+		m_stopped = true;
+		if (m_total)
+		{
+			m_total->count += m_delta.count;
+			m_total->bytes += m_delta.bytes;
+			m_total->frees += m_delta.frees;
+		}
+	}
+
+private:
+	AllocationStats m_start;
+	AllocationStats m_delta;
+	AllocationStats* m_total = nullptr;
+	bool m_stopped = false;
+};
+
+// Per-frame heap statistics for the main loop, BeginFrame/EndFrame bracket one frame.
+// A frame counts as steady once `warmUpFrames` frames have passed, IsSteadyStateClean() then tells
+// whether every later frame stayed off the heap.
+struct FrameAllocationTracker
+{
+	explicit FrameAllocationTracker(const uint64_t warmUpFrames = 60)
+		: m_warmUpFrames(warmUpFrames)
+	{
+	}
+
+	void BeginFrame() { m_start = AllocationCounter::GetTotals(); }
+
+	void EndFrame()
+	{
+		const auto now = AllocationCounter::GetTotals();
+		m_last.count = now.count - m_start.count;
+		m_last.bytes = now.bytes - m_start.bytes;
+		m_last.frees = now.frees - m_start.frees;
+		m_lastAllocated = ++m_frame > m_warmUpFrames && m_last.count > 0;
+		if (m_lastAllocated)
+			++m_allocatingFrames;
+	}
+
+	// True when the last frame was past the warm-up and touched the heap
+	bool LastFrameAllocated() const { return m_lastAllocated; }
+
+	const AllocationStats& GetLastFrame() const { return m_last; }
+	uint64_t GetFrameCount() const { return m_frame; }
+	uint64_t GetAllocatingFrames() const { return m_allocatingFrames; }
+	bool IsSteadyStateClean() const { return m_allocatingFrames == 0; }
+
+private:
+	AllocationStats m_start;
+	AllocationStats m_last;
+	uint64_t m_warmUpFrames;
+	uint64_t m_frame = 0;
+	uint64_t m_allocatingFrames = 0;
+	bool m_lastAllocated = false;
+};
+
+#ifdef XT_ALLOCATION_HOOKS
+// Replacement operators, they have to be defined exactly once per program.
+// C++14 has no aligned forms, the remaining forms forward to these.
+void* operator new(const size_t bytes)
+{
+	AllocationCounter::RecordAllocation(bytes);
+	if (auto ptr = std::malloc(bytes ? bytes : 1))
+		return ptr;
+	throw std::bad_alloc{};
+}
+
+void* operator new[](const size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void* operator new(const size_t bytes, const std::nothrow_t&) noexcept
+{
+	AllocationCounter::RecordAllocation(bytes);
+	return std::malloc(bytes ? bytes : 1);
+}
+
+void* operator new[](const size_t bytes, const std::nothrow_t& tag) noexcept
+{
+	return operator new(bytes, tag);
+}
+
+void operator delete(void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+	AllocationCounter::RecordFree();
+	std::free(ptr);
+}
+
+void operator delete[](void* ptr) noexcept
+{
+	if (!ptr)
+		return;
+	AllocationCounter::RecordFree();
+	std::free(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept
+{
+	operator delete[](ptr);
+}
+
+void operator delete(void* ptr, const std::nothrow_t&) noexcept
+{
+	operator delete(ptr);
+}
+
+void operator delete[](void* ptr, const std::nothrow_t&) noexcept
+{
+	operator delete[](ptr);
+}
+
+namespace
+{
+	const auto g_allocationHooksEnabled = (AllocationCounter::Enable(), true);
+}
+#endif
@@ -0,0 +1,373 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "VectorMath.h"
+
+// Local transform of one bone relative to its parent, scale is uniform
+// 32 bytes, so a whole transform fits one AVX register
+struct BoneTransform
+{
+	Float4 rotation;
+	Float3 translation;
+	float scale;
+};
+
+// Bone hierarchy with the bind pose. Parents precede their children, the root has parent -1.
+struct Skeleton
+{
+	Skeleton(const std::vector<int32_t>& parents, const std::vector<BoneTransform>& bindPose)
+		: m_parents(parents), m_bindPose(bindPose), m_inverseBind(parents.size())
+	{
+		assert(parents.size() == bindPose.size() && "Every bone needs a bind transform.");
+		for (size_t bone = 0; bone < parents.size(); ++bone)
+			assert(parents[bone] < static_cast<int32_t>(bone) && "Parents must precede their children.");
+
+		std::vector<Float4x4> model(parents.size());
+		LocalToModel(m_bindPose.data(), model.data());
+		VectorMath::InverseBatch(model.data(), m_inverseBind.data(), model.size());
+	}
+
+	// Composes local transforms down the hierarchy into model space
+	void LocalToModel(const BoneTransform* local, Float4x4* model) const
+	{
+		for (size_t bone = 0; bone < m_parents.size(); ++bone)
+		{
+			const auto matrix = Compose(local[bone]);
+			const auto parent = m_parents[bone];
+			model[bone] = parent < 0 ? matrix : VectorMath::Multiply(matrix, model[parent]);
+		}
+	}
+
+	// Skinning matrices, inverse bind times model space, so the bind pose yields identities
+	void ModelToPalette(const Float4x4* model, Float4x4* palette) const
+	{
+		VectorMath::MultiplyBatch(m_inverseBind.data(), model, palette, m_parents.size());
+	}
+
+	// Scale, then rotation, then translation
+	static Float4x4 Compose(const BoneTransform& transform)
+	{
+		auto matrix = VectorMath::RotationQuaternion(transform.rotation);
+		for (auto row = 0; row < 3; ++row)
+			for (auto column = 0; column < 3; ++column)
+				matrix.m[row][column] *= transform.scale;
+		matrix.m[3][0] = transform.translation.x;
+		matrix.m[3][1] = transform.translation.y;
+		matrix.m[3][2] = transform.translation.z;
+		return matrix;
+	}
+
+	size_t GetBoneCount() const { return m_parents.size(); }
+	const auto& GetParents() const { return m_parents; }
+	const auto& GetBindPose() const { return m_bindPose; }
+	const auto& GetInverseBind() const { return m_inverseBind; }
+
+private:
+	std::vector<int32_t> m_parents;
+	std::vector<BoneTransform> m_bindPose;
+	std::vector<Float4x4> m_inverseBind;
+};
+
+// Unit quaternion in 48 bits ("smallest three"). The largest component is dropped and rebuilt from the
+// others, which then lie within +-1/sqrt(2) and are stored with 15 bits each. The two spare top bits
+// hold the index of the dropped component. The stored components are off by at most 2.2e-5, the rebuilt
+// one by at most 7e-5.
+struct QuantizedQuaternion
+{
+	uint16_t data[3];
+
+	static QuantizedQuaternion Encode(const Float4& quaternion)
+	{
+		float q[4] = {quaternion.x, quaternion.y, quaternion.z, quaternion.w};
+		auto largest = 0;
+		for (auto i = 1; i < 4; ++i)
+			if (std::fabs(q[i]) > std::fabs(q[largest]))
+				largest = i;
+
+		// q and -q are the same rotation, flip so the dropped component is positive
+		const auto length = std::sqrt((q[0] * q[0] + q[1] * q[1]) + (q[2] * q[2] + q[3] * q[3]));
+		const auto scale = (q[largest] < 0.f ? -1.f : 1.f) / length;
+
+		QuantizedQuaternion result{};
+		for (int i = 0, slot = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			const auto normalized = std::min(std::max(q[i] * scale * Sqrt2() * 0.5f + 0.5f, 0.f), 1.f);
+			result.data[slot++] = static_cast<uint16_t>(std::lround(normalized * Max));
+		}
+		result.data[0] |= static_cast<uint16_t>((largest & 1) << 15);
+		result.data[1] |= static_cast<uint16_t>((largest >> 1) << 15);
+		return result;
+	}
+
+	Float4 Decode() const
+	{
+		const auto largest = (data[0] >> 15) | ((data[1] >> 15) << 1);
+		float q[4];
+		auto sum = 0.f;
+		for (int i = 0, slot = 0; i < 4; ++i)
+		{
+			if (i == largest)
+				continue;
+			const auto value = static_cast<float>(data[slot++] & Max);
+			q[i] = (value * (1.f / Max) - 0.5f) * Sqrt2();
+			sum += q[i] * q[i];
+		}
+		q[largest] = std::sqrt(std::max(1.f - sum, 0.f));
+		return Float4{q[0], q[1], q[2], q[3]};
+	}
+
+private:
+	enum : uint16_t
+	{
+		Max = 0x7fff
+	};
+
+	static float Sqrt2() { return 1.41421356f; }
+};
+
+// Keyframes sampled at a fixed rate for every bone of a skeleton. Rotations are stored quantized,
+// translations and scales as floats, and a track that never changes keeps a single key.
+// Each bone's keys are contiguous, so sampling reads two neighbouring keys per track.
+struct AnimationClip
+{
+	// frames holds frameCount poses of boneCount transforms each, frame major
+	AnimationClip(const size_t boneCount, const size_t frameCount, const float sampleRate,
+	              const BoneTransform* frames)
+		: m_tracks(boneCount), m_frameCount(std::max<size_t>(frameCount, 1)), m_sampleRate(sampleRate)
+	{
+		assert(frameCount > 0 && sampleRate > 0.f);
+		for (size_t bone = 0; bone < boneCount; ++bone)
+		{
+			auto& track = m_tracks[bone];
+			const auto key = [&](const size_t frame) -> const BoneTransform& { return frames[frame * boneCount + bone]; };
+
+			track.rotation = static_cast<uint32_t>(m_rotations.size());
+			track.translation = static_cast<uint32_t>(m_translations.size());
+			track.scale = static_cast<uint32_t>(m_scales.size());
+
+			const auto first = QuantizedQuaternion::Encode(key(0).rotation);
+			for (size_t frame = 0; frame < m_frameCount; ++frame)
+			{
+				const auto rotation = QuantizedQuaternion::Encode(key(frame).rotation);
+				const auto& translation = key(frame).translation;
+				if (rotation.data[0] != first.data[0] || rotation.data[1] != first.data[1] || rotation.data[2] != first.data[2])
+					track.animated |= AnimatedRotation;
+				if (translation.x != key(0).translation.x || translation.y != key(0).translation.y ||
+					translation.z != key(0).translation.z)
+					track.animated |= AnimatedTranslation;
+				if (key(frame).scale != key(0).scale)
+					track.animated |= AnimatedScale;
+			}
+
+			const auto count = [&](const uint8_t flag) { return track.animated & flag ? m_frameCount : 1; };
+			for (size_t frame = 0; frame < count(AnimatedRotation); ++frame)
+				m_rotations.push_back(QuantizedQuaternion::Encode(key(frame).rotation));
+			for (size_t frame = 0; frame < count(AnimatedTranslation); ++frame)
+				m_translations.push_back(key(frame).translation);
+			for (size_t frame = 0; frame < count(AnimatedScale); ++frame)
+				m_scales.push_back(key(frame).scale);
+		}
+	}
+
+	// Interpolated local pose at time seconds, looping wraps the time into the clip, otherwise it is clamped
+	void Sample(const float time, BoneTransform* pose, const bool loop = true) const
+	{
+		const auto position = WrapTime(time, loop) * m_sampleRate;
+		const auto frame0 = std::min(static_cast<size_t>(position), m_frameCount - 1);
+		const auto frame1 = std::min(frame0 + 1, m_frameCount - 1);
+		const auto alpha = std::min(position - static_cast<float>(frame0), 1.f);
+
+		thread_local std::vector<BoneTransform> next;
+		next.resize(m_tracks.size());
+		Decode(frame0, pose);
+		Decode(frame1, next.data());
+		BlendPoses(pose, next.data(), alpha, pose, m_tracks.size());
+	}
+
+	// Keys of one frame without interpolation
+	void Decode(const size_t frame, BoneTransform* pose) const
+	{
+		for (size_t bone = 0; bone < m_tracks.size(); ++bone)
+		{
+			const auto& track = m_tracks[bone];
+			const auto key = [&](const uint32_t offset, const uint8_t flag) { return offset + (track.animated & flag ? frame : 0); };
+			pose[bone].rotation = m_rotations[key(track.rotation, AnimatedRotation)].Decode();
+			pose[bone].translation = m_translations[key(track.translation, AnimatedTranslation)];
+			pose[bone].scale = m_scales[key(track.scale, AnimatedScale)];
+		}
+	}
+
+	// out[i] = nlerp(a[i], b[i], weight), rotations take the shorter arc. out may alias a or b.
+	static void BlendPoses(const BoneTransform* a, const BoneTransform* b, const float weight, BoneTransform* out,
+	                       const size_t count)
+	{
+#if XT_SIMD_X86
+		if (Simd::HasAvx2())
+			return BlendAvx2(a, b, weight, out, count);
+#endif
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto& qa = a[i].rotation;
+			auto qb = b[i].rotation;
+			if ((qa.x * qb.x + qa.y * qb.y) + (qa.z * qb.z + qa.w * qb.w) < 0.f)
+				qb = Float4{-qb.x, -qb.y, -qb.z, -qb.w};
+
+			const auto lerp = [weight](const float x, const float y) { return x + (y - x) * weight; };
+			const auto q = Float4{lerp(qa.x, qb.x), lerp(qa.y, qb.y), lerp(qa.z, qb.z), lerp(qa.w, qb.w)};
+			const auto length = std::sqrt((q.x * q.x + q.y * q.y) + (q.z * q.z + q.w * q.w));
+
+			BoneTransform result;
+			result.rotation = Float4{q.x / length, q.y / length, q.z / length, q.w / length};
+			result.translation = Float3{
+				lerp(a[i].translation.x, b[i].translation.x),
+				lerp(a[i].translation.y, b[i].translation.y),
+				lerp(a[i].translation.z, b[i].translation.z)
+			};
+			result.scale = lerp(a[i].scale, b[i].scale);
+			out[i] = result;
+		}
+	}
+
+	float GetDuration() const { return static_cast<float>(m_frameCount - 1) / m_sampleRate; }
+	float GetSampleRate() const { return m_sampleRate; }
+	size_t GetFrameCount() const { return m_frameCount; }
+	size_t GetBoneCount() const { return m_tracks.size(); }
+
+	// Bytes of key data, compared to frameCount * boneCount * sizeof(BoneTransform) uncompressed
+	size_t GetKeyBytes() const
+	{
+		return m_rotations.size() * sizeof(QuantizedQuaternion) + m_translations.size() * sizeof(Float3) +
+			m_scales.size() * sizeof(float);
+	}
+
+private:
+	enum : uint8_t
+	{
+		AnimatedRotation = 1,
+		AnimatedTranslation = 2,
+		AnimatedScale = 4
+	};
+
+	// First key of each of a bone's tracks, a track without its animated flag has one key
+	struct Track
+	{
+		uint32_t rotation;
+		uint32_t translation;
+		uint32_t scale;
+		uint8_t animated = 0;
+	};
+
+	float WrapTime(const float time, const bool loop) const
+	{
+		const auto duration = GetDuration();
+		if (duration <= 0.f)
+			return 0.f;
+		if (!loop)
+			return std::min(std::max(time, 0.f), duration);
+		const auto wrapped = std::fmod(time, duration);
+		return wrapped < 0.f ? wrapped + duration : wrapped;
+	}
+
+#if XT_SIMD_X86
+	// One bone per register, rotation in the low lane and translation and scale in the high lane.
+	// Multiply and add stay separate and dpps sums (x + y) + (z + w), so the result matches the scalar
+	// loop bit for bit.
+	static XT_TARGET_AVX2_NOFMA void BlendAvx2(const BoneTransform* a, const BoneTransform* b, const float weight,
+	                                            BoneTransform* out, const size_t count)
+	{
+		const auto w = _mm256_set1_ps(weight);
+		const auto lowSign = _mm256_castsi256_ps(_mm256_setr_epi32(static_cast<int>(0x80000000), static_cast<int>(0x80000000),
+		                                                           static_cast<int>(0x80000000), static_cast<int>(0x80000000),
+		                                                           0, 0, 0, 0));
+		const auto one = _mm256_set1_ps(1.f);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto va = _mm256_loadu_ps(&a[i].rotation.x);
+			auto vb = _mm256_loadu_ps(&b[i].rotation.x);
+			// The dot product lands in all four low lanes, a negative one flips b's rotation only
+			const auto negative = _mm256_cmp_ps(_mm256_dp_ps(va, vb, 0xff), _mm256_setzero_ps(), _CMP_LT_OQ);
+			vb = _mm256_xor_ps(vb, _mm256_and_ps(negative, lowSign));
+			const auto v = _mm256_add_ps(va, _mm256_mul_ps(_mm256_sub_ps(vb, va), w));
+			const auto length = _mm256_sqrt_ps(_mm256_dp_ps(v, v, 0xff));
+			_mm256_storeu_ps(&out[i].rotation.x, _mm256_div_ps(v, _mm256_blend_ps(length, one, 0xf0)));
+		}
+	}
+#endif
+
+private:
+	std::vector<Track> m_tracks;
+	std::vector<QuantizedQuaternion> m_rotations;
+	std::vector<Float3> m_translations;
+	std::vector<float> m_scales;
+	size_t m_frameCount;
+	float m_sampleRate;
+};
+
+// One character's animation for a frame: clip at time, optionally blended towards blendClip by blendWeight.
+// The skinning palette, one matrix per bone, is written to palette.
+struct AnimationJob
+{
+	const AnimationClip* clip = nullptr;
+	float time = 0.f;
+	const AnimationClip* blendClip = nullptr;
+	float blendTime = 0.f;
+	float blendWeight = 0.f;
+	Float4x4* palette = nullptr;
+};
+
+// Evaluates animation jobs for many characters sharing a skeleton, spread over a thread pool
+struct Animator
+{
+	explicit Animator(const Skeleton& skeleton, ThreadPool& pool = ThreadPool::GetDefault())
+		: m_skeleton(skeleton), m_pool(pool)
+	{
+	}
+
+	void Evaluate(const AnimationJob& job) const
+	{
+		const auto boneCount = m_skeleton.GetBoneCount();
+		assert(job.clip && job.clip->GetBoneCount() == boneCount);
+
+		thread_local std::vector<BoneTransform> pose;
+		thread_local std::vector<BoneTransform> blend;
+		thread_local std::vector<Float4x4> model;
+		pose.resize(boneCount);
+		model.resize(boneCount);
+
+		job.clip->Sample(job.time, pose.data());
+		if (job.blendClip && job.blendWeight > 0.f)
+		{
+			assert(job.blendClip->GetBoneCount() == boneCount);
+			blend.resize(boneCount);
+			job.blendClip->Sample(job.blendTime, blend.data());
+			AnimationClip::BlendPoses(pose.data(), blend.data(), job.blendWeight, pose.data(), boneCount);
+		}
+
+		m_skeleton.LocalToModel(pose.data(), model.data());
+		m_skeleton.ModelToPalette(model.data(), job.palette);
+	}
+
+	void Evaluate(const AnimationJob* jobs, const size_t count) const
+	{
+		m_pool.ParallelFor(count, 4, [this, jobs](const size_t begin, const size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+				Evaluate(jobs[i]);
+		});
+	}
+
+	const Skeleton& GetSkeleton() const { return m_skeleton; }
+
+private:
+	const Skeleton& m_skeleton;
+	ThreadPool& m_pool;
+};
@@ -29,10 +29,41 @@ struct Buffer
 
 		device.GetDevice()->CreateBuffer(&bufferDesc, &data, buffer.GetAddressOf());
 
-		const auto id = m_nextId;
-		m_buffers[id] = buffer;
-		m_nextId = GetNextId();
-		return id;
+		return Store(buffer);
+	}
+
+	// Rewritten by the CPU every frame through Map with D3D11_MAP_WRITE_DISCARD
+	static BufferId CreateDynamicVertexBuffer(const Device& device, const UINT byteWidth)
+	{
+		ComPtr<ID3D11Buffer> buffer;
+
+		D3D11_BUFFER_DESC bufferDesc{};
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.ByteWidth = byteWidth;
+		bufferDesc.BindFlags = D3D11_BIND_VERTEX_BUFFER;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+
+		device.GetDevice()->CreateBuffer(&bufferDesc, nullptr, buffer.GetAddressOf());
+
+		return Store(buffer);
+	}
+
+	// Read by shaders as a StructuredBuffer through a shader resource view, rewritten with D3D11_MAP_WRITE_DISCARD
+	static BufferId CreateDynamicStructuredBuffer(const Device& device, const UINT stride, const UINT count)
+	{
+		ComPtr<ID3D11Buffer> buffer;
+
+		D3D11_BUFFER_DESC bufferDesc{};
+		bufferDesc.Usage = D3D11_USAGE_DYNAMIC;
+		bufferDesc.ByteWidth = stride * count;
+		bufferDesc.BindFlags = D3D11_BIND_SHADER_RESOURCE;
+		bufferDesc.CPUAccessFlags = D3D11_CPU_ACCESS_WRITE;
+		bufferDesc.MiscFlags = D3D11_RESOURCE_MISC_BUFFER_STRUCTURED;
+		bufferDesc.StructureByteStride = stride;
+
+		device.GetDevice()->CreateBuffer(&bufferDesc, nullptr, buffer.GetAddressOf());
+
+		return Store(buffer);
 	}
 
 	static BufferId CreateIndexBuffer(const Device& device, const std::vector<UINT32>& indices, const UINT offset = 0)
@@ -49,10 +80,7 @@ struct Buffer
 
 		device.GetDevice()->CreateBuffer(&bufferDesc, &data, buffer.GetAddressOf());
 
-		const auto id = m_nextId;
-		m_buffers[id] = buffer;
-		m_nextId = GetNextId();
-		return id;
+		return Store(buffer);
 	}
 
 	static BufferId CreateConstantBuffer(const Device& device, const size_t byteWidth)
@@ -66,10 +94,7 @@ struct Buffer
 
 		device.GetDevice()->CreateBuffer(&cbbd, nullptr, buffer.GetAddressOf());
 
-		const auto id = m_nextId;
-		m_buffers[id] = buffer;
-		m_nextId = GetNextId();
-		return id;
+		return Store(buffer);
 	}
 
 	// TODO: Encapsulate all binds/unbinds to 1 function each
@@ -77,7 +102,7 @@ struct Buffer
 	template <typename T>
 	static void BindBuffer(const ComPtr<ID3D11DeviceContext>& context, const BufferId id)
 	{
-		if (m_buffers.find(id) != m_buffers.end())
+		if (Contains(id))
 		{
 			D3D11_BUFFER_DESC desc{};
 			m_buffers[id]->GetDesc(&desc);
@@ -101,7 +126,7 @@ struct Buffer
 
 	static void BindBuffer(const ComPtr<ID3D11DeviceContext>& context, const BufferId id)
 	{
-		if (m_buffers.find(id) != m_buffers.end())
+		if (Contains(id))
 		{
 			D3D11_BUFFER_DESC desc{};
 			m_buffers[id]->GetDesc(&desc);
@@ -133,20 +158,56 @@ struct Buffer
 		}
 	}
 
+	// For shaders that declare their slots. BindBuffer hands out slots in bind order, so binding past it
+	// drops the cached vertex binds and the next BindBuffer rebinds from slot 0.
+	static void BindVertexBuffer(const ComPtr<ID3D11DeviceContext>& context, const BufferId id, const UINT slot,
+	                             const UINT stride)
+	{
+		if (Contains(id))
+		{
+			const UINT offset = 0;
+			context->IASetVertexBuffers(slot, 1, m_buffers[id].GetAddressOf(), &stride, &offset);
+			m_vertexBinds.clear();
+		}
+	}
+
+	static void BindIndexBuffer(const ComPtr<ID3D11DeviceContext>& context, const BufferId id)
+	{
+		if (Contains(id) && m_indexBind != id)
+		{
+			m_indexBind = id;
+			context->IASetIndexBuffer(m_buffers[id].Get(), DXGI_FORMAT_R32_UINT, 0);
+		}
+	}
+
+	// Vertex shader slot, drops the cached constant binds like BindVertexBuffer
+	static void BindConstantBuffer(const ComPtr<ID3D11DeviceContext>& context, const BufferId id, const UINT slot)
+	{
+		if (Contains(id))
+		{
+			context->VSSetConstantBuffers(slot, 1, m_buffers[id].GetAddressOf());
+			m_constantBinds.clear();
+		}
+	}
+
+	// Vertex and constant slots follow bind order, so unbinding one drops that whole list from the cache
+	// and the next BindBuffer rebinds from slot 0
 	static void UnbindBuffer(const ComPtr<ID3D11DeviceContext>& context, const BufferId id)
 	{
-		if (m_buffers.find(id) == m_buffers.end())
+		if (Contains(id))
 		{
+			ID3D11Buffer* const none = nullptr;
 			D3D11_BUFFER_DESC desc{};
 			m_buffers[id]->GetDesc(&desc);
 			if (desc.BindFlags == D3D11_BIND_VERTEX_BUFFER)
 			{
-				const auto iter = std::find(m_constantBinds.begin(), m_constantBinds.end(), id);
+				const auto iter = std::find(m_vertexBinds.begin(), m_vertexBinds.end(), id);
 				if (iter != m_vertexBinds.end())
 				{
-					const auto slot = std::distance(m_constantBinds.begin(), iter);
-					// TODO: Figure out how to unbind vertex buffers efficiently
-					m_vertexBinds.erase(iter);
+					const auto slot = static_cast<UINT>(std::distance(m_vertexBinds.begin(), iter));
+					const UINT zero = 0;
+					context->IASetVertexBuffers(slot, 1, &none, &zero, &zero);
+					m_vertexBinds.clear();
 				}
 			}
 			else if (desc.BindFlags == D3D11_BIND_INDEX_BUFFER)
@@ -162,15 +223,12 @@ struct Buffer
 				const auto iter = std::find(m_constantBinds.begin(), m_constantBinds.end(), id);
 				if (iter != m_constantBinds.end())
 				{
-					const auto slot = std::distance(m_constantBinds.begin(), iter);
-					context->VSSetConstantBuffers(slot, 1, nullptr);
-					m_constantBinds.erase(iter);
+					const auto slot = static_cast<UINT>(std::distance(m_constantBinds.begin(), iter));
+					context->VSSetConstantBuffers(slot, 1, &none);
+					m_constantBinds.clear();
 				}
 			}
-			else
-			{
-				assert(false, "Invalid buffer.");
-			}
+			// Structured buffers are bound through their views by their owners and never cached
 		}
 	}
 
@@ -179,30 +237,45 @@ struct Buffer
 	{
 		UnbindBuffer(context, id);
 
-		if (m_buffers.find(id) != m_buffers.end())
+		if (Contains(id))
 		{
 			m_buffers[id].Reset();
-			m_buffers.erase(id);
 
-			if (m_buffers.find(m_nextId) != m_buffers.end() ||
+			if (Contains(m_nextId) ||
 				m_nextId > id)
 				m_nextId = id;
 			id = 0;
 		}
 	}
 
-	static auto GetBuffer(const BufferId id)
+	// Not owning, a ComPtr copy would AddRef/Release every frame and a reference into m_buffers dangles once
+	// a Create call grows it
+	static ID3D11Buffer* GetBuffer(const BufferId id)
 	{
-		if (m_buffers.find(id) == m_buffers.end())
-			return ComPtr<ID3D11Buffer>{};
-		return m_buffers[id];
+		return Contains(id) ? m_buffers[id].Get() : nullptr;
 	}
 
 private:
+	// Ids are small and reused, so buffers live in a vector indexed by id and lookups never allocate
+	static bool Contains(const BufferId id)
+	{
+		return id < m_buffers.size() && m_buffers[id];
+	}
+
+	static BufferId Store(const ComPtr<ID3D11Buffer>& buffer)
+	{
+		const auto id = m_nextId;
+		if (id >= m_buffers.size())
+			m_buffers.resize(id + 1);
+		m_buffers[id] = buffer;
+		m_nextId = GetNextId();
+		return id;
+	}
+
 	static BufferId GetNextId()
 	{
 		auto id = m_nextId + 1;
-		while (m_buffers.find(id) != m_buffers.end())
+		while (Contains(id))
 			++id;
 		return id;
 	}
@@ -220,7 +293,7 @@ private:
 	 * https://msdn.microsoft.com/en-us/library/windows/desktop/ff476899(v=vs.85).aspx#Remarks 
 	 */
 	static BufferId m_nextId;
-	static std::map<BufferId, ComPtr<ID3D11Buffer>> m_buffers;
+	static std::vector<ComPtr<ID3D11Buffer>> m_buffers;
 	static std::vector<BufferId> m_vertexBinds;
 	static std::vector<BufferId> m_constantBinds;
 	static BufferId m_indexBind;
@@ -228,7 +301,7 @@ private:
 
 // NEVER HAVE 0 AS A VALUE
 BufferId Buffer::m_nextId = 1;
-std::map<BufferId, ComPtr<ID3D11Buffer>> Buffer::m_buffers = {};
+std::vector<ComPtr<ID3D11Buffer>> Buffer::m_buffers = {};
 std::vector<BufferId> Buffer::m_vertexBinds = {};
 std::vector<BufferId> Buffer::m_constantBinds = {};
 BufferId Buffer::m_indexBind = 0;
@@ -0,0 +1,277 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cstdint>
+#include <vector>
+
+#include "Aabb.h"
+#include "Simd.h"
+
+// Four-wide BVH used for traversal. The child boxes of a node are stored as structure of arrays,
+// so one SSE slab test covers all four children.
+// DynamicBvh and MeshBvh build and maintain binary trees and collapse them into this layout.
+struct Bvh4
+{
+	struct alignas(16) Node
+	{
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		// Inner child: node index with count 0. Leaf child: first item with count > 0. Empty slot: -1
+		int32_t child[4];
+		uint32_t count[4];
+	};
+
+	// Collapses a binary tree, Tree provides IsLeaf, GetBounds, GetLeft, GetRight, GetFirst and GetCount
+	// Each node absorbs the grandchildren of its largest inner children until it has four slots
+	template <class Tree>
+	void Build(const Tree& tree, const int32_t root)
+	{
+		m_nodes.clear();
+		if (root < 0)
+			return;
+
+		if (tree.IsLeaf(root))
+		{
+			m_nodes.push_back(EmptyNode());
+			SetChild(m_nodes[0], 0, tree.GetBounds(root), tree.GetFirst(root), tree.GetCount(root));
+			return;
+		}
+		Collapse(tree, root);
+	}
+
+	// Visits leaves front to back, leaf(first, count, maxT) may lower maxT to prune farther nodes
+	template <class Leaf>
+	void Raycast(const Ray& ray, Leaf&& leaf) const
+	{
+		if (m_nodes.empty())
+			return;
+
+		float invDir[3];
+		ray.InverseDirection(invDir);
+
+		auto maxT = ray.maxT;
+		auto& stack = Stack();
+		const auto base = stack.size();
+		stack.push_back(StackEntry{0, 0, 0.f});
+
+		while (stack.size() > base)
+		{
+			const auto entry = stack.back();
+			stack.pop_back();
+			if (entry.t > maxT)
+				continue;
+			if (entry.count > 0)
+			{
+				leaf(static_cast<uint32_t>(entry.child), entry.count, maxT);
+				continue;
+			}
+
+			float entryT[4];
+			const auto hits = IntersectRay(m_nodes[entry.child], ray.origin, invDir, maxT, entryT);
+			if (hits == 0)
+				continue;
+
+			// Insertion sort of at most four children, farthest first so the nearest is popped next
+			const auto& node = m_nodes[entry.child];
+			const auto top = stack.size();
+			for (auto i = 0; i < 4; ++i)
+			{
+				if (!(hits & (1 << i)))
+					continue;
+				stack.push_back(StackEntry{node.child[i], node.count[i], entryT[i]});
+				for (auto j = stack.size() - 1; j > top && stack[j - 1].t < stack[j].t; --j)
+					std::swap(stack[j - 1], stack[j]);
+			}
+		}
+	}
+
+	// Visits every leaf whose box overlaps bounds, visit(first, count)
+	template <class Visit>
+	void Query(const Aabb& bounds, Visit&& visit) const
+	{
+		if (m_nodes.empty())
+			return;
+
+		auto& stack = Stack();
+		const auto base = stack.size();
+		stack.push_back(StackEntry{0, 0, 0.f});
+
+		while (stack.size() > base)
+		{
+			const auto entry = stack.back();
+			stack.pop_back();
+			if (entry.count > 0)
+			{
+				visit(static_cast<uint32_t>(entry.child), entry.count);
+				continue;
+			}
+
+			const auto& node = m_nodes[entry.child];
+			const auto hits = IntersectBox(node, bounds);
+			for (auto i = 0; i < 4; ++i)
+				if (hits & (1 << i))
+					stack.push_back(StackEntry{node.child[i], node.count[i], 0.f});
+		}
+	}
+
+	bool IsEmpty() const { return m_nodes.empty(); }
+	size_t GetNodeCount() const { return m_nodes.size(); }
+
+private:
+	struct StackEntry
+	{
+		int32_t child;
+		uint32_t count;
+		float t;
+	};
+
+	// Traversal scratch is per thread so queries can run concurrently, each query only works above
+	// the entries it found on the stack so callbacks may start nested queries
+	static std::vector<StackEntry>& Stack()
+	{
+		thread_local std::vector<StackEntry> stack;
+		return stack;
+	}
+
+	static Node EmptyNode()
+	{
+		Node node{};
+		for (auto i = 0; i < 4; ++i)
+		{
+			// Inverted boxes never pass the overlap test
+			node.minX[i] = node.minY[i] = node.minZ[i] = FLT_MAX;
+			node.maxX[i] = node.maxY[i] = node.maxZ[i] = -FLT_MAX;
+			node.child[i] = -1;
+			node.count[i] = 0;
+		}
+		return node;
+	}
+
+	static void SetChild(Node& node, const int slot, const Aabb& bounds, const int32_t child, const uint32_t count)
+	{
+		node.minX[slot] = bounds.min[0];
+		node.minY[slot] = bounds.min[1];
+		node.minZ[slot] = bounds.min[2];
+		node.maxX[slot] = bounds.max[0];
+		node.maxY[slot] = bounds.max[1];
+		node.maxZ[slot] = bounds.max[2];
+		node.child[slot] = child;
+		node.count[slot] = count;
+	}
+
+	template <class Tree>
+	int32_t Collapse(const Tree& tree, const int32_t binary)
+	{
+		int32_t slots[4] = {tree.GetLeft(binary), tree.GetRight(binary), -1, -1};
+		auto used = 2;
+		while (used < 4)
+		{
+			auto best = -1;
+			auto bestArea = -1.f;
+			for (auto i = 0; i < used; ++i)
+			{
+				if (tree.IsLeaf(slots[i]))
+					continue;
+				const auto area = tree.GetBounds(slots[i]).HalfArea();
+				if (area > bestArea)
+				{
+					bestArea = area;
+					best = i;
+				}
+			}
+			if (best < 0)
+				break;
+			const auto expanded = slots[best];
+			slots[best] = tree.GetLeft(expanded);
+			slots[used++] = tree.GetRight(expanded);
+		}
+
+		const auto index = static_cast<int32_t>(m_nodes.size());
+		m_nodes.push_back(EmptyNode());
+		for (auto i = 0; i < used; ++i)
+		{
+			const auto bounds = tree.GetBounds(slots[i]);
+			if (tree.IsLeaf(slots[i]))
+			{
+				SetChild(m_nodes[index], i, bounds, tree.GetFirst(slots[i]), tree.GetCount(slots[i]));
+				continue;
+			}
+			// Recursion grows m_nodes, so the node is only addressed by index
+			const auto child = Collapse(tree, slots[i]);
+			SetChild(m_nodes[index], i, bounds, child, 0);
+		}
+		return index;
+	}
+
+	// Returns a bit mask of the children hit before maxT and their entry distances
+	static int IntersectRay(const Node& node, const float* origin, const float* invDir, const float maxT, float* entryT)
+	{
+#if XT_SIMD_X86
+		const auto ox = _mm_set1_ps(origin[0]), oy = _mm_set1_ps(origin[1]), oz = _mm_set1_ps(origin[2]);
+		const auto ix = _mm_set1_ps(invDir[0]), iy = _mm_set1_ps(invDir[1]), iz = _mm_set1_ps(invDir[2]);
+
+		const auto tx0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minX), ox), ix);
+		const auto tx1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxX), ox), ix);
+		const auto ty0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minY), oy), iy);
+		const auto ty1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxY), oy), iy);
+		const auto tz0 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.minZ), oz), iz);
+		const auto tz1 = _mm_mul_ps(_mm_sub_ps(_mm_load_ps(node.maxZ), oz), iz);
+
+		auto tNear = _mm_max_ps(_mm_max_ps(_mm_min_ps(tx0, tx1), _mm_min_ps(ty0, ty1)), _mm_min_ps(tz0, tz1));
+		auto tFar = _mm_min_ps(_mm_min_ps(_mm_max_ps(tx0, tx1), _mm_max_ps(ty0, ty1)), _mm_max_ps(tz0, tz1));
+		tNear = _mm_max_ps(tNear, _mm_setzero_ps());
+		tFar = _mm_min_ps(tFar, _mm_set1_ps(maxT));
+
+		// Inverted boxes still pass a slab test, empty slots are rejected by the sign of their child index
+		const auto empty = _mm_movemask_ps(_mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(node.child))));
+		_mm_storeu_ps(entryT, tNear);
+		return _mm_movemask_ps(_mm_cmple_ps(tNear, tFar)) & ~empty;
+#else
+		auto mask = 0;
+		for (auto i = 0; i < 4; ++i)
+		{
+			const float lo[3] = {node.minX[i], node.minY[i], node.minZ[i]};
+			const float hi[3] = {node.maxX[i], node.maxY[i], node.maxZ[i]};
+			auto tNear = 0.f;
+			auto tFar = maxT;
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				const auto t0 = (lo[axis] - origin[axis]) * invDir[axis];
+				const auto t1 = (hi[axis] - origin[axis]) * invDir[axis];
+				tNear = std::max(tNear, std::min(t0, t1));
+				tFar = std::min(tFar, std::max(t0, t1));
+			}
+			entryT[i] = tNear;
+			mask |= node.child[i] >= 0 && tNear <= tFar ? 1 << i : 0;
+		}
+		return mask;
+#endif
+	}
+
+	static int IntersectBox(const Node& node, const Aabb& bounds)
+	{
+#if XT_SIMD_X86
+		auto inside = _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minX), _mm_set1_ps(bounds.max[0])),
+		                         _mm_cmpge_ps(_mm_load_ps(node.maxX), _mm_set1_ps(bounds.min[0])));
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minY), _mm_set1_ps(bounds.max[1])),
+		                                       _mm_cmpge_ps(_mm_load_ps(node.maxY), _mm_set1_ps(bounds.min[1]))));
+		inside = _mm_and_ps(inside, _mm_and_ps(_mm_cmple_ps(_mm_load_ps(node.minZ), _mm_set1_ps(bounds.max[2])),
+		                                       _mm_cmpge_ps(_mm_load_ps(node.maxZ), _mm_set1_ps(bounds.min[2]))));
+		// Inverted boxes still overlap an infinite query, empty slots are rejected like in IntersectRay
+		const auto empty = _mm_movemask_ps(_mm_castsi128_ps(_mm_load_si128(reinterpret_cast<const __m128i*>(node.child))));
+		return _mm_movemask_ps(inside) & ~empty;
+#else
+		auto mask = 0;
+		for (auto i = 0; i < 4; ++i)
+		{
+			const Aabb child{{node.minX[i], node.minY[i], node.minZ[i]}, {node.maxX[i], node.maxY[i], node.maxZ[i]}};
+			mask |= node.child[i] >= 0 && child.Overlaps(bounds) ? 1 << i : 0;
+		}
+		return mask;
+#endif
+	}
+
+private:
+	std::vector<Node> m_nodes;
+};
@@ -1,12 +1,12 @@
 #pragma once
 
-#include "stdafx.h"
+#include "VectorMath.h"
 
 struct Camera
 {
-	DirectX::XMVECTOR position;
-	DirectX::XMVECTOR target;
-	DirectX::XMVECTOR up;
+	Float3 position;
+	Float3 target;
+	Float3 up;
 
 	int width = 1280;
 	int height = 720;
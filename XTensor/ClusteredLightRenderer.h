@@ -0,0 +1,184 @@
+#pragma once
+
+#include <cstring>
+
+#include "stdafx.h"
+#include "Device.h"
+#include "Buffer.h"
+#include "Renderer.h"
+#include "ClusteredLighting.h"
+
+// Vertex of LitVertexShader.hlsl, see ClusteredLightRenderer::GetInputElements
+struct LitVertex
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT3 normal;
+	DirectX::XMFLOAT4 color;
+};
+
+static_assert(sizeof(LitVertex) == 40, "LitVertex must match ClusteredLightRenderer::GetInputElements.");
+
+// Uploads the result of ClusteredLighting::Assign for LitPixelShader.hlsl: the view space lights, the
+// offset and count of every cluster and the light index list, each in a dynamic structured buffer that
+// grows when a frame needs more room.
+// Draw lit meshes with LitVertexShader.hlsl, LitPixelShader.hlsl and an input layout made from
+// GetInputElements(), after Bind and with UpdateObject called for every mesh.
+struct ClusteredLightRenderer
+{
+	struct CBLitObject
+	{
+		Float4x4 wvp;
+		// Lighting happens in view space, where Assign left the lights
+		Float4x4 worldView;
+	};
+
+	struct CBClusters
+	{
+		uint32_t tilesX;
+		uint32_t tilesY;
+		uint32_t slices;
+		float sliceScale;
+		float tileWidth;
+		float tileHeight;
+		float sliceBias;
+		float padding;
+		Float4 ambient;
+	};
+
+	static_assert(sizeof(CBClusters) == 48, "CBClusters must match the CBClusters cbuffer in LitPixelShader.hlsl.");
+
+	explicit ClusteredLightRenderer(const Device& device)
+	{
+		m_objectBuffer = Buffer::CreateConstantBuffer(device, sizeof(CBLitObject));
+		m_clusterConstBuffer = Buffer::CreateConstantBuffer(device, sizeof(CBClusters));
+	}
+
+	static std::vector<D3D11_INPUT_ELEMENT_DESC> GetInputElements()
+	{
+		return {
+			{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"NORMAL", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 24, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+	}
+
+	void Destroy(const ComPtr<ID3D11DeviceContext>& context)
+	{
+		for (auto* buffer : {&m_lights, &m_clusters, &m_indices})
+		{
+			if (buffer->id)
+				Buffer::DeleteBuffer(context, buffer->id);
+			buffer->view.Reset();
+			buffer->capacity = 0;
+		}
+		Buffer::DeleteBuffer(context, m_objectBuffer);
+		Buffer::DeleteBuffer(context, m_clusterConstBuffer);
+	}
+
+	// Called once per frame after Assign. The tiles span the whole back buffer of the device.
+	void Upload(const Device& device, const ClusteredLighting& lighting)
+	{
+		const auto& lights = lighting.GetViewLights();
+		const auto& ranges = lighting.GetClusterRanges();
+		const auto& indices = lighting.GetLightIndices();
+		Reserve(device, m_lights, lights.size(), sizeof(Light));
+		Reserve(device, m_clusters, ranges.size(), sizeof(ClusterRange));
+		Reserve(device, m_indices, indices.size(), sizeof(uint32_t));
+
+		const auto& context = device.GetDeviceContext();
+		Write(context, m_lights, lights);
+		Write(context, m_clusters, ranges);
+		Write(context, m_indices, indices);
+
+		m_cbClusters.tilesX = lighting.GetTilesX();
+		m_cbClusters.tilesY = lighting.GetTilesY();
+		m_cbClusters.slices = lighting.GetSlices();
+		m_cbClusters.sliceScale = lighting.GetSliceScale();
+		m_cbClusters.sliceBias = lighting.GetSliceBias();
+		m_cbClusters.tileWidth = static_cast<float>(device.width) / static_cast<float>(lighting.GetTilesX());
+		m_cbClusters.tileHeight = static_cast<float>(device.height) / static_cast<float>(lighting.GetTilesY());
+		m_cbClusters.ambient = Float4{m_ambient.x, m_ambient.y, m_ambient.z, 0.f};
+		context->UpdateSubresource(Buffer::GetBuffer(m_clusterConstBuffer), 0, nullptr, &m_cbClusters, 0, 0);
+	}
+
+	// Transposed for HLSL like WVP, view must be the one the lights were assigned with
+	void UpdateObject(const Device& device, const Float4x4& world, const Float4x4& view, const Float4x4& projection)
+	{
+		const auto worldView = VectorMath::Multiply(world, view);
+		m_cbObject.wvp = VectorMath::Transpose(VectorMath::Multiply(worldView, projection));
+		m_cbObject.worldView = VectorMath::Transpose(worldView);
+		device.GetDeviceContext()->UpdateSubresource(Buffer::GetBuffer(m_objectBuffer), 0, nullptr, &m_cbObject, 0, 0);
+	}
+
+	// Binds its buffers to fixed slots like SkinnedMesh, the object constants to b0 of the vertex shader and
+	// the cluster constants and t0-t2 to the pixel shader
+	void Bind(const Renderer& renderer) const
+	{
+		const auto& context = renderer.GetDeviceContext();
+		Buffer::BindConstantBuffer(context, m_objectBuffer, 0);
+		ID3D11Buffer* const clusterConstants = Buffer::GetBuffer(m_clusterConstBuffer);
+		context->PSSetConstantBuffers(0, 1, &clusterConstants);
+		ID3D11ShaderResourceView* views[] = {m_lights.view.Get(), m_clusters.view.Get(), m_indices.view.Get()};
+		context->PSSetShaderResources(0, 3, views);
+	}
+
+	void SetAmbient(const Float3& ambient) { m_ambient = ambient; }
+	const Float3& GetAmbient() const { return m_ambient; }
+
+private:
+	struct ResourceBuffer
+	{
+		BufferId id = 0;
+		ComPtr<ID3D11ShaderResourceView> view;
+		size_t capacity = 0;
+	};
+
+	// Recreates the buffer at twice its size, or count if that is more, when count elements do not fit
+	static void Reserve(const Device& device, ResourceBuffer& buffer, const size_t count, const UINT stride)
+	{
+		if (count <= buffer.capacity)
+			return;
+
+		if (buffer.id)
+			Buffer::DeleteBuffer(device.GetDeviceContext(), buffer.id);
+		buffer.view.Reset();
+
+		const auto capacity = std::max(count, buffer.capacity * 2);
+		buffer.id = Buffer::CreateDynamicStructuredBuffer(device, stride, static_cast<UINT>(capacity));
+
+		D3D11_SHADER_RESOURCE_VIEW_DESC viewDesc{};
+		viewDesc.Format = DXGI_FORMAT_UNKNOWN;
+		viewDesc.ViewDimension = D3D11_SRV_DIMENSION_BUFFER;
+		viewDesc.Buffer.FirstElement = 0;
+		viewDesc.Buffer.NumElements = static_cast<UINT>(capacity);
+		device.GetDevice()->CreateShaderResourceView(Buffer::GetBuffer(buffer.id), &viewDesc,
+		                                             buffer.view.GetAddressOf());
+		buffer.capacity = capacity;
+	}
+
+	// A failed Map leaves the previous frame's data, empty vectors skip the upload entirely
+	template <typename T>
+	static void Write(const ComPtr<ID3D11DeviceContext>& context, const ResourceBuffer& buffer,
+	                  const std::vector<T>& data)
+	{
+		if (data.empty())
+			return;
+
+		const auto resource = Buffer::GetBuffer(buffer.id);
+		D3D11_MAPPED_SUBRESOURCE mapped{};
+		if (FAILED(context->Map(resource, 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+			return;
+		std::memcpy(mapped.pData, data.data(), data.size() * sizeof(T));
+		context->Unmap(resource, 0);
+	}
+
+	CBLitObject m_cbObject{};
+	CBClusters m_cbClusters{};
+	Float3 m_ambient{0.05f, 0.05f, 0.05f};
+
+	ResourceBuffer m_lights;
+	ResourceBuffer m_clusters;
+	ResourceBuffer m_indices;
+	BufferId m_objectBuffer;
+	BufferId m_clusterConstBuffer;
+};
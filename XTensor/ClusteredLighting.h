@@ -0,0 +1,484 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "VectorMath.h"
+
+enum class LightType : uint32_t
+{
+	Point = 0,
+	Spot = 1
+};
+
+// 64 bytes, the layout of the light buffer read by LitPixelShader.hlsl
+struct Light
+{
+	Float3 position;
+	float range;
+	Float3 color;
+	LightType type;
+	// Spot lights only, the cone narrows from cosOuter to full intensity at cosInner
+	Float3 direction;
+	float cosOuter;
+	float cosInner;
+	float padding[3];
+
+	static Light Point(const Float3& position, const float range, const Float3& color)
+	{
+		return Light{position, range, color, LightType::Point, Float3{0.f, 0.f, 0.f}, -1.f, -1.f, {}};
+	}
+
+	// Angles are half angles of the cone in radians, outerAngle below pi / 2
+	static Light Spot(const Float3& position, const Float3& direction, const float range, const float outerAngle,
+	                  const float innerAngle, const Float3& color)
+	{
+		return Light{
+			position, range, color, LightType::Spot, VectorMath::Normalize(direction), std::cos(outerAngle),
+			std::cos(std::min(innerAngle, outerAngle)), {}
+		};
+	}
+};
+
+static_assert(sizeof(Light) == 64, "Light must match the Light struct in LitPixelShader.hlsl.");
+
+// Offset into the light index list and number of lights of one cluster
+struct ClusterRange
+{
+	uint32_t offset;
+	uint32_t count;
+};
+
+// Clustered light assignment for forward shading.
+// The view frustum is split into tilesX x tilesY screen tiles and `slices` depth slices spaced
+// exponentially between nearZ and farZ. Every frame Assign() lists the lights touching each cluster:
+// a light's bounding sphere is tested against the view space boxes of the clusters in its slice and tile
+// range, and spot lights additionally test their cone against the clusters' bounding spheres.
+// Slices are processed in parallel, each testing one light against eight clusters of a row per instruction.
+// Cluster (x, y, slice) has index (slice * tilesY + y) * tilesX + x, tile row 0 is the top of the screen.
+// The projection must be a symmetric perspective like VectorMath::PerspectiveFovLH.
+struct ClusteredLighting
+{
+	ClusteredLighting(const Float4x4& projection, const float nearZ, const float farZ, const uint32_t tilesX = 16,
+	                  const uint32_t tilesY = 9, const uint32_t slices = 24, ThreadPool& pool = ThreadPool::GetDefault())
+		: m_tilesX(tilesX), m_tilesY(tilesY), m_slices(slices), m_rowStride((tilesX + 7) / 8 * 8),
+		  m_nearZ(nearZ), m_farZ(farZ), m_pool(pool)
+	{
+		assert(tilesX > 0 && tilesY > 0 && slices > 0 && nearZ > 0.f && farZ > nearZ);
+		m_sliceScale = static_cast<float>(slices) / std::log(farZ / nearZ);
+		m_sliceBias = -m_sliceScale * std::log(nearZ);
+		m_slicesWork.resize(slices);
+		m_ranges.resize(GetClusterCount());
+		SetProjection(projection);
+	}
+
+	// Rebuilds the cluster volumes, e.g. after a resize changed the aspect ratio
+	void SetProjection(const Float4x4& projection)
+	{
+		m_projectionX = projection.m[0][0];
+		m_projectionY = projection.m[1][1];
+
+		const auto padded = size_t{m_slices} * m_tilesY * m_rowStride;
+		for (auto* bounds : {&m_minX, &m_minY, &m_minZ, &m_maxX, &m_maxY, &m_maxZ})
+			bounds->assign(padded, 0.f);
+		for (auto* sphere : {&m_centerX, &m_centerY, &m_centerZ, &m_radius})
+			sphere->assign(padded, 0.f);
+
+		for (uint32_t slice = 0; slice < m_slices; ++slice)
+		{
+			const auto z0 = SliceDepth(slice);
+			const auto z1 = SliceDepth(slice + 1);
+			for (uint32_t y = 0; y < m_tilesY; ++y)
+			{
+				const auto top = 1.f - 2.f * static_cast<float>(y) / static_cast<float>(m_tilesY);
+				const auto bottom = 1.f - 2.f * static_cast<float>(y + 1) / static_cast<float>(m_tilesY);
+				for (uint32_t x = 0; x < m_rowStride; ++x)
+				{
+					const auto index = (size_t{slice} * m_tilesY + y) * m_rowStride + x;
+					if (x >= m_tilesX)
+					{
+						// Padding lanes get an inverted box, which no sphere touches
+						m_minX[index] = m_minY[index] = m_minZ[index] = INFINITY;
+						m_maxX[index] = m_maxY[index] = m_maxZ[index] = -INFINITY;
+						m_centerX[index] = m_centerY[index] = m_centerZ[index] = INFINITY;
+						continue;
+					}
+
+					const auto left = -1.f + 2.f * static_cast<float>(x) / static_cast<float>(m_tilesX);
+					const auto right = -1.f + 2.f * static_cast<float>(x + 1) / static_cast<float>(m_tilesX);
+					// The tile's side planes through the eye bound it, so its box spans the corners at both depths
+					m_minX[index] = std::min(left * z0, left * z1) / m_projectionX;
+					m_maxX[index] = std::max(right * z0, right * z1) / m_projectionX;
+					m_minY[index] = std::min(bottom * z0, bottom * z1) / m_projectionY;
+					m_maxY[index] = std::max(top * z0, top * z1) / m_projectionY;
+					m_minZ[index] = z0;
+					m_maxZ[index] = z1;
+
+					m_centerX[index] = 0.5f * (m_minX[index] + m_maxX[index]);
+					m_centerY[index] = 0.5f * (m_minY[index] + m_maxY[index]);
+					m_centerZ[index] = 0.5f * (z0 + z1);
+					const auto ex = m_maxX[index] - m_centerX[index];
+					const auto ey = m_maxY[index] - m_centerY[index];
+					const auto ez = m_maxZ[index] - m_centerZ[index];
+					m_radius[index] = std::sqrt(ex * ex + ey * ey + ez * ez);
+				}
+			}
+		}
+	}
+
+	// Assigns world space lights to the clusters of the camera given by its view matrix
+	void Assign(const Light* lights, const size_t count, const Float4x4& view)
+	{
+		PrepareLights(lights, count, view);
+
+		// Every slice lists the lights whose depth range reaches it, in light order
+		for (auto& work : m_slicesWork)
+			work.lights.clear();
+		for (size_t light = 0; light < count; ++light)
+		{
+			const auto& range = m_lightRanges[light];
+			for (auto slice = range.slice0; slice <= range.slice1; ++slice)
+				m_slicesWork[slice].lights.push_back(static_cast<uint32_t>(light));
+		}
+
+		const auto avx2 = Simd::HasAvx2();
+		m_pool.ParallelFor(m_slices, 1, [this, avx2](const size_t begin, const size_t end)
+		{
+			for (auto slice = begin; slice < end; ++slice)
+				AssignSlice(static_cast<uint32_t>(slice), avx2);
+		});
+
+		// Slices wrote offsets relative to their own lists, rebase them and concatenate the lists
+		size_t total = 0;
+		for (auto& work : m_slicesWork)
+		{
+			work.base = total;
+			total += work.indices.size();
+		}
+		m_lightIndices.resize(total);
+		const auto clustersPerSlice = size_t{m_tilesX} * m_tilesY;
+		m_pool.ParallelFor(m_slices, 1, [this, clustersPerSlice](const size_t begin, const size_t end)
+		{
+			for (auto slice = begin; slice < end; ++slice)
+			{
+				const auto& work = m_slicesWork[slice];
+				std::copy(work.indices.begin(), work.indices.end(), m_lightIndices.begin() + work.base);
+				for (size_t cluster = 0; cluster < clustersPerSlice; ++cluster)
+					m_ranges[slice * clustersPerSlice + cluster].offset += static_cast<uint32_t>(work.base);
+			}
+		});
+	}
+
+	// Slice of a view space depth, clamped to the grid. The lit pixel shader uses the same mapping.
+	uint32_t SliceOf(const float viewZ) const
+	{
+		const auto slice = std::log(std::max(viewZ, m_nearZ)) * m_sliceScale + m_sliceBias;
+		return std::min(static_cast<uint32_t>(std::max(slice, 0.f)), m_slices - 1);
+	}
+
+	float SliceDepth(const uint32_t slice) const
+	{
+		return m_nearZ * std::pow(m_farZ / m_nearZ, static_cast<float>(slice) / static_cast<float>(m_slices));
+	}
+
+	size_t GetClusterCount() const { return size_t{m_tilesX} * m_tilesY * m_slices; }
+	uint32_t GetTilesX() const { return m_tilesX; }
+	uint32_t GetTilesY() const { return m_tilesY; }
+	uint32_t GetSlices() const { return m_slices; }
+	float GetSliceScale() const { return m_sliceScale; }
+	float GetSliceBias() const { return m_sliceBias; }
+
+	// Results of the last Assign(), laid out for upload
+	const std::vector<ClusterRange>& GetClusterRanges() const { return m_ranges; }
+	const std::vector<uint32_t>& GetLightIndices() const { return m_lightIndices; }
+	// The lights in view space, the index lists refer to these
+	const std::vector<Light>& GetViewLights() const { return m_viewLights; }
+
+private:
+	struct LightRange
+	{
+		uint32_t slice0, slice1;
+		uint32_t tileX0, tileX1;
+		uint32_t tileY0, tileY1;
+	};
+
+	// Lights of one cluster row group that passed the tests, bit i of mask is cluster x = chunk * 8 + i
+	struct Hit
+	{
+		uint32_t light;
+		uint32_t row;
+		uint32_t chunk;
+		uint32_t mask;
+	};
+
+	struct SliceWork
+	{
+		std::vector<uint32_t> lights;
+		std::vector<Hit> hits;
+		std::vector<uint32_t> indices;
+		size_t base = 0;
+	};
+
+	// View space lights in SoA, plus the slice and tile range each one can reach.
+	// A light out of reach gets an empty range, slice0 > slice1.
+	void PrepareLights(const Light* lights, const size_t count, const Float4x4& view)
+	{
+		m_viewLights.resize(count);
+		m_lightRanges.resize(count);
+		for (auto* soa : {&m_lightX, &m_lightY, &m_lightZ, &m_lightRadius, &m_coneX, &m_coneY, &m_coneZ, &m_coneCos, &m_coneSin})
+			soa->resize(count);
+
+		m_pool.ParallelFor(count, 256, [this, lights, &view](const size_t begin, const size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+				PrepareLight(lights[i], i, view);
+		});
+	}
+
+	void PrepareLight(Light light, const size_t i, const Float4x4& view)
+	{
+		const auto position = VectorMath::Transform(Float4{light.position.x, light.position.y, light.position.z, 1.f}, view);
+		const auto direction = VectorMath::Transform(Float4{light.direction.x, light.direction.y, light.direction.z, 0.f}, view);
+		light.position = Float3{position.x, position.y, position.z};
+		light.direction = Float3{direction.x, direction.y, direction.z};
+		m_viewLights[i] = light;
+
+		m_lightX[i] = light.position.x;
+		m_lightY[i] = light.position.y;
+		m_lightZ[i] = light.position.z;
+		m_lightRadius[i] = light.range;
+		// Point lights skip the cone test, they are marked by a cone cosine of -1
+		const auto spot = light.type == LightType::Spot;
+		m_coneX[i] = spot ? light.direction.x : 0.f;
+		m_coneY[i] = spot ? light.direction.y : 0.f;
+		m_coneZ[i] = spot ? light.direction.z : 0.f;
+		m_coneCos[i] = spot ? light.cosOuter : -1.f;
+		m_coneSin[i] = spot ? std::sqrt(std::max(1.f - light.cosOuter * light.cosOuter, 0.f)) : 0.f;
+
+		m_lightRanges[i] = ComputeRange(light.position, light.range);
+	}
+
+	LightRange ComputeRange(const Float3& center, const float radius) const
+	{
+		const auto empty = LightRange{1, 0, 0, 0, 0, 0};
+		const auto zMin = center.z - radius;
+		const auto zMax = center.z + radius;
+		if (zMax < m_nearZ || zMin > m_farZ || !(radius > 0.f))
+			return empty;
+
+		// The sphere's box projects widest at its nearest or farthest depth in front of the near plane
+		const auto front = std::max(zMin, m_nearZ);
+		const auto back = std::max(zMax, m_nearZ);
+		const auto ndcMinX = std::min((center.x - radius) / front, (center.x - radius) / back) * m_projectionX;
+		const auto ndcMaxX = std::max((center.x + radius) / front, (center.x + radius) / back) * m_projectionX;
+		const auto ndcMinY = std::min((center.y - radius) / front, (center.y - radius) / back) * m_projectionY;
+		const auto ndcMaxY = std::max((center.y + radius) / front, (center.y + radius) / back) * m_projectionY;
+		if (ndcMaxX < -1.f || ndcMinX > 1.f || ndcMaxY < -1.f || ndcMinY > 1.f)
+			return empty;
+
+		const auto tile = [](const float ndc, const uint32_t tiles)
+		{
+			const auto position = (std::min(std::max(ndc, -1.f), 1.f) * 0.5f + 0.5f) * static_cast<float>(tiles);
+			return std::min(static_cast<uint32_t>(position), tiles - 1);
+		};
+
+		LightRange range;
+		range.slice0 = SliceOf(zMin);
+		range.slice1 = SliceOf(zMax);
+		range.tileX0 = tile(ndcMinX, m_tilesX);
+		range.tileX1 = tile(ndcMaxX, m_tilesX);
+		// Rows count down from the top, so the largest y gives the first row
+		range.tileY0 = m_tilesY - 1 - tile(ndcMaxY, m_tilesY);
+		range.tileY1 = m_tilesY - 1 - tile(ndcMinY, m_tilesY);
+		return range;
+	}
+
+	void AssignSlice(const uint32_t slice, const bool avx2)
+	{
+		auto& work = m_slicesWork[slice];
+		work.hits.clear();
+		CollectHits(slice, avx2);
+
+		// Count per cluster, prefix sum, then fill, which keeps every cluster's lights in light order
+		const auto clustersPerSlice = size_t{m_tilesX} * m_tilesY;
+		auto* ranges = m_ranges.data() + slice * clustersPerSlice;
+		for (size_t cluster = 0; cluster < clustersPerSlice; ++cluster)
+			ranges[cluster] = ClusterRange{0, 0};
+		for (const auto& hit : work.hits)
+			for (auto mask = hit.mask; mask; mask &= mask - 1)
+				++ranges[hit.row * m_tilesX + hit.chunk * 8 + Simd::LowestBit(mask)].count;
+
+		uint32_t offset = 0;
+		for (size_t cluster = 0; cluster < clustersPerSlice; ++cluster)
+		{
+			ranges[cluster].offset = offset;
+			offset += ranges[cluster].count;
+			ranges[cluster].count = 0;
+		}
+
+		work.indices.resize(offset);
+		for (const auto& hit : work.hits)
+		{
+			for (auto mask = hit.mask; mask; mask &= mask - 1)
+			{
+				auto& range = ranges[hit.row * m_tilesX + hit.chunk * 8 + Simd::LowestBit(mask)];
+				work.indices[range.offset + range.count++] = hit.light;
+			}
+		}
+	}
+
+	// Tests every light of the slice against the clusters of its tile range, eight clusters of a row at a time
+	void CollectHits(const uint32_t slice, const bool avx2)
+	{
+#if XT_SIMD_X86
+		if (avx2)
+			return CollectHitsAvx2(slice);
+#else
+		(void)avx2;
+#endif
+		auto& work = m_slicesWork[slice];
+		for (const auto light : work.lights)
+		{
+			const auto& range = m_lightRanges[light];
+			const auto spot = m_coneCos[light] > -1.f;
+			for (auto row = range.tileY0; row <= range.tileY1; ++row)
+			{
+				const auto rowBase = (size_t{slice} * m_tilesY + row) * m_rowStride;
+				for (auto chunk = range.tileX0 / 8; chunk <= range.tileX1 / 8; ++chunk)
+				{
+					const auto mask = Test(light, rowBase + chunk * 8, spot);
+					if (mask)
+						work.hits.push_back(Hit{light, row, chunk, mask});
+				}
+			}
+		}
+	}
+
+	// Bit i is set when the light touches cluster first + i: its sphere overlaps the cluster's box and,
+	// for spot lights, the cluster's bounding sphere is not outside the cone
+	uint32_t Test(const uint32_t light, const size_t first, const bool spot) const
+	{
+		const auto lx = m_lightX[light], ly = m_lightY[light], lz = m_lightZ[light], radius = m_lightRadius[light];
+		const auto cx = m_coneX[light], cy = m_coneY[light], cz = m_coneZ[light];
+		const auto coneCos = m_coneCos[light], coneSin = m_coneSin[light];
+
+		uint32_t mask = 0;
+		for (uint32_t lane = 0; lane < 8; ++lane)
+		{
+			const auto i = first + lane;
+			const auto dx = std::max(std::max(m_minX[i] - lx, lx - m_maxX[i]), 0.f);
+			const auto dy = std::max(std::max(m_minY[i] - ly, ly - m_maxY[i]), 0.f);
+			const auto dz = std::max(std::max(m_minZ[i] - lz, lz - m_maxZ[i]), 0.f);
+			const auto sphere = (dx * dx + dy * dy) + dz * dz <= radius * radius;
+			if (!spot)
+			{
+				mask |= sphere ? 1u << lane : 0u;
+				continue;
+			}
+
+			const auto vx = m_centerX[i] - lx, vy = m_centerY[i] - ly, vz = m_centerZ[i] - lz;
+			const auto lengthSq = (vx * vx + vy * vy) + vz * vz;
+			const auto along = (vx * cx + vy * cy) + vz * cz;
+			const auto across = std::sqrt(std::max(lengthSq - along * along, 0.f));
+			const auto closest = coneCos * across - along * coneSin;
+			const auto cone = closest <= m_radius[i] && along <= m_radius[i] + radius && along >= -m_radius[i];
+
+			mask |= sphere && cone ? 1u << lane : 0u;
+		}
+		return mask;
+	}
+
+#if XT_SIMD_X86
+	// Same operations as Test() without fused multiply-adds, so both paths agree on every cluster
+	XT_TARGET_AVX2_NOFMA void CollectHitsAvx2(const uint32_t slice)
+	{
+		const auto zero = _mm256_setzero_ps();
+		auto& work = m_slicesWork[slice];
+		for (const auto light : work.lights)
+		{
+			const auto lx = _mm256_set1_ps(m_lightX[light]);
+			const auto ly = _mm256_set1_ps(m_lightY[light]);
+			const auto lz = _mm256_set1_ps(m_lightZ[light]);
+			const auto radius = _mm256_set1_ps(m_lightRadius[light]);
+			const auto radiusSq = _mm256_mul_ps(radius, radius);
+			const auto cx = _mm256_set1_ps(m_coneX[light]);
+			const auto cy = _mm256_set1_ps(m_coneY[light]);
+			const auto cz = _mm256_set1_ps(m_coneZ[light]);
+			const auto coneCos = _mm256_set1_ps(m_coneCos[light]);
+			const auto coneSin = _mm256_set1_ps(m_coneSin[light]);
+			const auto spot = m_coneCos[light] > -1.f;
+
+			const auto& range = m_lightRanges[light];
+			for (auto row = range.tileY0; row <= range.tileY1; ++row)
+			{
+				const auto rowBase = (size_t{slice} * m_tilesY + row) * m_rowStride;
+				for (auto chunk = range.tileX0 / 8; chunk <= range.tileX1 / 8; ++chunk)
+				{
+					const auto first = rowBase + chunk * 8;
+					const auto dx = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(m_minX.data() + first), lx),
+					                                            _mm256_sub_ps(lx, _mm256_loadu_ps(m_maxX.data() + first))), zero);
+					const auto dy = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(m_minY.data() + first), ly),
+					                                            _mm256_sub_ps(ly, _mm256_loadu_ps(m_maxY.data() + first))), zero);
+					const auto dz = _mm256_max_ps(_mm256_max_ps(_mm256_sub_ps(_mm256_loadu_ps(m_minZ.data() + first), lz),
+					                                            _mm256_sub_ps(lz, _mm256_loadu_ps(m_maxZ.data() + first))), zero);
+					const auto distanceSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(dx, dx), _mm256_mul_ps(dy, dy)),
+					                                      _mm256_mul_ps(dz, dz));
+					auto mask = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_cmp_ps(distanceSq, radiusSq, _CMP_LE_OQ)));
+
+					if (spot && mask)
+					{
+						const auto vx = _mm256_sub_ps(_mm256_loadu_ps(m_centerX.data() + first), lx);
+						const auto vy = _mm256_sub_ps(_mm256_loadu_ps(m_centerY.data() + first), ly);
+						const auto vz = _mm256_sub_ps(_mm256_loadu_ps(m_centerZ.data() + first), lz);
+						const auto lengthSq = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, vx), _mm256_mul_ps(vy, vy)),
+						                                    _mm256_mul_ps(vz, vz));
+						const auto along = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, cx), _mm256_mul_ps(vy, cy)),
+						                                 _mm256_mul_ps(vz, cz));
+						const auto across = _mm256_sqrt_ps(_mm256_max_ps(_mm256_sub_ps(lengthSq, _mm256_mul_ps(along, along)), zero));
+						const auto closest = _mm256_sub_ps(_mm256_mul_ps(coneCos, across), _mm256_mul_ps(along, coneSin));
+						const auto clusterRadius = _mm256_loadu_ps(m_radius.data() + first);
+						auto cone = _mm256_cmp_ps(closest, clusterRadius, _CMP_LE_OQ);
+						cone = _mm256_and_ps(cone, _mm256_cmp_ps(along, _mm256_add_ps(clusterRadius, radius), _CMP_LE_OQ));
+						cone = _mm256_and_ps(cone, _mm256_cmp_ps(along, _mm256_sub_ps(zero, clusterRadius), _CMP_GE_OQ));
+						mask &= static_cast<uint32_t>(_mm256_movemask_ps(cone));
+					}
+
+					if (mask)
+						work.hits.push_back(Hit{light, row, chunk, mask});
+				}
+			}
+		}
+	}
+#endif
+
+private:
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+	uint32_t m_slices;
+	uint32_t m_rowStride;
+	float m_nearZ;
+	float m_farZ;
+	float m_sliceScale;
+	float m_sliceBias;
+	float m_projectionX = 1.f;
+	float m_projectionY = 1.f;
+
+	// Cluster boxes and bounding spheres in view space, rows padded to a multiple of eight
+	std::vector<float> m_minX, m_minY, m_minZ, m_maxX, m_maxY, m_maxZ;
+	std::vector<float> m_centerX, m_centerY, m_centerZ, m_radius;
+
+	std::vector<float> m_lightX, m_lightY, m_lightZ, m_lightRadius;
+	std::vector<float> m_coneX, m_coneY, m_coneZ, m_coneCos, m_coneSin;
+	std::vector<LightRange> m_lightRanges;
+	std::vector<Light> m_viewLights;
+
+	std::vector<SliceWork> m_slicesWork;
+	std::vector<ClusterRange> m_ranges;
+	std::vector<uint32_t> m_lightIndices;
+	ThreadPool& m_pool;
+};
@@ -0,0 +1,203 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Simd.h"
+
+// RGBA8 to 4:2:0 YUV with BT.601 limited range coefficients
+// Chroma is the rounded average of each 2x2 block (centred siting), odd edges repeat the last pixel.
+// The AVX2 and scalar paths produce identical bytes.
+struct ColorConvert
+{
+	ColorConvert() = delete;
+
+	struct Planes
+	{
+		uint8_t* y;
+		size_t yPitch;
+		// I420 uses u and v, NV12 writes interleaved UV into u and ignores v
+		uint8_t* u;
+		size_t uPitch;
+		uint8_t* v;
+		size_t vPitch;
+	};
+
+	static void RgbaToI420(const uint8_t* rgba, const size_t pitch, const uint32_t width, const uint32_t height,
+	                       const Planes& planes)
+	{
+		Convert(rgba, pitch, width, height, planes, false);
+	}
+
+	static void RgbaToNv12(const uint8_t* rgba, const size_t pitch, const uint32_t width, const uint32_t height,
+	                       const Planes& planes)
+	{
+		Convert(rgba, pitch, width, height, planes, true);
+	}
+
+	// Plane sizes for tightly packed I420/NV12 images
+	static size_t LumaSize(const uint32_t width, const uint32_t height) { return size_t{width} * height; }
+
+	static size_t ChromaSize(const uint32_t width, const uint32_t height)
+	{
+		return size_t{(width + 1) / 2} * ((height + 1) / 2);
+	}
+
+	static uint8_t Luma(const int r, const int g, const int b)
+	{
+		return static_cast<uint8_t>(((66 * r + 129 * g + 25 * b + 128) >> 8) + 16);
+	}
+
+	// The +32896 (128.5 * 256) bias keeps the sum positive so the shift is a plain floor
+	static uint8_t ChromaU(const int r, const int g, const int b)
+	{
+		return static_cast<uint8_t>((-38 * r - 74 * g + 112 * b + 32896) >> 8);
+	}
+
+	static uint8_t ChromaV(const int r, const int g, const int b)
+	{
+		return static_cast<uint8_t>((112 * r - 94 * g - 18 * b + 32896) >> 8);
+	}
+
+private:
+	static void Convert(const uint8_t* rgba, const size_t pitch, const uint32_t width, const uint32_t height,
+	                    const Planes& planes, const bool interleaved)
+	{
+		const auto avx2 = Simd::HasAvx2();
+		for (uint32_t row = 0; row < height; row += 2)
+		{
+			const auto row0 = rgba + row * pitch;
+			const auto row1 = row + 1 < height ? row0 + pitch : row0;
+			const auto y0 = planes.y + row * planes.yPitch;
+			const auto y1 = row + 1 < height ? y0 + planes.yPitch : nullptr;
+			const auto u = planes.u + (row / 2) * planes.uPitch;
+			const auto v = interleaved ? nullptr : planes.v + (row / 2) * planes.vPitch;
+
+			uint32_t x = 0;
+#if XT_SIMD_X86
+			if (avx2)
+				x = RowPairAvx2(row0, row1, width, y0, y1, u, v);
+#endif
+			RowPairScalar(row0, row1, x, width, y0, y1, u, v);
+		}
+	}
+
+	// Finishes a pair of rows from column x, used for the whole row or the SIMD remainder
+	static void RowPairScalar(const uint8_t* row0, const uint8_t* row1, const uint32_t start, const uint32_t width,
+	                          uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+	{
+		for (auto x = start; x < width; ++x)
+		{
+			const auto p0 = row0 + x * 4;
+			y0[x] = Luma(p0[0], p0[1], p0[2]);
+			if (y1)
+			{
+				const auto p1 = row1 + x * 4;
+				y1[x] = Luma(p1[0], p1[1], p1[2]);
+			}
+		}
+
+		for (auto x = start; x < width; x += 2)
+		{
+			const auto x1 = x + 1 < width ? x + 1 : x;
+			const uint8_t* p[4] = {row0 + x * 4, row0 + x1 * 4, row1 + x * 4, row1 + x1 * 4};
+			const auto r = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+			const auto g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+			const auto b = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+			if (v)
+			{
+				u[x / 2] = ChromaU(r, g, b);
+				v[x / 2] = ChromaV(r, g, b);
+			}
+			else
+			{
+				u[x] = ChromaU(r, g, b);
+				u[x + 1] = ChromaV(r, g, b);
+			}
+		}
+	}
+
+#if XT_SIMD_X86
+	// Splits 16 RGBA pixels into three vectors of 16-bit R, G, B in pixel order
+	static XT_TARGET_AVX2 void Deinterleave16(const uint8_t* src, __m256i& r, __m256i& g, __m256i& b)
+	{
+		const auto mask = _mm256_set1_epi32(0xFF);
+		const auto lo = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+		const auto hi = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src + 32));
+		// packus interleaves the 128-bit lanes, the permute puts pixels back in order
+		r = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_and_si256(lo, mask), _mm256_and_si256(hi, mask)), 0xD8);
+		g = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_and_si256(_mm256_srli_epi32(lo, 8), mask),
+		                                                 _mm256_and_si256(_mm256_srli_epi32(hi, 8), mask)), 0xD8);
+		b = _mm256_permute4x64_epi64(_mm256_packus_epi32(_mm256_and_si256(_mm256_srli_epi32(lo, 16), mask),
+		                                                 _mm256_and_si256(_mm256_srli_epi32(hi, 16), mask)), 0xD8);
+	}
+
+	// 16-bit lanes wrap, but every intermediate sum stays below 65536 so the logical shift is exact
+	static XT_TARGET_AVX2 void StoreLuma16(const __m256i r, const __m256i g, const __m256i b, uint8_t* dst)
+	{
+		auto sum = _mm256_add_epi16(_mm256_mullo_epi16(r, _mm256_set1_epi16(66)),
+		                            _mm256_mullo_epi16(g, _mm256_set1_epi16(129)));
+		sum = _mm256_add_epi16(sum, _mm256_mullo_epi16(b, _mm256_set1_epi16(25)));
+		sum = _mm256_add_epi16(sum, _mm256_set1_epi16(128));
+		const auto y = _mm256_add_epi16(_mm256_srli_epi16(sum, 8), _mm256_set1_epi16(16));
+		const auto packed = _mm256_permute4x64_epi64(_mm256_packus_epi16(y, y), 0xD8);
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm256_castsi256_si128(packed));
+	}
+
+	// Sums horizontal pixel pairs of two rows and rounds, giving 8 block averages as 32-bit lanes
+	static XT_TARGET_AVX2 __m256i Average2x2(const __m256i top, const __m256i bottom)
+	{
+		const auto pairs = _mm256_madd_epi16(_mm256_add_epi16(top, bottom), _mm256_set1_epi16(1));
+		return _mm256_srli_epi32(_mm256_add_epi32(pairs, _mm256_set1_epi32(2)), 2);
+	}
+
+	static XT_TARGET_AVX2 __m256i Chroma8(const __m256i r, const __m256i g, const __m256i b,
+	                                      const int cr, const int cg, const int cb)
+	{
+		auto sum = _mm256_mullo_epi32(r, _mm256_set1_epi32(cr));
+		sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(g, _mm256_set1_epi32(cg)));
+		sum = _mm256_add_epi32(sum, _mm256_mullo_epi32(b, _mm256_set1_epi32(cb)));
+		return _mm256_srli_epi32(_mm256_add_epi32(sum, _mm256_set1_epi32(32896)), 8);
+	}
+
+	// 8 32-bit lanes holding bytes to 8 consecutive bytes
+	static XT_TARGET_AVX2 __m128i Narrow8(const __m256i x)
+	{
+		const auto words = _mm_packus_epi32(_mm256_castsi256_si128(x), _mm256_extracti128_si256(x, 1));
+		return _mm_packus_epi16(words, words);
+	}
+
+	// Converts the longest prefix of 16-pixel blocks, returns the first unprocessed column
+	static XT_TARGET_AVX2 uint32_t RowPairAvx2(const uint8_t* row0, const uint8_t* row1, const uint32_t width,
+	                                          uint8_t* y0, uint8_t* y1, uint8_t* u, uint8_t* v)
+	{
+		uint32_t x = 0;
+		for (; x + 16 <= width; x += 16)
+		{
+			__m256i r0, g0, b0, r1, g1, b1;
+			Deinterleave16(row0 + x * 4, r0, g0, b0);
+			Deinterleave16(row1 + x * 4, r1, g1, b1);
+
+			StoreLuma16(r0, g0, b0, y0 + x);
+			if (y1)
+				StoreLuma16(r1, g1, b1, y1 + x);
+
+			const auto r = Average2x2(r0, r1);
+			const auto g = Average2x2(g0, g1);
+			const auto b = Average2x2(b0, b1);
+			const auto cu = Narrow8(Chroma8(r, g, b, -38, -74, 112));
+			const auto cv = Narrow8(Chroma8(r, g, b, 112, -94, -18));
+			if (v)
+			{
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(u + x / 2), cu);
+				_mm_storel_epi64(reinterpret_cast<__m128i*>(v + x / 2), cv);
+			}
+			else
+			{
+				_mm_storeu_si128(reinterpret_cast<__m128i*>(u + x), _mm_unpacklo_epi8(cu, cv));
+			}
+		}
+		return x;
+	}
+#endif
+};
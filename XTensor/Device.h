@@ -49,9 +49,10 @@ struct Device
 		m_swapChain.Reset();
 	}
 
-	auto GetDevice() const { return m_device; }
-	auto GetDeviceContext() const { return m_deviceContext; }
-	auto GetSwapChain() const { return m_swapChain; }
+	// By reference so per-frame calls do not AddRef/Release
+	const auto& GetDevice() const { return m_device; }
+	const auto& GetDeviceContext() const { return m_deviceContext; }
+	const auto& GetSwapChain() const { return m_swapChain; }
 
 	int width;
 	int height;
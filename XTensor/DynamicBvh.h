@@ -0,0 +1,392 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+#include "Aabb.h"
+#include "Bvh4.h"
+
+// Binary AABB tree over moving objects with incremental insert, remove and refit.
+// Leaves hold a fat box so small motions do not touch the tree, inserts pick the sibling by SAH cost
+// and every refit walks to the root applying the tree rotation that most reduces the SAH cost.
+// Flatten() snapshots the tree into a Bvh4 for SIMD queries, queries fall back to the binary tree while it is stale.
+struct DynamicBvh
+{
+	using ProxyId = int32_t;
+	enum : ProxyId { NullProxy = -1 };
+
+	explicit DynamicBvh(const float margin = 0.1f)
+		: m_margin(margin)
+	{
+	}
+
+	ProxyId Insert(const Aabb& bounds, void* userData)
+	{
+		const auto id = AllocateNode();
+		auto& node = m_nodes[id];
+		node.bounds = bounds.Expanded(m_margin);
+		node.userData = userData;
+		node.height = 0;
+		InsertLeaf(id);
+		++m_proxyCount;
+		return id;
+	}
+
+	void Remove(const ProxyId id)
+	{
+		RemoveLeaf(id);
+		FreeNode(id);
+		--m_proxyCount;
+	}
+
+	// Reinserts the proxy only when bounds leaves its fat box, returns true if the tree changed
+	bool Move(const ProxyId id, const Aabb& bounds)
+	{
+		if (m_nodes[id].bounds.Contains(bounds))
+			return false;
+
+		RemoveLeaf(id);
+		m_nodes[id].bounds = bounds.Expanded(m_margin);
+		InsertLeaf(id);
+		return true;
+	}
+
+	// Keeps the proxy in place and refits its ancestors, cheaper than Move for coherent motion
+	void Refit(const ProxyId id, const Aabb& bounds)
+	{
+		m_nodes[id].bounds = bounds.Expanded(m_margin);
+		RefitAncestors(m_nodes[id].parent);
+		m_dirty = true;
+	}
+
+	// Rebuilds the four-wide snapshot used by Raycast and Query, call once after the frame's updates
+	void Flatten()
+	{
+		m_flat.Build(TreeView{m_nodes}, m_root);
+		m_dirty = false;
+	}
+
+	// hit(id, maxT) returns the distance of its own hit test, or a negative value on a miss
+	template <class Hit>
+	void Raycast(const Ray& ray, Hit&& hit) const
+	{
+		if (!m_dirty)
+		{
+			m_flat.Raycast(ray, [&](const uint32_t first, uint32_t, float& maxT)
+			{
+				const auto t = hit(static_cast<ProxyId>(first), maxT);
+				if (t >= 0.f && t < maxT)
+					maxT = t;
+			});
+			return;
+		}
+
+		auto maxT = ray.maxT;
+		float inverse[3];
+		ray.InverseDirection(inverse);
+		ForEachOverlap([&](const Aabb& bounds) { return bounds.IntersectRay(ray.origin, inverse, maxT); },
+		               [&](const ProxyId id)
+		               {
+			               const auto t = hit(id, maxT);
+			               if (t >= 0.f && t < maxT)
+				               maxT = t;
+		               });
+	}
+
+	// visit(id) for every proxy whose fat box overlaps bounds
+	template <class Visit>
+	void Query(const Aabb& bounds, Visit&& visit) const
+	{
+		if (!m_dirty)
+		{
+			m_flat.Query(bounds, [&](const uint32_t first, uint32_t) { visit(static_cast<ProxyId>(first)); });
+			return;
+		}
+
+		ForEachOverlap([&](const Aabb& node) { return node.Overlaps(bounds); }, visit);
+	}
+
+	void* GetUserData(const ProxyId id) const { return m_nodes[id].userData; }
+	const Aabb& GetFatBounds(const ProxyId id) const { return m_nodes[id].bounds; }
+	size_t GetProxyCount() const { return m_proxyCount; }
+	int GetHeight() const { return m_root == NullProxy ? 0 : m_nodes[m_root].height; }
+
+	// Sum of inner node areas relative to the root, the SAH traversal cost up to a constant
+	float GetAreaRatio() const
+	{
+		if (m_root == NullProxy)
+			return 0.f;
+
+		auto total = 0.f;
+		for (const auto& node : m_nodes)
+			if (node.height > 0)
+				total += node.bounds.HalfArea();
+		return total / m_nodes[m_root].bounds.HalfArea();
+	}
+
+private:
+	struct Node
+	{
+		Aabb bounds;
+		void* userData;
+		// Parent while in the tree, next free node while on the free list
+		ProxyId parent;
+		ProxyId left;
+		ProxyId right;
+		// Leaves are 0, free nodes -1
+		int32_t height;
+
+		bool IsLeaf() const { return left == NullProxy; }
+	};
+
+	// Exposes the binary tree to Bvh4::Build, every leaf holds a single proxy
+	struct TreeView
+	{
+		const std::vector<Node>& nodes;
+
+		bool IsLeaf(const int32_t i) const { return nodes[i].IsLeaf(); }
+		const Aabb& GetBounds(const int32_t i) const { return nodes[i].bounds; }
+		int32_t GetLeft(const int32_t i) const { return nodes[i].left; }
+		int32_t GetRight(const int32_t i) const { return nodes[i].right; }
+		int32_t GetFirst(const int32_t i) const { return i; }
+		uint32_t GetCount(int32_t) const { return 1; }
+	};
+
+	ProxyId AllocateNode()
+	{
+		if (m_free == NullProxy)
+		{
+			m_nodes.push_back(Node{Aabb::Empty(), nullptr, NullProxy, NullProxy, NullProxy, -1});
+			return static_cast<ProxyId>(m_nodes.size() - 1);
+		}
+
+		const auto id = m_free;
+		m_free = m_nodes[id].parent;
+		m_nodes[id] = Node{Aabb::Empty(), nullptr, NullProxy, NullProxy, NullProxy, -1};
+		return id;
+	}
+
+	void FreeNode(const ProxyId id)
+	{
+		m_nodes[id].parent = m_free;
+		m_nodes[id].height = -1;
+		m_free = id;
+	}
+
+	void InsertLeaf(const ProxyId leaf)
+	{
+		m_dirty = true;
+		if (m_root == NullProxy)
+		{
+			m_root = leaf;
+			m_nodes[leaf].parent = NullProxy;
+			return;
+		}
+
+		const auto sibling = FindBestSibling(m_nodes[leaf].bounds);
+		const auto oldParent = m_nodes[sibling].parent;
+		const auto newParent = AllocateNode();
+		auto& parent = m_nodes[newParent];
+		parent.parent = oldParent;
+		parent.left = sibling;
+		parent.right = leaf;
+		parent.bounds = Aabb::Union(m_nodes[sibling].bounds, m_nodes[leaf].bounds);
+		parent.height = m_nodes[sibling].height + 1;
+		m_nodes[sibling].parent = newParent;
+		m_nodes[leaf].parent = newParent;
+
+		if (oldParent == NullProxy)
+			m_root = newParent;
+		else if (m_nodes[oldParent].left == sibling)
+			m_nodes[oldParent].left = newParent;
+		else
+			m_nodes[oldParent].right = newParent;
+
+		RefitAncestors(oldParent);
+	}
+
+	void RemoveLeaf(const ProxyId leaf)
+	{
+		m_dirty = true;
+		if (leaf == m_root)
+		{
+			m_root = NullProxy;
+			return;
+		}
+
+		// The parent is dropped and the sibling takes its place
+		const auto parent = m_nodes[leaf].parent;
+		const auto grandParent = m_nodes[parent].parent;
+		const auto sibling = m_nodes[parent].left == leaf ? m_nodes[parent].right : m_nodes[parent].left;
+		m_nodes[sibling].parent = grandParent;
+		FreeNode(parent);
+
+		if (grandParent == NullProxy)
+		{
+			m_root = sibling;
+			return;
+		}
+		if (m_nodes[grandParent].left == parent)
+			m_nodes[grandParent].left = sibling;
+		else
+			m_nodes[grandParent].right = sibling;
+		RefitAncestors(grandParent);
+	}
+
+	// Branch and bound over the tree: the cost of pairing with a node is the area of the new parent
+	// plus the growth of every ancestor, a subtree is skipped once its lower bound cannot win
+	ProxyId FindBestSibling(const Aabb& bounds) const
+	{
+		const auto leafArea = bounds.HalfArea();
+		auto best = m_root;
+		auto bestCost = Aabb::Union(m_nodes[m_root].bounds, bounds).HalfArea();
+
+		struct Candidate
+		{
+			ProxyId id;
+			float inherited;
+		};
+		auto& stack = Stack<Candidate>();
+		const auto base = stack.size();
+		stack.push_back(Candidate{m_root, 0.f});
+
+		while (stack.size() > base)
+		{
+			const auto candidate = stack.back();
+			stack.pop_back();
+			const auto& node = m_nodes[candidate.id];
+			const auto combined = Aabb::Union(node.bounds, bounds).HalfArea();
+			const auto cost = combined + candidate.inherited;
+			if (cost < bestCost)
+			{
+				bestCost = cost;
+				best = candidate.id;
+			}
+
+			if (node.IsLeaf())
+				continue;
+			const auto inherited = candidate.inherited + combined - node.bounds.HalfArea();
+			if (leafArea + inherited < bestCost)
+			{
+				stack.push_back(Candidate{node.left, inherited});
+				stack.push_back(Candidate{node.right, inherited});
+			}
+		}
+		return best;
+	}
+
+	// Per thread scratch, a traversal only pops entries it pushed so visitors may query again
+	template <class Entry>
+	static std::vector<Entry>& Stack()
+	{
+		thread_local std::vector<Entry> stack;
+		return stack;
+	}
+
+	void RefitAncestors(ProxyId index)
+	{
+		while (index != NullProxy)
+		{
+			Rotate(index);
+			auto& node = m_nodes[index];
+			node.bounds = Aabb::Union(m_nodes[node.left].bounds, m_nodes[node.right].bounds);
+			node.height = 1 + std::max(m_nodes[node.left].height, m_nodes[node.right].height);
+			index = node.parent;
+		}
+	}
+
+	// Tries swapping each child of A with a grandchild under the other child and applies the swap
+	// that shrinks the reshaped inner node the most. Only that node's area changes, so the gain is exact.
+	void Rotate(const ProxyId a)
+	{
+		const auto b = m_nodes[a].left;
+		const auto c = m_nodes[a].right;
+		if (m_nodes[b].IsLeaf() && m_nodes[c].IsLeaf())
+			return;
+
+		// child swapped up, grandchild swapped down, the inner node between them
+		ProxyId bestUp = NullProxy, bestDown = NullProxy, bestInner = NullProxy;
+		auto bestGain = 0.f;
+		const auto consider = [&](const ProxyId up, const ProxyId inner)
+		{
+			if (m_nodes[inner].IsLeaf())
+				return;
+			const auto area = m_nodes[inner].bounds.HalfArea();
+			const auto left = m_nodes[inner].left;
+			const auto right = m_nodes[inner].right;
+			// Swapping `up` with `left` leaves inner = up + right, and the other way round
+			const auto gainLeft = area - Aabb::Union(m_nodes[up].bounds, m_nodes[right].bounds).HalfArea();
+			const auto gainRight = area - Aabb::Union(m_nodes[up].bounds, m_nodes[left].bounds).HalfArea();
+			if (gainLeft > bestGain)
+			{
+				bestGain = gainLeft;
+				bestUp = up;
+				bestDown = left;
+				bestInner = inner;
+			}
+			if (gainRight > bestGain)
+			{
+				bestGain = gainRight;
+				bestUp = up;
+				bestDown = right;
+				bestInner = inner;
+			}
+		};
+		consider(b, c);
+		consider(c, b);
+		if (bestInner == NullProxy)
+			return;
+
+		auto& parent = m_nodes[a];
+		if (parent.left == bestUp)
+			parent.left = bestDown;
+		else
+			parent.right = bestDown;
+		auto& inner = m_nodes[bestInner];
+		if (inner.left == bestDown)
+			inner.left = bestUp;
+		else
+			inner.right = bestUp;
+		m_nodes[bestDown].parent = a;
+		m_nodes[bestUp].parent = bestInner;
+
+		inner.bounds = Aabb::Union(m_nodes[inner.left].bounds, m_nodes[inner.right].bounds);
+		inner.height = 1 + std::max(m_nodes[inner.left].height, m_nodes[inner.right].height);
+	}
+
+	template <class Test, class Visit>
+	void ForEachOverlap(Test&& test, Visit&& visit) const
+	{
+		if (m_root == NullProxy)
+			return;
+
+		auto& stack = Stack<ProxyId>();
+		const auto base = stack.size();
+		stack.push_back(m_root);
+		while (stack.size() > base)
+		{
+			const auto id = stack.back();
+			stack.pop_back();
+			const auto& node = m_nodes[id];
+			if (!test(node.bounds))
+				continue;
+			if (node.IsLeaf())
+			{
+				visit(id);
+				continue;
+			}
+			stack.push_back(node.left);
+			stack.push_back(node.right);
+		}
+	}
+
+private:
+	std::vector<Node> m_nodes;
+	Bvh4 m_flat;
+	ProxyId m_root = NullProxy;
+	ProxyId m_free = NullProxy;
+	size_t m_proxyCount = 0;
+	float m_margin;
+	bool m_dirty = false;
+};
@@ -0,0 +1,225 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "Simd.h"
+
+// Linear allocator for data that lives at most one frame. Allocation bumps a pointer and nothing is
+// freed individually, Reset() rewinds everything at the start of the next frame. When a frame overflows
+// the current block a new one is chained in, and the next Reset() replaces the chain by one block large
+// enough for the peak, so a steady-state frame never reaches the heap.
+// Destructors are not run, objects holding resources must be destroyed before Reset().
+// Not thread safe, use one arena per thread.
+struct FrameArena
+{
+	struct Marker
+	{
+		size_t block;
+		size_t offset;
+	};
+
+	explicit FrameArena(const size_t blockSize = size_t{1} << 20)
+		: m_blockSize(std::max<size_t>(blockSize, 64))
+	{
+		AddBlock(m_blockSize);
+	}
+
+	~FrameArena()
+	{
+		for (auto& block : m_blocks)
+			Simd::AlignedFree(block.data);
+	}
+
+	FrameArena(const FrameArena&) = delete;
+	FrameArena& operator=(const FrameArena&) = delete;
+
+	// alignment must be a power of two no larger than 64, the alignment of every block
+	void* Allocate(const size_t bytes, const size_t alignment = alignof(std::max_align_t))
+	{
+		auto offset = AlignUp(m_offset, alignment);
+		if (offset + bytes > m_blocks[m_block].size)
+		{
+			NextBlock(bytes + alignment);
+			offset = AlignUp(m_offset, alignment);
+		}
+
+		m_offset = offset + bytes;
+		m_peak = std::max(m_peak, GetUsed());
+		return m_blocks[m_block].data + offset;
+	}
+
+	template <class T>
+	T* AllocateArray(const size_t count)
+	{
+		return static_cast<T*>(Allocate(count * sizeof(T), alignof(T)));
+	}
+
+	// Gives back the most recent allocation, so scratch containers destroyed in reverse order return their space
+	void Deallocate(void* ptr, const size_t bytes)
+	{
+		auto end = static_cast<uint8_t*>(ptr) + bytes;
+		if (end == m_blocks[m_block].data + m_offset)
+			m_offset -= bytes;
+	}
+
+	// Rewinds to the start of the frame, merging an overflowed chain into one block
+	void Reset()
+	{
+		if (m_blocks.size() > 1)
+		{
+			auto total = size_t{0};
+			for (auto& block : m_blocks)
+			{
+				total += block.size;
+				Simd::AlignedFree(block.data);
+			}
+			m_blocks.clear();
+			AddBlock(total);
+		}
+		m_block = 0;
+		m_offset = 0;
+		m_previousBlocks = 0;
+	}
+
+	Marker GetMarker() const { return Marker{m_block, m_offset}; }
+
+	// Frees everything allocated after the marker was taken
+	void Rewind(const Marker& marker)
+	{
+		m_block = marker.block;
+		m_offset = marker.offset;
+		m_previousBlocks = 0;
+		for (size_t block = 0; block < m_block; ++block)
+			m_previousBlocks += m_blocks[block].used;
+	}
+
+	// Bytes handed out since the last Reset() including alignment padding
+	size_t GetUsed() const { return m_previousBlocks + m_offset; }
+	// Largest GetUsed() of any frame so far
+	size_t GetPeak() const { return m_peak; }
+
+	size_t GetCapacity() const
+	{
+		auto total = size_t{0};
+		for (auto& block : m_blocks)
+			total += block.size;
+		return total;
+	}
+
+	size_t GetBlockCount() const { return m_blocks.size(); }
+
+private:
+	struct Block
+	{
+		uint8_t* data;
+		size_t size;
+		// Bytes in use when the arena moved on to the next block
+		size_t used;
+	};
+
+	static size_t AlignUp(const size_t value, const size_t alignment)
+	{
+		return (value + alignment - 1) & ~(alignment - 1);
+	}
+
+	void AddBlock(const size_t size)
+	{
+		auto data = static_cast<uint8_t*>(Simd::AlignedAlloc(size, 64));
+		if (!data)
+			throw std::bad_alloc{};
+		m_blocks.push_back(Block{data, size, 0});
+	}
+
+	void NextBlock(const size_t bytes)
+	{
+		m_blocks[m_block].used = m_offset;
+		m_previousBlocks += m_offset;
+		// A block kept from an earlier rewind is reused when the request fits
+		if (m_block + 1 == m_blocks.size() || m_blocks[m_block + 1].size < bytes)
+		{
+			if (m_block + 1 < m_blocks.size())
+			{
+				for (auto i = m_block + 1; i < m_blocks.size(); ++i)
+					Simd::AlignedFree(m_blocks[i].data);
+				m_blocks.resize(m_block + 1);
+			}
+			AddBlock(std::max(m_blockSize, bytes));
+		}
+		++m_block;
+		m_offset = 0;
+	}
+
+private:
+	std::vector<Block> m_blocks;
+	size_t m_blockSize;
+	size_t m_block = 0;
+	size_t m_offset = 0;
+	size_t m_previousBlocks = 0;
+	size_t m_peak = 0;
+};
+
+// Rewinds the arena to where it was when the scope was entered
+struct FrameArenaScope
+{
+	explicit FrameArenaScope(FrameArena& arena)
+		: m_arena(arena), m_marker(arena.GetMarker())
+	{
+	}
+
+	~FrameArenaScope() { m_arena.Rewind(m_marker); }
+
+	FrameArenaScope(const FrameArenaScope&) = delete;
+	FrameArenaScope& operator=(const FrameArenaScope&) = delete;
+
+private:
+	FrameArena& m_arena;
+	FrameArena::Marker m_marker;
+};
+
+// Standard allocator over a FrameArena, e.g. std::vector<T, ArenaAllocator<T>>
+template <class T>
+struct ArenaAllocator
+{
+	using value_type = T;
+
+	template <class U>
+	struct rebind
+	{
+		using other = ArenaAllocator<U>;
+	};
+
+	explicit ArenaAllocator(FrameArena& arena)
+		: m_arena(&arena)
+	{
+	}
+
+	template <class U>
+	ArenaAllocator(const ArenaAllocator<U>& other)
+		: m_arena(other.GetArena())
+	{
+	}
+
+	T* allocate(const size_t count) { return m_arena->AllocateArray<T>(count); }
+	void deallocate(T* ptr, const size_t count) { m_arena->Deallocate(ptr, count * sizeof(T)); }
+
+	FrameArena* GetArena() const { return m_arena; }
+
+	template <class U>
+	bool operator==(const ArenaAllocator<U>& other) const { return m_arena == other.GetArena(); }
+
+	template <class U>
+	bool operator!=(const ArenaAllocator<U>& other) const { return m_arena != other.GetArena(); }
+
+private:
+	FrameArena* m_arena;
+};
+
+template <class T>
+using FrameVector = std::vector<T, ArenaAllocator<T>>;
+
+using FrameString = std::basic_string<char, std::char_traits<char>, ArenaAllocator<char>>;
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Device.h"
+#include "Renderer.h"
+#include "FrameWriter.h"
+
+// Copies the back buffer into a ring of staging textures and reads each one back
+// only once it is `latency` frames old, by then the GPU has finished the copy and Map does not stall.
+// Call Capture() after the frame is rendered and before Present().
+// The back buffer is looked up once, recreate the capture if the swap chain is resized.
+struct FrameCapture
+{
+	FrameCapture(const Device& device, const Renderer& renderer, FrameWriter& writer, const UINT latency = 3)
+		: m_writer(writer), m_backBuffer(renderer.GetBackBuffer())
+	{
+		D3D11_TEXTURE2D_DESC desc{};
+		m_backBuffer->GetDesc(&desc);
+		m_width = desc.Width;
+		m_height = desc.Height;
+
+		desc.MipLevels = 1;
+		desc.ArraySize = 1;
+		desc.SampleDesc.Count = 1;
+		desc.SampleDesc.Quality = 0;
+		desc.Usage = D3D11_USAGE_STAGING;
+		desc.BindFlags = 0;
+		desc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		desc.MiscFlags = 0;
+
+		m_staging.resize(std::max(latency, 1u));
+		for (auto& texture : m_staging)
+			device.GetDevice()->CreateTexture2D(&desc, nullptr, texture.GetAddressOf());
+	}
+
+	void Capture(const Renderer& renderer)
+	{
+		const auto& context = renderer.GetDeviceContext();
+		const auto slot = m_frame % m_staging.size();
+
+		// The slot still holds the frame from m_staging.size() frames ago
+		if (m_frame >= m_staging.size())
+			ReadBack(context, slot);
+
+		context->CopyResource(m_staging[slot].Get(), m_backBuffer.Get());
+		++m_frame;
+	}
+
+	// Reads back the frames still in flight, this waits on the GPU so only call it when capture stops
+	void Flush(const Renderer& renderer)
+	{
+		const auto& context = renderer.GetDeviceContext();
+		const auto count = std::min<UINT64>(m_frame, m_staging.size());
+		for (auto frame = m_frame - count; frame < m_frame; ++frame)
+			ReadBack(context, frame % m_staging.size());
+		m_frame = 0;
+		m_writer.Flush();
+	}
+
+	void Release()
+	{
+		for (auto& texture : m_staging)
+			texture.Reset();
+		m_backBuffer.Reset();
+	}
+
+private:
+	void ReadBack(const ComPtr<ID3D11DeviceContext>& context, const size_t slot)
+	{
+		auto frame = m_writer.AcquireFrame(m_width, m_height);
+		if (!frame)
+			return;
+
+		D3D11_MAPPED_SUBRESOURCE mapped{};
+		if (FAILED(context->Map(m_staging[slot].Get(), 0, D3D11_MAP_READ, 0, &mapped)))
+		{
+			m_writer.ReleaseFrame(std::move(frame));
+			return;
+		}
+
+		// RowPitch is padded by the driver, the writer expects tightly packed rows
+		const auto rowBytes = size_t{m_width} * 4;
+		auto src = static_cast<const uint8_t*>(mapped.pData);
+		for (UINT row = 0; row < m_height; ++row)
+			std::memcpy(frame->rgba.data() + row * rowBytes, src + size_t{row} * mapped.RowPitch, rowBytes);
+		context->Unmap(m_staging[slot].Get(), 0);
+
+		m_writer.Submit(std::move(frame));
+	}
+
+private:
+	FrameWriter& m_writer;
+	ComPtr<ID3D11Texture2D> m_backBuffer;
+	std::vector<ComPtr<ID3D11Texture2D>> m_staging;
+	UINT64 m_frame = 0;
+	UINT m_width = 0;
+	UINT m_height = 0;
+};
@@ -0,0 +1,199 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "ColorConvert.h"
+
+// Container encoders for captured RGBA8 frames, output is appended to a byte buffer
+// so the buffers can be reused between frames
+struct FrameEncoder
+{
+	FrameEncoder() = delete;
+
+	// Stream header, written once before the first frame
+	static void Y4MHeader(std::vector<uint8_t>& out, const uint32_t width, const uint32_t height, const uint32_t fps)
+	{
+		char header[128];
+		const auto length = std::snprintf(header, sizeof(header),
+		                                  "YUV4MPEG2 W%u H%u F%u:1 Ip A1:1 C420jpeg XCOLORRANGE=LIMITED\n",
+		                                  width, height, fps);
+		out.insert(out.end(), header, header + length);
+	}
+
+	// FRAME marker followed by tightly packed I420 planes
+	static void Y4MFrame(std::vector<uint8_t>& out, const uint8_t* rgba, const size_t pitch,
+	                     const uint32_t width, const uint32_t height)
+	{
+		static const char marker[] = "FRAME\n";
+		const auto lumaSize = ColorConvert::LumaSize(width, height);
+		const auto chromaSize = ColorConvert::ChromaSize(width, height);
+		const auto chromaWidth = (width + 1) / 2;
+
+		const auto start = out.size();
+		out.resize(start + sizeof(marker) - 1 + lumaSize + chromaSize * 2);
+		std::memcpy(out.data() + start, marker, sizeof(marker) - 1);
+
+		const auto y = out.data() + start + sizeof(marker) - 1;
+		ColorConvert::RgbaToI420(rgba, pitch, width, height,
+		                         {y, width, y + lumaSize, chromaWidth, y + lumaSize + chromaSize, chromaWidth});
+	}
+
+	// Truecolour+alpha PNG using stored (uncompressed) deflate blocks
+	// Capture favours throughput over size, any PNG reader accepts stored blocks
+	static void Png(std::vector<uint8_t>& out, const uint8_t* rgba, const size_t pitch,
+	                const uint32_t width, const uint32_t height)
+	{
+		static const uint8_t signature[] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+		out.insert(out.end(), signature, signature + sizeof(signature));
+
+		uint8_t ihdr[13];
+		WriteBigEndian(ihdr, width);
+		WriteBigEndian(ihdr + 4, height);
+		ihdr[8] = 8; // bit depth
+		ihdr[9] = 6; // RGBA
+		ihdr[10] = 0;
+		ihdr[11] = 0;
+		ihdr[12] = 0;
+		Chunk(out, "IHDR", ihdr, sizeof(ihdr));
+
+		// Every scanline is prefixed by filter type 0 (None)
+		const auto rowBytes = size_t{width} * 4;
+		const auto rawSize = (rowBytes + 1) * height;
+		const size_t maxBlock = 65535;
+		const auto blocks = rawSize == 0 ? 1 : (rawSize + maxBlock - 1) / maxBlock;
+		const auto dataSize = 2 + blocks * 5 + rawSize + 4;
+
+		const auto chunkStart = out.size();
+		out.resize(chunkStart + 8 + dataSize + 4);
+		auto dst = out.data() + chunkStart;
+		WriteBigEndian(dst, static_cast<uint32_t>(dataSize));
+		std::memcpy(dst + 4, "IDAT", 4);
+		dst += 8;
+
+		// zlib header: deflate, 32K window, no preset dictionary, fastest level
+		*dst++ = 0x78;
+		*dst++ = 0x01;
+
+		uint32_t adlerA = 1, adlerB = 0;
+		size_t remaining = rawSize;
+		size_t row = 0, column = 0;
+		for (size_t block = 0; block < blocks; ++block)
+		{
+			const auto length = static_cast<uint16_t>(remaining < maxBlock ? remaining : maxBlock);
+			remaining -= length;
+			*dst++ = remaining == 0 ? 1 : 0;
+			*dst++ = static_cast<uint8_t>(length);
+			*dst++ = static_cast<uint8_t>(length >> 8);
+			*dst++ = static_cast<uint8_t>(~length);
+			*dst++ = static_cast<uint8_t>(~length >> 8);
+
+			// Blocks split scanlines at arbitrary points, column 0 is the filter byte
+			size_t left = length;
+			while (left > 0)
+			{
+				if (column == 0)
+				{
+					*dst++ = 0;
+					--left;
+					column = 1;
+					continue;
+				}
+				const auto count = std::min(left, rowBytes + 1 - column);
+				std::memcpy(dst, rgba + row * pitch + (column - 1), count);
+				dst += count;
+				left -= count;
+				column += count;
+				if (column == rowBytes + 1)
+				{
+					column = 0;
+					++row;
+				}
+			}
+		}
+
+		// Adler-32 over the raw scanlines, read back from the output to avoid a second pass over pitch
+		const auto raw = out.data() + chunkStart + 8 + 2;
+		size_t offset = 0;
+		for (size_t block = 0; block < blocks; ++block)
+		{
+			const auto length = std::min(maxBlock, rawSize - block * maxBlock);
+			Adler32(raw + offset + 5, length, adlerA, adlerB);
+			offset += 5 + length;
+		}
+		WriteBigEndian(dst, (adlerB << 16) | adlerA);
+		dst += 4;
+
+		WriteBigEndian(dst, Crc32(out.data() + chunkStart + 4, 4 + dataSize));
+		Chunk(out, "IEND", nullptr, 0);
+	}
+
+	static uint32_t Crc32(const uint8_t* data, const size_t size, uint32_t crc = 0)
+	{
+		static const auto table = CrcTable();
+		crc = ~crc;
+		for (size_t i = 0; i < size; ++i)
+			crc = table.values[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+		return ~crc;
+	}
+
+private:
+	struct CrcLookup
+	{
+		uint32_t values[256];
+	};
+
+	static CrcLookup CrcTable()
+	{
+		CrcLookup table{};
+		for (uint32_t n = 0; n < 256; ++n)
+		{
+			auto c = n;
+			for (auto k = 0; k < 8; ++k)
+				c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+			table.values[n] = c;
+		}
+		return table;
+	}
+
+	// Sums are reduced every 5552 bytes, the largest run that cannot overflow 32 bits
+	static void Adler32(const uint8_t* data, size_t size, uint32_t& a, uint32_t& b)
+	{
+		while (size > 0)
+		{
+			const auto run = size < 5552 ? size : 5552;
+			for (size_t i = 0; i < run; ++i)
+			{
+				a += data[i];
+				b += a;
+			}
+			a %= 65521;
+			b %= 65521;
+			data += run;
+			size -= run;
+		}
+	}
+
+	static void WriteBigEndian(uint8_t* dst, const uint32_t value)
+	{
+		dst[0] = static_cast<uint8_t>(value >> 24);
+		dst[1] = static_cast<uint8_t>(value >> 16);
+		dst[2] = static_cast<uint8_t>(value >> 8);
+		dst[3] = static_cast<uint8_t>(value);
+	}
+
+	static void Chunk(std::vector<uint8_t>& out, const char* type, const uint8_t* data, const uint32_t size)
+	{
+		const auto start = out.size();
+		out.resize(start + 12 + size);
+		auto dst = out.data() + start;
+		WriteBigEndian(dst, size);
+		std::memcpy(dst + 4, type, 4);
+		if (size > 0)
+			std::memcpy(dst + 8, data, size);
+		WriteBigEndian(dst + 8 + size, Crc32(dst + 4, 4 + size));
+	}
+};
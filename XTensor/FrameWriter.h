@@ -0,0 +1,264 @@
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "FrameEncoder.h"
+
+enum class CaptureFormat
+{
+	Y4M, // One raw I420 stream, frames are written in submission order
+	Png  // One file per frame, <path>_<index>.png
+};
+
+// A tightly packed RGBA8 image owned by the writer's frame pool
+struct CaptureFrame
+{
+	std::vector<uint8_t> rgba;
+	std::vector<uint8_t> encoded;
+	uint32_t width = 0;
+	uint32_t height = 0;
+	uint64_t index = 0;
+};
+
+// Converts and encodes captured frames on worker threads and writes them to disk
+// Frames come from a fixed pool, when it runs dry the frame is dropped instead of stalling the caller
+struct FrameWriter
+{
+	FrameWriter(std::string path, const CaptureFormat format, const uint32_t fps = 60,
+	            const size_t threadCount = 2, const size_t poolSize = 8)
+		: m_path(std::move(path)), m_format(format), m_fps(fps)
+	{
+		for (size_t i = 0; i < poolSize; ++i)
+			m_free.push_back(std::unique_ptr<CaptureFrame>(new CaptureFrame{}));
+		for (size_t i = 0; i < std::max<size_t>(threadCount, 1); ++i)
+			m_workers.emplace_back([this] { WorkerLoop(); });
+	}
+
+	FrameWriter(const FrameWriter&) = delete;
+	FrameWriter& operator=(const FrameWriter&) = delete;
+
+	~FrameWriter()
+	{
+		Close();
+	}
+
+	// Returns a frame sized for width x height, or nullptr when every pooled frame is in flight
+	std::unique_ptr<CaptureFrame> AcquireFrame(const uint32_t width, const uint32_t height)
+	{
+		std::unique_ptr<CaptureFrame> frame;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (m_free.empty())
+			{
+				++m_dropped;
+				return nullptr;
+			}
+			frame = std::move(m_free.back());
+			m_free.pop_back();
+		}
+		frame->width = width;
+		frame->height = height;
+		frame->rgba.resize(size_t{width} * height * 4);
+		return frame;
+	}
+
+	// Returns an acquired frame that will not be submitted to the pool, it counts as dropped
+	void ReleaseFrame(std::unique_ptr<CaptureFrame> frame)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_free.push_back(std::move(frame));
+		++m_dropped;
+	}
+
+	// Queues a filled frame, submission order defines the frame index
+	void Submit(std::unique_ptr<CaptureFrame> frame)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			frame->index = m_nextIndex++;
+			m_queue.push_back(std::move(frame));
+		}
+		m_wake.notify_one();
+	}
+
+	// Waits until every submitted frame has been written
+	void Flush()
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_idle.wait(lock, [this] { return m_written == m_nextIndex; });
+	}
+
+	void Close()
+	{
+		if (m_workers.empty())
+			return;
+
+		Flush();
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers)
+			worker.join();
+		m_workers.clear();
+
+		if (m_stream)
+		{
+			std::fclose(m_stream);
+			m_stream = nullptr;
+		}
+	}
+
+	uint64_t GetWrittenFrames() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_written;
+	}
+
+	uint64_t GetDroppedFrames() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_dropped;
+	}
+
+	bool HasError() const
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		return m_error;
+	}
+
+private:
+	void WorkerLoop()
+	{
+		for (;;)
+		{
+			std::unique_ptr<CaptureFrame> frame;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [this] { return m_quit || !m_queue.empty(); });
+				if (m_queue.empty())
+					return;
+				frame = std::move(m_queue.front());
+				m_queue.pop_front();
+			}
+
+			// Conversion and encoding are the expensive part and run unlocked
+			frame->encoded.clear();
+			const auto pitch = size_t{frame->width} * 4;
+			if (m_format == CaptureFormat::Y4M)
+				FrameEncoder::Y4MFrame(frame->encoded, frame->rgba.data(), pitch, frame->width, frame->height);
+			else
+				FrameEncoder::Png(frame->encoded, frame->rgba.data(), pitch, frame->width, frame->height);
+
+			if (m_format == CaptureFormat::Png)
+			{
+				const auto ok = WriteFile(PngPath(frame->index), frame->encoded);
+				Recycle(std::move(frame), 1, ok);
+			}
+			else
+			{
+				WriteOrdered(std::move(frame));
+			}
+		}
+	}
+
+	// Y4M frames finish out of order, whichever worker completes the next expected frame
+	// drains every consecutive frame that is ready
+	void WriteOrdered(std::unique_ptr<CaptureFrame> frame)
+	{
+		std::lock_guard<std::mutex> writeLock(m_writeMutex);
+		m_pending[frame->index] = std::move(frame);
+
+		for (auto it = m_pending.find(m_nextWrite); it != m_pending.end(); it = m_pending.find(m_nextWrite))
+		{
+			auto ready = std::move(it->second);
+			m_pending.erase(it);
+			++m_nextWrite;
+
+			// After a failed open or write nothing more is written, a stream with a gap is not a valid capture
+			auto ok = !m_streamFailed;
+			if (ok && !m_stream)
+			{
+				m_stream = std::fopen(m_path.c_str(), "wb");
+				std::vector<uint8_t> header;
+				FrameEncoder::Y4MHeader(header, ready->width, ready->height, m_fps);
+				ok = m_stream && std::fwrite(header.data(), 1, header.size(), m_stream) == header.size();
+			}
+			if (ok)
+				ok = std::fwrite(ready->encoded.data(), 1, ready->encoded.size(), m_stream) == ready->encoded.size();
+			m_streamFailed = !ok;
+			Recycle(std::move(ready), 1, ok);
+		}
+	}
+
+	void Recycle(std::unique_ptr<CaptureFrame> frame, const size_t written, const bool ok)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_free.push_back(std::move(frame));
+			m_error = m_error || !ok;
+		}
+		if (written > 0)
+			MarkWritten(written);
+	}
+
+	void MarkWritten(const size_t count)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_written += count;
+		}
+		m_idle.notify_all();
+	}
+
+	std::string PngPath(const uint64_t index) const
+	{
+		char suffix[32];
+		std::snprintf(suffix, sizeof(suffix), "_%06llu.png", static_cast<unsigned long long>(index));
+		return m_path + suffix;
+	}
+
+	static bool WriteFile(const std::string& path, const std::vector<uint8_t>& data)
+	{
+		const auto file = std::fopen(path.c_str(), "wb");
+		if (!file)
+			return false;
+		const auto ok = std::fwrite(data.data(), 1, data.size(), file) == data.size();
+		return std::fclose(file) == 0 && ok;
+	}
+
+private:
+	std::string m_path;
+	CaptureFormat m_format;
+	uint32_t m_fps;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_idle;
+	std::deque<std::unique_ptr<CaptureFrame>> m_queue;
+	std::vector<std::unique_ptr<CaptureFrame>> m_free;
+	std::vector<std::thread> m_workers;
+	uint64_t m_nextIndex = 0;
+	uint64_t m_written = 0;
+	uint64_t m_dropped = 0;
+	bool m_error = false;
+	bool m_quit = false;
+
+	// Guards the ordered Y4M stream
+	std::mutex m_writeMutex;
+	std::map<uint64_t, std::unique_ptr<CaptureFrame>> m_pending;
+	uint64_t m_nextWrite = 0;
+	FILE* m_stream = nullptr;
+	bool m_streamFailed = false;
+};
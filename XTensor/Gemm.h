@@ -0,0 +1,336 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+#include "Simd.h"
+#include "Tensor.h"
+#include "ThreadPool.h"
+
+// Single precision C = alpha * A * B + beta * C
+// Matrices are addressed through a row stride and a column stride, so transposed
+// and sliced Tensor views are consumed directly by the packing routines.
+// The loop nest follows the BLIS/Goto layout: B is packed into KC x NC panels kept in L3,
+// A into MC x KC blocks kept in L2, and a 6x16 register tile accumulates in 12 ymm registers.
+struct Gemm
+{
+	Gemm() = delete;
+
+	enum : size_t
+	{
+		MR = 6,
+		NR = 16,
+		KC = 256,
+		MC = 144,
+		NC = 3072
+	};
+
+	struct Matrix
+	{
+		const float* data;
+		ptrdiff_t rowStride;
+		ptrdiff_t colStride;
+	};
+
+	static void Multiply(const size_t m, const size_t n, const size_t k, const float alpha,
+	                     const Matrix a, const Matrix b, const float beta,
+	                     float* c, const ptrdiff_t ldc, ThreadPool& pool = ThreadPool::GetDefault())
+	{
+		if (m == 0 || n == 0)
+			return;
+		if (k == 0 || alpha == 0.f)
+		{
+			ScaleC(m, n, beta, c, ldc);
+			return;
+		}
+
+		const auto avx2 = Simd::HasAvx2();
+		auto& packedB = Scratch(size_t{KC} * NC, 0);
+
+		for (size_t jc = 0; jc < n; jc += NC)
+		{
+			const auto nc = std::min<size_t>(NC, n - jc);
+			const auto nPanels = (nc + NR - 1) / NR;
+
+			for (size_t pc = 0; pc < k; pc += KC)
+			{
+				const auto kc = std::min<size_t>(KC, k - pc);
+				// beta only applies to the first rank-kc update, later ones accumulate
+				const auto betaBlock = pc == 0 ? beta : 1.f;
+
+				pool.ParallelFor(nPanels, 4, [&](const size_t begin, const size_t end)
+				{
+					for (auto panel = begin; panel < end; ++panel)
+					{
+						const auto j = panel * NR;
+						PackB(kc, std::min<size_t>(NR, nc - j), At(b, pc, jc + j), b, packedB.data + panel * NR * kc);
+					}
+				});
+
+				// Tiles are (MC rows) x (a group of NR panels), enough of them to keep every thread busy
+				const auto mBlocks = (m + MC - 1) / MC;
+				const auto nSplit = std::min<size_t>(nPanels, std::max<size_t>(1, (pool.GetThreadCount() * 2 + mBlocks - 1) / mBlocks));
+				const auto panelsPerSplit = (nPanels + nSplit - 1) / nSplit;
+
+				pool.ParallelFor(mBlocks * nSplit, 1, [&](const size_t begin, const size_t end)
+				{
+					auto& packedA = Scratch(size_t{MC} * KC, 1);
+					for (auto tile = begin; tile < end; ++tile)
+					{
+						const auto ic = (tile / nSplit) * MC;
+						const auto mc = std::min<size_t>(MC, m - ic);
+						const auto firstPanel = (tile % nSplit) * panelsPerSplit;
+						const auto lastPanel = std::min<size_t>(nPanels, firstPanel + panelsPerSplit);
+						if (firstPanel >= lastPanel)
+							continue;
+
+						PackA(mc, kc, At(a, ic, pc), a, packedA.data);
+						for (auto panel = firstPanel; panel < lastPanel; ++panel)
+						{
+							const auto jr = panel * NR;
+							const auto nr = std::min<size_t>(NR, nc - jr);
+							for (size_t ir = 0; ir < mc; ir += MR)
+							{
+								const auto mr = std::min<size_t>(MR, mc - ir);
+								auto tileC = c + static_cast<ptrdiff_t>(ic + ir) * ldc + static_cast<ptrdiff_t>(jc + jr);
+								const auto tileA = packedA.data + ir * kc;
+								const auto tileB = packedB.data + panel * NR * kc;
+#if XT_SIMD_X86
+								if (avx2)
+								{
+									KernelAvx2(kc, tileA, tileB, tileC, ldc, mr, nr, alpha, betaBlock);
+									continue;
+								}
+#endif
+								KernelScalar(kc, tileA, tileB, tileC, ldc, mr, nr, alpha, betaBlock);
+							}
+						}
+					}
+				});
+			}
+		}
+	}
+
+	// Reference triple loop, used to validate Multiply and as the benchmark baseline
+	static void MultiplyNaive(const size_t m, const size_t n, const size_t k, const float alpha,
+	                          const Matrix a, const Matrix b, const float beta, float* c, const ptrdiff_t ldc)
+	{
+		for (size_t i = 0; i < m; ++i)
+		{
+			for (size_t j = 0; j < n; ++j)
+			{
+				auto sum = 0.f;
+				for (size_t p = 0; p < k; ++p)
+					sum += *At(a, i, p) * *At(b, p, j);
+				auto& out = c[static_cast<ptrdiff_t>(i) * ldc + static_cast<ptrdiff_t>(j)];
+				out = alpha * sum + (beta == 0.f ? 0.f : beta * out);
+			}
+		}
+	}
+
+	// Matrix product of two rank 2 tensors or views
+	static Tensor MatMul(const Tensor& a, const Tensor& b)
+	{
+		assert(a.GetRank() == 2 && b.GetRank() == 2 && a.GetDim(1) == b.GetDim(0));
+		Tensor c({a.GetDim(0), b.GetDim(1)});
+		Multiply(a.GetDim(0), b.GetDim(1), a.GetDim(1), 1.f, ToMatrix(a), ToMatrix(b), 0.f,
+		         c.Data(), static_cast<ptrdiff_t>(b.GetDim(1)));
+		return c;
+	}
+
+	// Accumulates alpha * a * b + beta * c into a contiguous-row output tensor
+	static void MatMulInto(Tensor& c, const Tensor& a, const Tensor& b, const float alpha = 1.f, const float beta = 0.f)
+	{
+		assert(a.GetRank() == 2 && b.GetRank() == 2 && c.GetRank() == 2);
+		assert(a.GetDim(1) == b.GetDim(0) && c.GetDim(0) == a.GetDim(0) && c.GetDim(1) == b.GetDim(1));
+		assert(c.GetStrides()[1] == 1 && "Output rows must be contiguous.");
+		Multiply(a.GetDim(0), b.GetDim(1), a.GetDim(1), alpha, ToMatrix(a), ToMatrix(b), beta,
+		         c.Data(), c.GetStrides()[0]);
+	}
+
+	static Matrix ToMatrix(const Tensor& t)
+	{
+		return Matrix{t.Data(), t.GetStrides()[0], t.GetStrides()[1]};
+	}
+
+private:
+	struct AlignedBuffer
+	{
+		float* data = nullptr;
+		size_t size = 0;
+
+		~AlignedBuffer() { Simd::AlignedFree(data); }
+	};
+
+	// Packing buffers are reused across calls, slot 0 is the shared B panel of the calling thread
+	// and slot 1 the per-thread A block
+	static AlignedBuffer& Scratch(const size_t size, const size_t slot)
+	{
+		thread_local AlignedBuffer buffers[2];
+		auto& buffer = buffers[slot];
+		if (buffer.size < size)
+		{
+			Simd::AlignedFree(buffer.data);
+			buffer.data = static_cast<float*>(Simd::AlignedAlloc(size * sizeof(float)));
+			buffer.size = size;
+		}
+		return buffer;
+	}
+
+	static const float* At(const Matrix& matrix, const size_t row, const size_t col)
+	{
+		return matrix.data + static_cast<ptrdiff_t>(row) * matrix.rowStride + static_cast<ptrdiff_t>(col) * matrix.colStride;
+	}
+
+	static void ScaleC(const size_t m, const size_t n, const float beta, float* c, const ptrdiff_t ldc)
+	{
+		for (size_t i = 0; i < m; ++i)
+		{
+			auto row = c + static_cast<ptrdiff_t>(i) * ldc;
+			for (size_t j = 0; j < n; ++j)
+				row[j] = beta == 0.f ? 0.f : beta * row[j];
+		}
+	}
+
+	// mc x kc block of A into MR row slivers, each stored column by column and zero padded
+	static void PackA(const size_t mc, const size_t kc, const float* src, const Matrix& a, float* dst)
+	{
+		for (size_t ir = 0; ir < mc; ir += MR)
+		{
+			const auto mr = std::min<size_t>(MR, mc - ir);
+			const auto rows = src + static_cast<ptrdiff_t>(ir) * a.rowStride;
+			for (size_t p = 0; p < kc; ++p)
+			{
+				const auto col = rows + static_cast<ptrdiff_t>(p) * a.colStride;
+				size_t i = 0;
+				for (; i < mr; ++i)
+					dst[i] = col[static_cast<ptrdiff_t>(i) * a.rowStride];
+				for (; i < MR; ++i)
+					dst[i] = 0.f;
+				dst += MR;
+			}
+		}
+	}
+
+	// kc x nr sliver of B stored row by row and zero padded to NR columns
+	static void PackB(const size_t kc, const size_t nr, const float* src, const Matrix& b, float* dst)
+	{
+		for (size_t p = 0; p < kc; ++p)
+		{
+			const auto row = src + static_cast<ptrdiff_t>(p) * b.rowStride;
+			if (b.colStride == 1 && nr == NR)
+			{
+				std::memcpy(dst, row, NR * sizeof(float));
+			}
+			else
+			{
+				size_t j = 0;
+				for (; j < nr; ++j)
+					dst[j] = row[static_cast<ptrdiff_t>(j) * b.colStride];
+				for (; j < NR; ++j)
+					dst[j] = 0.f;
+			}
+			dst += NR;
+		}
+	}
+
+	static void StoreTile(const float* tile, float* c, const ptrdiff_t ldc, const size_t mr, const size_t nr,
+	                      const float alpha, const float beta)
+	{
+		for (size_t i = 0; i < mr; ++i)
+		{
+			auto row = c + static_cast<ptrdiff_t>(i) * ldc;
+			for (size_t j = 0; j < nr; ++j)
+				row[j] = alpha * tile[i * NR + j] + (beta == 0.f ? 0.f : beta * row[j]);
+		}
+	}
+
+	static void KernelScalar(const size_t kc, const float* a, const float* b, float* c, const ptrdiff_t ldc,
+	                         const size_t mr, const size_t nr, const float alpha, const float beta)
+	{
+		float tile[MR * NR] = {};
+		for (size_t p = 0; p < kc; ++p)
+		{
+			for (size_t i = 0; i < MR; ++i)
+			{
+				const auto ai = a[p * MR + i];
+				for (size_t j = 0; j < NR; ++j)
+					tile[i * NR + j] += ai * b[p * NR + j];
+			}
+		}
+		StoreTile(tile, c, ldc, mr, nr, alpha, beta);
+	}
+
+#if XT_SIMD_X86
+	static XT_TARGET_AVX2 void KernelAvx2(const size_t kc, const float* a, const float* b, float* c, const ptrdiff_t ldc,
+	                                      const size_t mr, const size_t nr, const float alpha, const float beta)
+	{
+		auto c00 = _mm256_setzero_ps(), c01 = _mm256_setzero_ps();
+		auto c10 = _mm256_setzero_ps(), c11 = _mm256_setzero_ps();
+		auto c20 = _mm256_setzero_ps(), c21 = _mm256_setzero_ps();
+		auto c30 = _mm256_setzero_ps(), c31 = _mm256_setzero_ps();
+		auto c40 = _mm256_setzero_ps(), c41 = _mm256_setzero_ps();
+		auto c50 = _mm256_setzero_ps(), c51 = _mm256_setzero_ps();
+
+		for (size_t p = 0; p < kc; ++p)
+		{
+			const auto b0 = _mm256_load_ps(b);
+			const auto b1 = _mm256_load_ps(b + 8);
+			_mm_prefetch(reinterpret_cast<const char*>(b + 8 * NR), _MM_HINT_T0);
+
+			auto ai = _mm256_broadcast_ss(a + 0);
+			c00 = _mm256_fmadd_ps(ai, b0, c00);
+			c01 = _mm256_fmadd_ps(ai, b1, c01);
+			ai = _mm256_broadcast_ss(a + 1);
+			c10 = _mm256_fmadd_ps(ai, b0, c10);
+			c11 = _mm256_fmadd_ps(ai, b1, c11);
+			ai = _mm256_broadcast_ss(a + 2);
+			c20 = _mm256_fmadd_ps(ai, b0, c20);
+			c21 = _mm256_fmadd_ps(ai, b1, c21);
+			ai = _mm256_broadcast_ss(a + 3);
+			c30 = _mm256_fmadd_ps(ai, b0, c30);
+			c31 = _mm256_fmadd_ps(ai, b1, c31);
+			ai = _mm256_broadcast_ss(a + 4);
+			c40 = _mm256_fmadd_ps(ai, b0, c40);
+			c41 = _mm256_fmadd_ps(ai, b1, c41);
+			ai = _mm256_broadcast_ss(a + 5);
+			c50 = _mm256_fmadd_ps(ai, b0, c50);
+			c51 = _mm256_fmadd_ps(ai, b1, c51);
+
+			a += MR;
+			b += NR;
+		}
+
+		const __m256 acc[MR][2] = {{c00, c01}, {c10, c11}, {c20, c21}, {c30, c31}, {c40, c41}, {c50, c51}};
+		if (mr == MR && nr == NR)
+		{
+			const auto va = _mm256_set1_ps(alpha);
+			const auto vb = _mm256_set1_ps(beta);
+			for (size_t i = 0; i < MR; ++i)
+			{
+				auto row = c + static_cast<ptrdiff_t>(i) * ldc;
+				auto r0 = _mm256_mul_ps(va, acc[i][0]);
+				auto r1 = _mm256_mul_ps(va, acc[i][1]);
+				// beta == 0 must not read C, it may hold NaN from uninitialised memory
+				if (beta != 0.f)
+				{
+					r0 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(row), r0);
+					r1 = _mm256_fmadd_ps(vb, _mm256_loadu_ps(row + 8), r1);
+				}
+				_mm256_storeu_ps(row, r0);
+				_mm256_storeu_ps(row + 8, r1);
+			}
+			return;
+		}
+
+		alignas(32) float tile[MR * NR];
+		for (size_t i = 0; i < MR; ++i)
+		{
+			_mm256_store_ps(tile + i * NR, acc[i][0]);
+			_mm256_store_ps(tile + i * NR + 8, acc[i][1]);
+		}
+		StoreTile(tile, c, ldc, mr, nr, alpha, beta);
+	}
+#endif
+};
@@ -0,0 +1,71 @@
+struct VS_OUTPUT
+{
+	float4 Position : SV_POSITION;
+	float3 ViewPosition : VIEWPOSITION;
+	float3 Normal : NORMAL;
+	float4 Color : COLOR;
+};
+
+// Must match Light in ClusteredLighting.h, positions and directions are in view space
+struct Light
+{
+	float3 Position;
+	float Range;
+	float3 Color;
+	uint Type;
+	float3 Direction;
+	float CosOuter;
+	float CosInner;
+	float3 Padding;
+};
+
+#define LIGHT_SPOT 1
+
+cbuffer CBClusters : register(b0)
+{
+	uint TilesX;
+	uint TilesY;
+	uint Slices;
+	float SliceScale;
+	float2 TileSize;
+	float SliceBias;
+	float4 Ambient;
+};
+
+StructuredBuffer<Light> Lights : register(t0);
+// Offset into LightIndices and light count of every cluster
+StructuredBuffer<uint2> Clusters : register(t1);
+StructuredBuffer<uint> LightIndices : register(t2);
+
+float4 main( VS_OUTPUT input ) : SV_TARGET
+{
+	// Same cluster mapping as ClusteredLighting::SliceOf, tile row 0 at the top of the screen
+	uint2 tile = min(uint2(input.Position.xy / TileSize), uint2(TilesX - 1, TilesY - 1));
+	uint slice = min((uint)max(log(input.ViewPosition.z) * SliceScale + SliceBias, 0.f), Slices - 1);
+	uint2 cluster = Clusters[(slice * TilesY + tile.y) * TilesX + tile.x];
+
+	float3 normal = normalize(input.Normal);
+	float3 lighting = Ambient.rgb;
+	for (uint i = 0; i < cluster.y; ++i)
+	{
+		Light light = Lights[LightIndices[cluster.x + i]];
+		float3 toLight = light.Position - input.ViewPosition;
+		float distance = length(toLight);
+		float3 direction = toLight / max(distance, 1e-4f);
+
+		// Inverse square falloff windowed to reach zero at the range
+		float ratio = saturate(distance / light.Range);
+		float window = saturate(1.f - ratio * ratio * ratio * ratio);
+		float attenuation = window * window / (distance * distance + 1.f);
+
+		if (light.Type == LIGHT_SPOT)
+		{
+			float cosAngle = dot(-direction, light.Direction);
+			attenuation *= saturate((cosAngle - light.CosOuter) / max(light.CosInner - light.CosOuter, 1e-4f));
+		}
+
+		lighting += light.Color * attenuation * saturate(dot(normal, direction));
+	}
+
+	return float4(input.Color.rgb * lighting, input.Color.a);
+}
\ No newline at end of file
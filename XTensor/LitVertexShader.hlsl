@@ -0,0 +1,26 @@
+struct VS_OUTPUT
+{
+	float4 Position : SV_POSITION;
+	float3 ViewPosition : VIEWPOSITION;
+	float3 Normal : NORMAL;
+	float4 Color : COLOR;
+};
+
+cbuffer CBLitObject : register(b0)
+{
+	float4x4 WVP;
+	float4x4 WorldView;
+};
+
+VS_OUTPUT main( float3 pos : POSITION, float3 normal : NORMAL, float4 color : COLOR )
+{
+	VS_OUTPUT output;
+
+	output.Position = mul(float4(pos, 1.f), WVP);
+	output.ViewPosition = mul(float4(pos, 1.f), WorldView).xyz;
+	// Assumes uniform scale, the pixel shader normalizes
+	output.Normal = mul(normal, (float3x3)WorldView);
+	output.Color = color;
+
+	return output;
+}
\ No newline at end of file
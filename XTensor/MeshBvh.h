@@ -0,0 +1,328 @@
+#pragma once
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <numeric>
+#include <vector>
+
+#include "Aabb.h"
+#include "Bvh4.h"
+
+struct MeshHit
+{
+	float t;
+	// Index into the mesh's index buffer divided by three
+	uint32_t triangle;
+	// Barycentric coordinates of the hit relative to the triangle's second and third vertex
+	float u;
+	float v;
+};
+
+// Static triangle BVH over one mesh in object space, built once from the same vertex and index data
+// handed to Buffer::CreateVertexBuffer/CreateIndexBuffer. Transform rays and boxes by the inverse world
+// matrix before querying. The binary tree is built with binned SAH and then collapsed into a Bvh4,
+// triangles are reordered to match the leaves and stored as one vertex plus two edges.
+struct MeshBvh
+{
+	enum : uint32_t
+	{
+		BinCount = 16,
+		MaxLeafSize = 4
+	};
+
+	MeshBvh() = default;
+
+	MeshBvh(const float* positions, const size_t stride, const size_t vertexCount,
+	        const uint32_t* indices, const size_t indexCount)
+	{
+		Build(positions, stride, vertexCount, indices, indexCount);
+	}
+
+	// positions points at the first vertex's x, stride is the vertex size in bytes.
+	// Without indices every three consecutive vertices form a triangle.
+	void Build(const float* positions, const size_t stride, const size_t vertexCount,
+	           const uint32_t* indices, const size_t indexCount)
+	{
+		const auto triangleCount = (indices ? indexCount : vertexCount) / 3;
+		const auto vertex = [&](const size_t triangle, const int corner)
+		{
+			const auto i = indices ? indices[triangle * 3 + corner] : triangle * 3 + corner;
+			return reinterpret_cast<const float*>(reinterpret_cast<const uint8_t*>(positions) + i * stride);
+		};
+
+		m_triangles.clear();
+		m_triangleIds.clear();
+		m_nodes.clear();
+		m_bounds = Aabb::Empty();
+		if (triangleCount == 0)
+		{
+			m_bvh.Build(TreeView{m_nodes}, -1);
+			return;
+		}
+
+		m_triangleBounds.resize(triangleCount);
+		m_centroids.resize(triangleCount * 3);
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			auto bounds = Aabb::Empty();
+			for (auto corner = 0; corner < 3; ++corner)
+				bounds.Extend(vertex(i, corner));
+			m_triangleBounds[i] = bounds;
+			for (auto axis = 0; axis < 3; ++axis)
+				m_centroids[i * 3 + axis] = bounds.Center(axis);
+		}
+
+		m_triangleIds.resize(triangleCount);
+		std::iota(m_triangleIds.begin(), m_triangleIds.end(), 0u);
+		m_nodes.reserve(triangleCount * 2);
+		m_nodes.push_back(BuildNode{});
+		Subdivide(0, 0, static_cast<uint32_t>(triangleCount));
+		m_bounds = m_nodes[0].bounds;
+
+		m_triangles.resize(triangleCount);
+		for (size_t i = 0; i < triangleCount; ++i)
+		{
+			auto& triangle = m_triangles[i];
+			const auto v0 = vertex(m_triangleIds[i], 0);
+			const auto v1 = vertex(m_triangleIds[i], 1);
+			const auto v2 = vertex(m_triangleIds[i], 2);
+			for (auto axis = 0; axis < 3; ++axis)
+			{
+				triangle.v0[axis] = v0[axis];
+				triangle.e1[axis] = v1[axis] - v0[axis];
+				triangle.e2[axis] = v2[axis] - v0[axis];
+			}
+		}
+
+		m_bvh.Build(TreeView{m_nodes}, 0);
+
+		// Only the collapsed tree is needed for queries
+		m_nodes = std::vector<BuildNode>();
+		m_triangleBounds = std::vector<Aabb>();
+		m_centroids = std::vector<float>();
+	}
+
+	// Nearest hit of either winding within [0, ray.maxT]
+	bool Raycast(const Ray& ray, MeshHit& hit) const
+	{
+		auto found = false;
+		m_bvh.Raycast(ray, [&](const uint32_t first, const uint32_t count, float& maxT)
+		{
+			for (auto i = first; i < first + count; ++i)
+			{
+				float t, u, v;
+				if (!Intersect(m_triangles[i], ray, maxT, t, u, v))
+					continue;
+				maxT = t;
+				hit = MeshHit{t, m_triangleIds[i], u, v};
+				found = true;
+			}
+		});
+		return found;
+	}
+
+	// visit(triangle) for every triangle whose bounds overlap bounds
+	template <class Visit>
+	void Query(const Aabb& bounds, Visit&& visit) const
+	{
+		m_bvh.Query(bounds, [&](const uint32_t first, const uint32_t count)
+		{
+			for (auto i = first; i < first + count; ++i)
+				if (GetTriangleBounds(i).Overlaps(bounds))
+					visit(m_triangleIds[i]);
+		});
+	}
+
+	const Aabb& GetBounds() const { return m_bounds; }
+	size_t GetTriangleCount() const { return m_triangles.size(); }
+	bool IsEmpty() const { return m_triangles.empty(); }
+
+private:
+	struct Triangle
+	{
+		float v0[3];
+		float e1[3];
+		float e2[3];
+	};
+
+	struct BuildNode
+	{
+		Aabb bounds;
+		int32_t left;
+		int32_t right;
+		uint32_t first;
+		uint32_t count;
+	};
+
+	// Exposes the build tree to Bvh4::Build, leaves index ranges of the reordered triangles
+	struct TreeView
+	{
+		const std::vector<BuildNode>& nodes;
+
+		bool IsLeaf(const int32_t i) const { return nodes[i].count > 0; }
+		const Aabb& GetBounds(const int32_t i) const { return nodes[i].bounds; }
+		int32_t GetLeft(const int32_t i) const { return nodes[i].left; }
+		int32_t GetRight(const int32_t i) const { return nodes[i].right; }
+		int32_t GetFirst(const int32_t i) const { return static_cast<int32_t>(nodes[i].first); }
+		uint32_t GetCount(const int32_t i) const { return nodes[i].count; }
+	};
+
+	struct Bin
+	{
+		Aabb bounds;
+		uint32_t count;
+	};
+
+	void Subdivide(const int32_t index, const uint32_t first, const uint32_t count)
+	{
+		auto bounds = Aabb::Empty();
+		auto centroidBounds = Aabb::Empty();
+		for (auto i = first; i < first + count; ++i)
+		{
+			bounds = Aabb::Union(bounds, m_triangleBounds[m_triangleIds[i]]);
+			centroidBounds.Extend(&m_centroids[m_triangleIds[i] * 3]);
+		}
+		m_nodes[index] = BuildNode{bounds, -1, -1, first, count};
+		if (count <= 1)
+			return;
+
+		// SAH cost in units of triangle tests, a traversal step costs about one test
+		auto bestCost = FLT_MAX;
+		auto bestAxis = -1;
+		uint32_t bestSplit = 0;
+		for (auto axis = 0; axis < 3; ++axis)
+		{
+			const auto extent = centroidBounds.max[axis] - centroidBounds.min[axis];
+			if (extent <= 0.f)
+				continue;
+
+			Bin bins[BinCount];
+			for (auto& bin : bins)
+				bin = Bin{Aabb::Empty(), 0};
+			const auto scale = BinCount / extent;
+			for (auto i = first; i < first + count; ++i)
+			{
+				auto& bin = bins[BinIndex(m_centroids[m_triangleIds[i] * 3 + axis], centroidBounds.min[axis], scale)];
+				bin.bounds = Aabb::Union(bin.bounds, m_triangleBounds[m_triangleIds[i]]);
+				++bin.count;
+			}
+
+			// Sweep from the right, then evaluate every plane from the left
+			float rightArea[BinCount];
+			uint32_t rightCount[BinCount];
+			auto right = Aabb::Empty();
+			uint32_t rightTotal = 0;
+			for (auto i = BinCount - 1; i > 0; --i)
+			{
+				right = Aabb::Union(right, bins[i].bounds);
+				rightTotal += bins[i].count;
+				rightArea[i] = rightTotal ? right.HalfArea() : 0.f;
+				rightCount[i] = rightTotal;
+			}
+
+			auto left = Aabb::Empty();
+			uint32_t leftTotal = 0;
+			for (uint32_t split = 1; split < BinCount; ++split)
+			{
+				left = Aabb::Union(left, bins[split - 1].bounds);
+				leftTotal += bins[split - 1].count;
+				if (leftTotal == 0 || rightCount[split] == 0)
+					continue;
+				const auto cost = bounds.HalfArea() + left.HalfArea() * leftTotal + rightArea[split] * rightCount[split];
+				if (cost < bestCost)
+				{
+					bestCost = cost;
+					bestAxis = axis;
+					bestSplit = split;
+				}
+			}
+		}
+
+		// Small ranges stay leaves unless splitting them is cheaper, larger ones are always split
+		if (count <= MaxLeafSize && bestCost >= bounds.HalfArea() * count)
+			return;
+
+		uint32_t leftCount;
+		if (bestAxis >= 0)
+		{
+			const auto axis = bestAxis;
+			const auto scale = BinCount / (centroidBounds.max[axis] - centroidBounds.min[axis]);
+			const auto middle = std::partition(m_triangleIds.begin() + first, m_triangleIds.begin() + first + count,
+			                                   [&](const uint32_t id)
+			                                   {
+				                                   return BinIndex(m_centroids[id * 3 + axis], centroidBounds.min[axis], scale) < bestSplit;
+			                                   });
+			leftCount = static_cast<uint32_t>(middle - (m_triangleIds.begin() + first));
+		}
+		else
+		{
+			// Coincident centroids give SAH nothing to bin, halve the range to bound the leaf size
+			leftCount = count / 2;
+		}
+
+		const auto left = static_cast<int32_t>(m_nodes.size());
+		m_nodes.push_back(BuildNode{});
+		m_nodes.push_back(BuildNode{});
+		m_nodes[index].left = left;
+		m_nodes[index].right = left + 1;
+		m_nodes[index].count = 0;
+		Subdivide(left, first, leftCount);
+		Subdivide(left + 1, first + leftCount, count - leftCount);
+	}
+
+	static uint32_t BinIndex(const float centroid, const float min, const float scale)
+	{
+		const auto bin = static_cast<int32_t>((centroid - min) * scale);
+		return static_cast<uint32_t>(std::min(std::max(bin, 0), static_cast<int32_t>(BinCount) - 1));
+	}
+
+	Aabb GetTriangleBounds(const uint32_t i) const
+	{
+		const auto& triangle = m_triangles[i];
+		auto bounds = Aabb{{triangle.v0[0], triangle.v0[1], triangle.v0[2]}, {triangle.v0[0], triangle.v0[1], triangle.v0[2]}};
+		const float v1[3] = {triangle.v0[0] + triangle.e1[0], triangle.v0[1] + triangle.e1[1], triangle.v0[2] + triangle.e1[2]};
+		const float v2[3] = {triangle.v0[0] + triangle.e2[0], triangle.v0[1] + triangle.e2[1], triangle.v0[2] + triangle.e2[2]};
+		bounds.Extend(v1);
+		bounds.Extend(v2);
+		return bounds;
+	}
+
+	// Moller-Trumbore, accepts both windings
+	static bool Intersect(const Triangle& triangle, const Ray& ray, const float maxT, float& t, float& u, float& v)
+	{
+		const auto& d = ray.direction;
+		const auto& e1 = triangle.e1;
+		const auto& e2 = triangle.e2;
+		const float p[3] = {d[1] * e2[2] - d[2] * e2[1], d[2] * e2[0] - d[0] * e2[2], d[0] * e2[1] - d[1] * e2[0]};
+		const auto det = e1[0] * p[0] + e1[1] * p[1] + e1[2] * p[2];
+		if (std::fabs(det) < 1e-12f)
+			return false;
+
+		const auto invDet = 1.f / det;
+		const float s[3] = {ray.origin[0] - triangle.v0[0], ray.origin[1] - triangle.v0[1], ray.origin[2] - triangle.v0[2]};
+		u = (s[0] * p[0] + s[1] * p[1] + s[2] * p[2]) * invDet;
+		if (u < 0.f || u > 1.f)
+			return false;
+
+		const float q[3] = {s[1] * e1[2] - s[2] * e1[1], s[2] * e1[0] - s[0] * e1[2], s[0] * e1[1] - s[1] * e1[0]};
+		v = (d[0] * q[0] + d[1] * q[1] + d[2] * q[2]) * invDet;
+		if (v < 0.f || u + v > 1.f)
+			return false;
+
+		t = (e2[0] * q[0] + e2[1] * q[1] + e2[2] * q[2]) * invDet;
+		return t >= 0.f && t <= maxT;
+	}
+
+private:
+	std::vector<Triangle> m_triangles;
+	std::vector<uint32_t> m_triangleIds;
+	Bvh4 m_bvh;
+	Aabb m_bounds = Aabb::Empty();
+
+	// Build scratch, released once the tree is collapsed
+	std::vector<BuildNode> m_nodes;
+	std::vector<Aabb> m_triangleBounds;
+	std::vector<float> m_centroids;
+};
@@ -0,0 +1,486 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+#include "Aabb.h"
+#include "Simd.h"
+#include "ThreadPool.h"
+
+// World space axis aligned box of an object tested against the occluders
+using OcclusionBounds = Aabb;
+
+struct OcclusionStats
+{
+	size_t occluderTriangles = 0;
+	size_t rasterizedTriangles = 0;
+	size_t testedObjects = 0;
+	size_t occludedObjects = 0;
+	size_t offscreenObjects = 0;
+};
+
+// CPU occlusion culling against a low resolution depth buffer
+// Occluder triangles are rasterized at pixel centres into a nearest-depth buffer, every 8x4 tile
+// also keeps its farthest depth (HiZ). An object is occluded when the nearest depth of its screen
+// bounds lies behind the farthest occluder depth of every tile, or failing that every pixel, it covers.
+// Matrices are row-major and use the DirectXMath row vector convention (clip = position * matrix),
+// so an XMFLOAT4X4 can be passed as &matrix._11. Depth follows D3D, 0 is near and 1 is far.
+// Pixels only partially covered by an occluder stay empty, so the test never hides a visible object
+// except through the pixel centre depth approximation.
+struct OcclusionCuller
+{
+	enum : uint32_t
+	{
+		TileWidth = 8,
+		TileHeight = 4
+	};
+
+	explicit OcclusionCuller(const uint32_t width = 320, const uint32_t height = 192,
+	                         ThreadPool& pool = ThreadPool::GetDefault())
+		: m_width((width + TileWidth - 1) / TileWidth * TileWidth),
+		  m_height((height + TileHeight - 1) / TileHeight * TileHeight),
+		  m_tilesX(m_width / TileWidth), m_tilesY(m_height / TileHeight),
+		  m_depth(size_t{m_width} * m_height, 1.f),
+		  m_hiz(size_t{m_tilesX} * m_tilesY, 1.f),
+		  m_pool(pool)
+	{
+	}
+
+	// Clears the buffers and starts collecting occluders for a new view
+	void BeginFrame(const float* viewProjection)
+	{
+		std::copy(viewProjection, viewProjection + 16, m_viewProjection);
+		std::fill(m_depth.begin(), m_depth.end(), 1.f);
+		std::fill(m_hiz.begin(), m_hiz.end(), 1.f);
+		m_occluders.clear();
+		m_stats = OcclusionStats{};
+	}
+
+	// Queues an occluder mesh, the data is read in RenderOccluders and must stay alive until then
+	// positions points at the first float3 of a vertex, stride is the vertex size in bytes, which matches
+	// the vertex and index data handed to Buffer::CreateVertexBuffer/CreateIndexBuffer
+	// Closed meshes should leave twoSided off, clockwise (D3D front facing) triangles are enough
+	void AddOccluder(const float* positions, const size_t stride, const size_t vertexCount,
+	                 const uint32_t* indices, const size_t indexCount, const float* world, const bool twoSided = false)
+	{
+		Occluder occluder{};
+		occluder.positions = reinterpret_cast<const uint8_t*>(positions);
+		occluder.stride = stride;
+		occluder.vertexCount = vertexCount;
+		occluder.indices = indices;
+		occluder.triangleCount = indexCount / 3;
+		occluder.twoSided = twoSided;
+		Multiply(world, m_viewProjection, occluder.worldViewProjection);
+		m_occluders.push_back(occluder);
+		m_stats.occluderTriangles += occluder.triangleCount;
+	}
+
+	// Sets up every queued triangle, then rasterizes the screen in bands of tile rows on the pool
+	void RenderOccluders()
+	{
+		size_t triangleCount = 0;
+		for (auto& occluder : m_occluders)
+		{
+			occluder.firstTriangle = triangleCount;
+			triangleCount += occluder.triangleCount;
+		}
+		m_triangles.resize(triangleCount);
+
+		m_pool.ParallelFor(m_occluders.size(), 1, [this](const size_t begin, const size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+				SetupOccluder(m_occluders[i]);
+		});
+
+		// Drop culled and degenerate triangles so the bands only walk live ones
+		const auto live = std::remove_if(m_triangles.begin(), m_triangles.end(),
+		                                 [](const Triangle& triangle) { return triangle.minY > triangle.maxY; });
+		m_triangles.erase(live, m_triangles.end());
+		m_stats.rasterizedTriangles = m_triangles.size();
+
+		const auto avx2 = Simd::HasAvx2();
+		m_pool.ParallelFor(m_tilesY, 2, [this, avx2](const size_t begin, const size_t end)
+		{
+			const auto bandMinY = static_cast<int>(begin * TileHeight);
+			const auto bandMaxY = static_cast<int>(end * TileHeight) - 1;
+			for (const auto& triangle : m_triangles)
+			{
+				const auto minY = std::max(triangle.minY, bandMinY);
+				const auto maxY = std::min(triangle.maxY, bandMaxY);
+				if (minY > maxY)
+					continue;
+#if XT_SIMD_X86
+				if (avx2)
+				{
+					RasterizeAvx2(triangle, minY, maxY);
+					continue;
+				}
+#endif
+				RasterizeScalar(triangle, minY, maxY);
+			}
+			BuildHiZ(begin, end);
+		});
+	}
+
+	// Tests world space boxes, visible[i] is set to 0 for occluded or offscreen objects and 1 otherwise
+	void TestVisibility(const OcclusionBounds* bounds, const size_t count, uint8_t* visible)
+	{
+		std::atomic<size_t> occluded{0};
+		std::atomic<size_t> offscreen{0};
+		m_pool.ParallelFor(count, 256, [&](const size_t begin, const size_t end)
+		{
+			size_t localOccluded = 0, localOffscreen = 0;
+			for (auto i = begin; i < end; ++i)
+			{
+				const auto result = Test(bounds[i]);
+				visible[i] = result == Result::Visible ? 1 : 0;
+				localOccluded += result == Result::Occluded ? 1 : 0;
+				localOffscreen += result == Result::Offscreen ? 1 : 0;
+			}
+			occluded += localOccluded;
+			offscreen += localOffscreen;
+		});
+		m_stats.testedObjects += count;
+		m_stats.occludedObjects += occluded;
+		m_stats.offscreenObjects += offscreen;
+	}
+
+	bool IsVisible(const OcclusionBounds& bounds) const
+	{
+		return Test(bounds) == Result::Visible;
+	}
+
+	const OcclusionStats& GetStats() const { return m_stats; }
+	uint32_t GetWidth() const { return m_width; }
+	uint32_t GetHeight() const { return m_height; }
+	const std::vector<float>& GetDepthBuffer() const { return m_depth; }
+
+private:
+	enum class Result
+	{
+		Visible,
+		Occluded,
+		Offscreen
+	};
+
+	struct Occluder
+	{
+		const uint8_t* positions;
+		size_t stride;
+		size_t vertexCount;
+		const uint32_t* indices;
+		size_t triangleCount;
+		size_t firstTriangle;
+		bool twoSided;
+		float worldViewProjection[16];
+	};
+
+	// Edge functions e = a * x + b * y + c are >= 0 inside, depth is the plane z = za * x + zb * y + zc
+	struct Triangle
+	{
+		float edgeA[3], edgeB[3], edgeC[3];
+		float edgeInvA[3];
+		float za, zb, zc;
+		int minX, maxX, minY, maxY;
+	};
+
+	struct ScreenVertex
+	{
+		float x, y, z, w;
+	};
+
+	static void Multiply(const float* a, const float* b, float* out)
+	{
+		for (auto r = 0; r < 4; ++r)
+			for (auto c = 0; c < 4; ++c)
+				out[r * 4 + c] = a[r * 4] * b[c] + a[r * 4 + 1] * b[4 + c] + a[r * 4 + 2] * b[8 + c] + a[r * 4 + 3] * b[12 + c];
+	}
+
+	static ScreenVertex Transform(const float* p, const float* m)
+	{
+		return ScreenVertex{
+			p[0] * m[0] + p[1] * m[4] + p[2] * m[8] + m[12],
+			p[0] * m[1] + p[1] * m[5] + p[2] * m[9] + m[13],
+			p[0] * m[2] + p[1] * m[6] + p[2] * m[10] + m[14],
+			p[0] * m[3] + p[1] * m[7] + p[2] * m[11] + m[15]
+		};
+	}
+
+	// Clip space to pixel coordinates, y points down
+	ScreenVertex ToScreen(const ScreenVertex& clip) const
+	{
+		const auto invW = 1.f / clip.w;
+		return ScreenVertex{
+			(clip.x * invW * 0.5f + 0.5f) * m_width,
+			(0.5f - clip.y * invW * 0.5f) * m_height,
+			clip.z * invW,
+			clip.w
+		};
+	}
+
+	// Clamped to [-1, size] before the cast, geometry far off screen is billions of pixels out and overflows an int
+	static int ToPixel(const float value, const uint32_t size)
+	{
+		return static_cast<int>(std::min(static_cast<float>(size), std::max(-1.f, value)));
+	}
+
+	void SetupOccluder(const Occluder& occluder)
+	{
+		// Shared vertices are transformed once, w < 0 marks vertices in front of the near plane
+		thread_local std::vector<ScreenVertex> screen;
+		screen.resize(occluder.vertexCount);
+		for (size_t i = 0; i < occluder.vertexCount; ++i)
+		{
+			const auto position = reinterpret_cast<const float*>(occluder.positions + i * occluder.stride);
+			const auto clip = Transform(position, occluder.worldViewProjection);
+			screen[i] = clip.w <= 1e-5f || clip.z < 0.f ? ScreenVertex{0.f, 0.f, 0.f, -1.f} : ToScreen(clip);
+		}
+
+		for (size_t t = 0; t < occluder.triangleCount; ++t)
+		{
+			auto& triangle = m_triangles[occluder.firstTriangle + t];
+			triangle.minY = 1;
+			triangle.maxY = 0;
+
+			ScreenVertex v[3];
+			for (auto i = 0; i < 3; ++i)
+				v[i] = screen[occluder.indices[t * 3 + i]];
+			// Triangles crossing the near plane are skipped, losing an occluder is always safe
+			if (v[0].w < 0.f || v[1].w < 0.f || v[2].w < 0.f)
+				continue;
+
+			// Clockwise on screen is a positive area here because pixel y points down,
+			// back faces are flipped for two sided occluders and dropped otherwise
+			auto area = (v[1].x - v[0].x) * (v[2].y - v[0].y) - (v[1].y - v[0].y) * (v[2].x - v[0].x);
+			if (std::fabs(area) < 1e-8f || (area < 0.f && !occluder.twoSided))
+				continue;
+			if (area < 0.f)
+			{
+				std::swap(v[1], v[2]);
+				area = -area;
+			}
+
+			const auto minX = std::min({v[0].x, v[1].x, v[2].x});
+			const auto maxX = std::max({v[0].x, v[1].x, v[2].x});
+			const auto minY = std::min({v[0].y, v[1].y, v[2].y});
+			const auto maxY = std::max({v[0].y, v[1].y, v[2].y});
+
+			// Pixel centres sit at +0.5, only pixels whose centre can be inside are walked
+			triangle.minX = std::max(0, ToPixel(std::ceil(minX - 0.5f), m_width));
+			triangle.maxX = std::min(static_cast<int>(m_width) - 1, ToPixel(std::floor(maxX - 0.5f), m_width));
+			triangle.minY = std::max(0, ToPixel(std::ceil(minY - 0.5f), m_height));
+			triangle.maxY = std::min(static_cast<int>(m_height) - 1, ToPixel(std::floor(maxY - 0.5f), m_height));
+			if (triangle.minX > triangle.maxX)
+			{
+				triangle.minY = 1;
+				triangle.maxY = 0;
+				continue;
+			}
+
+			for (auto e = 0; e < 3; ++e)
+			{
+				const auto& a = v[e];
+				const auto& b = v[(e + 1) % 3];
+				triangle.edgeA[e] = -(b.y - a.y);
+				triangle.edgeB[e] = b.x - a.x;
+				triangle.edgeC[e] = (b.y - a.y) * a.x - (b.x - a.x) * a.y;
+				triangle.edgeInvA[e] = triangle.edgeA[e] != 0.f ? 1.f / triangle.edgeA[e] : 0.f;
+			}
+
+			const auto dz1 = v[1].z - v[0].z;
+			const auto dz2 = v[2].z - v[0].z;
+			const auto dx1 = v[1].x - v[0].x, dy1 = v[1].y - v[0].y;
+			const auto dx2 = v[2].x - v[0].x, dy2 = v[2].y - v[0].y;
+			triangle.za = (dz1 * dy2 - dz2 * dy1) / area;
+			triangle.zb = (dz2 * dx1 - dz1 * dx2) / area;
+			triangle.zc = v[0].z - triangle.za * v[0].x - triangle.zb * v[0].y;
+		}
+	}
+
+	// Pixel range of a row that can be inside, solved from each edge and padded by one pixel
+	// since the edge test itself decides the boundary pixels
+	static bool RowSpan(const Triangle& triangle, const float py, int& spanMin, int& spanMax)
+	{
+		auto left = static_cast<float>(triangle.minX);
+		auto right = static_cast<float>(triangle.maxX);
+		for (auto e = 0; e < 3; ++e)
+		{
+			const auto a = triangle.edgeA[e];
+			const auto rowC = triangle.edgeB[e] * py + triangle.edgeC[e];
+			if (a > 0.f)
+				left = std::max(left, -rowC * triangle.edgeInvA[e] - 1.5f);
+			else if (a < 0.f)
+				right = std::min(right, -rowC * triangle.edgeInvA[e] + 0.5f);
+			else if (rowC < 0.f)
+				return false;
+		}
+		// left starts at minX and right at maxX, so once they are ordered both lie within the triangle's pixels
+		if (!(left <= right))
+			return false;
+		spanMin = static_cast<int>(std::ceil(left));
+		spanMax = static_cast<int>(std::floor(right));
+		return spanMin <= spanMax;
+	}
+
+	void RasterizeScalar(const Triangle& triangle, const int minY, const int maxY)
+	{
+		for (auto y = minY; y <= maxY; ++y)
+		{
+			const auto py = y + 0.5f;
+			int spanMin, spanMax;
+			if (!RowSpan(triangle, py, spanMin, spanMax))
+				continue;
+
+			auto row = m_depth.data() + size_t(y) * m_width;
+			for (auto x = spanMin; x <= spanMax; ++x)
+			{
+				const auto px = x + 0.5f;
+				auto inside = true;
+				for (auto e = 0; e < 3; ++e)
+					inside = inside && triangle.edgeA[e] * px + (triangle.edgeB[e] * py + triangle.edgeC[e]) >= 0.f;
+				if (!inside)
+					continue;
+				const auto z = triangle.za * px + (triangle.zb * py + triangle.zc);
+				row[x] = std::min(row[x], z);
+			}
+		}
+	}
+
+#if XT_SIMD_X86
+	// Walks 8 pixel spans aligned to the buffer, the span mask covers partial spans at the edges
+	XT_TARGET_AVX2 void RasterizeAvx2(const Triangle& triangle, const int minY, const int maxY)
+	{
+		const auto lane = _mm256_setr_ps(0.5f, 1.5f, 2.5f, 3.5f, 4.5f, 5.5f, 6.5f, 7.5f);
+		const auto laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+		__m256 edgeA[3];
+		for (auto e = 0; e < 3; ++e)
+			edgeA[e] = _mm256_set1_ps(triangle.edgeA[e]);
+		const auto za = _mm256_set1_ps(triangle.za);
+
+		for (auto y = minY; y <= maxY; ++y)
+		{
+			const auto py = y + 0.5f;
+			int spanMin, spanMax;
+			if (!RowSpan(triangle, py, spanMin, spanMax))
+				continue;
+
+			__m256 rowC[3];
+			for (auto e = 0; e < 3; ++e)
+				rowC[e] = _mm256_set1_ps(triangle.edgeB[e] * py + triangle.edgeC[e]);
+			const auto rowZ = _mm256_set1_ps(triangle.zb * py + triangle.zc);
+
+			auto row = m_depth.data() + size_t(y) * m_width;
+			for (auto x = spanMin & ~7; x <= spanMax; x += 8)
+			{
+				const auto px = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(x)), lane);
+				const auto index = _mm256_add_epi32(_mm256_set1_epi32(x), laneIndex);
+				const auto span = _mm256_and_si256(_mm256_cmpgt_epi32(index, _mm256_set1_epi32(spanMin - 1)),
+				                                   _mm256_cmpgt_epi32(_mm256_set1_epi32(spanMax + 1), index));
+
+				auto mask = _mm256_castsi256_ps(span);
+				for (auto e = 0; e < 3; ++e)
+				{
+					const auto edge = _mm256_add_ps(_mm256_mul_ps(edgeA[e], px), rowC[e]);
+					mask = _mm256_and_ps(mask, _mm256_cmp_ps(edge, _mm256_setzero_ps(), _CMP_GE_OQ));
+				}
+				if (_mm256_testz_ps(mask, mask))
+					continue;
+
+				const auto z = _mm256_add_ps(_mm256_mul_ps(za, px), rowZ);
+				const auto depth = _mm256_loadu_ps(row + x);
+				_mm256_storeu_ps(row + x, _mm256_blendv_ps(depth, _mm256_min_ps(depth, z), mask));
+			}
+		}
+	}
+#endif
+
+	void BuildHiZ(const size_t tileRowBegin, const size_t tileRowEnd)
+	{
+		for (auto ty = tileRowBegin; ty < tileRowEnd; ++ty)
+		{
+			for (uint32_t tx = 0; tx < m_tilesX; ++tx)
+			{
+				auto farthest = 0.f;
+				for (uint32_t y = 0; y < TileHeight; ++y)
+				{
+					const auto row = m_depth.data() + (ty * TileHeight + y) * m_width + tx * TileWidth;
+					for (uint32_t x = 0; x < TileWidth; ++x)
+						farthest = std::max(farthest, row[x]);
+				}
+				m_hiz[ty * m_tilesX + tx] = farthest;
+			}
+		}
+	}
+
+	Result Test(const OcclusionBounds& bounds) const
+	{
+		auto minX = 1e30f, minY = 1e30f, maxX = -1e30f, maxY = -1e30f, nearest = 1e30f;
+		for (auto corner = 0; corner < 8; ++corner)
+		{
+			const float p[3] = {
+				corner & 1 ? bounds.max[0] : bounds.min[0],
+				corner & 2 ? bounds.max[1] : bounds.min[1],
+				corner & 4 ? bounds.max[2] : bounds.min[2]
+			};
+			const auto clip = Transform(p, m_viewProjection);
+			// Boxes reaching the camera plane cannot be tested reliably
+			if (clip.w <= 1e-5f || clip.z < 0.f)
+				return Result::Visible;
+			const auto screen = ToScreen(clip);
+			minX = std::min(minX, screen.x);
+			maxX = std::max(maxX, screen.x);
+			minY = std::min(minY, screen.y);
+			maxY = std::max(maxY, screen.y);
+			nearest = std::min(nearest, screen.z);
+		}
+
+		if (maxX < 0.f || maxY < 0.f || minX > m_width || minY > m_height || nearest > 1.f)
+			return Result::Offscreen;
+
+		// Every pixel the box touches, not only centres, so the test stays conservative
+		const auto x0 = std::max(0, ToPixel(std::floor(minX), m_width));
+		const auto x1 = std::min(static_cast<int>(m_width) - 1, ToPixel(std::floor(maxX), m_width));
+		const auto y0 = std::max(0, ToPixel(std::floor(minY), m_height));
+		const auto y1 = std::min(static_cast<int>(m_height) - 1, ToPixel(std::floor(maxY), m_height));
+
+		for (auto ty = y0 / static_cast<int>(TileHeight); ty <= y1 / static_cast<int>(TileHeight); ++ty)
+		{
+			for (auto tx = x0 / static_cast<int>(TileWidth); tx <= x1 / static_cast<int>(TileWidth); ++tx)
+			{
+				if (nearest > m_hiz[ty * m_tilesX + tx])
+					continue;
+
+				// The tile as a whole is not behind, check the covered pixels one by one
+				const auto px0 = std::max(x0, tx * static_cast<int>(TileWidth));
+				const auto px1 = std::min(x1, (tx + 1) * static_cast<int>(TileWidth) - 1);
+				const auto py0 = std::max(y0, ty * static_cast<int>(TileHeight));
+				const auto py1 = std::min(y1, (ty + 1) * static_cast<int>(TileHeight) - 1);
+				for (auto y = py0; y <= py1; ++y)
+				{
+					const auto row = m_depth.data() + size_t(y) * m_width;
+					for (auto x = px0; x <= px1; ++x)
+						if (nearest <= row[x])
+							return Result::Visible;
+				}
+			}
+		}
+		return Result::Occluded;
+	}
+
+private:
+	uint32_t m_width;
+	uint32_t m_height;
+	uint32_t m_tilesX;
+	uint32_t m_tilesY;
+	std::vector<float> m_depth;
+	std::vector<float> m_hiz;
+	float m_viewProjection[16] = {};
+	std::vector<Occluder> m_occluders;
+	std::vector<Triangle> m_triangles;
+	OcclusionStats m_stats;
+	ThreadPool& m_pool;
+};
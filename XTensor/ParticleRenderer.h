@@ -0,0 +1,136 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Device.h"
+#include "Buffer.h"
+#include "Renderer.h"
+#include "ParticleSystem.h"
+
+// Draws a ParticleSystem from one dynamic vertex buffer, one instanced draw per emitter.
+// Every frame Upload maps the buffer once and the emitters write their ranges in parallel.
+// Draw it with ParticleVertexShader.hlsl, PixelShader.hlsl and an input layout made from GetInputElements().
+struct ParticleRenderer
+{
+	struct CBParticles
+	{
+		Float4x4 view;
+		Float4x4 projection;
+	};
+
+	ParticleRenderer(const Device& device, const size_t capacity)
+		: m_capacity(capacity)
+	{
+		m_vertexBuffer = Buffer::CreateDynamicVertexBuffer(device, static_cast<UINT>(capacity * sizeof(ParticleVertex)));
+		m_constBuffer = Buffer::CreateConstantBuffer(device, sizeof(CBParticles));
+
+		// Alpha blended without depth writes, the particles fade out over their lifetime
+		D3D11_BLEND_DESC blendDesc{};
+		blendDesc.RenderTarget[0].BlendEnable = TRUE;
+		blendDesc.RenderTarget[0].SrcBlend = D3D11_BLEND_SRC_ALPHA;
+		blendDesc.RenderTarget[0].DestBlend = D3D11_BLEND_INV_SRC_ALPHA;
+		blendDesc.RenderTarget[0].BlendOp = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].SrcBlendAlpha = D3D11_BLEND_ONE;
+		blendDesc.RenderTarget[0].DestBlendAlpha = D3D11_BLEND_ZERO;
+		blendDesc.RenderTarget[0].BlendOpAlpha = D3D11_BLEND_OP_ADD;
+		blendDesc.RenderTarget[0].RenderTargetWriteMask = D3D11_COLOR_WRITE_ENABLE_ALL;
+		device.GetDevice()->CreateBlendState(&blendDesc, m_blendState.GetAddressOf());
+
+		D3D11_DEPTH_STENCIL_DESC depthDesc{};
+		depthDesc.DepthEnable = TRUE;
+		depthDesc.DepthWriteMask = D3D11_DEPTH_WRITE_MASK_ZERO;
+		depthDesc.DepthFunc = D3D11_COMPARISON_LESS;
+		device.GetDevice()->CreateDepthStencilState(&depthDesc, m_depthState.GetAddressOf());
+	}
+
+	static std::vector<D3D11_INPUT_ELEMENT_DESC> GetInputElements()
+	{
+		return {
+			{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+			{"SIZE", 0, DXGI_FORMAT_R32_FLOAT, 0, 12, D3D11_INPUT_PER_INSTANCE_DATA, 1},
+			{"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 16, D3D11_INPUT_PER_INSTANCE_DATA, 1}
+		};
+	}
+
+	void Destroy(const ComPtr<ID3D11DeviceContext>& context)
+	{
+		Buffer::DeleteBuffer(context, m_vertexBuffer);
+		Buffer::DeleteBuffer(context, m_constBuffer);
+		m_blendState.Reset();
+		m_depthState.Reset();
+	}
+
+	// Particles past the buffer capacity are dropped, later emitters first
+	void Upload(const Device& device, const ParticleSystem& system)
+	{
+		m_draws.clear();
+		size_t start = 0;
+		for (size_t i = 0; i < system.GetEmitterCount(); ++i)
+		{
+			const auto count = std::min(system.GetEmitter(i).GetCount(), m_capacity - start);
+			m_draws.push_back(Draw{start, count});
+			start += count;
+		}
+
+		const auto& context = device.GetDeviceContext();
+		D3D11_MAPPED_SUBRESOURCE mapped{};
+		if (FAILED(context->Map(Buffer::GetBuffer(m_vertexBuffer), 0, D3D11_MAP_WRITE_DISCARD, 0, &mapped)))
+		{
+			m_draws.clear();
+			return;
+		}
+
+		auto* vertices = static_cast<ParticleVertex*>(mapped.pData);
+		system.GetPool().ParallelFor(m_draws.size(), 1, [&](const size_t begin, const size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+				system.GetEmitter(i).WriteVertices(vertices + m_draws[i].start, m_draws[i].count);
+		});
+
+		context->Unmap(Buffer::GetBuffer(m_vertexBuffer), 0);
+	}
+
+	// Quads face the camera, so the view and projection are passed separately, transposed for HLSL like WVP
+	void Update(const Device& device, const Float4x4& view, const Float4x4& projection)
+	{
+		m_cbParticles.view = VectorMath::Transpose(view);
+		m_cbParticles.projection = VectorMath::Transpose(projection);
+		device.GetDeviceContext()->UpdateSubresource(Buffer::GetBuffer(m_constBuffer), 0, nullptr, &m_cbParticles, 0, 0);
+	}
+
+	// Binds its buffers to fixed slots like SkinnedMesh and restores the default blend, depth and topology state
+	void Render(const Renderer& renderer) const
+	{
+		const auto& context = renderer.GetDeviceContext();
+		Buffer::BindVertexBuffer(context, m_vertexBuffer, 0, sizeof(ParticleVertex));
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLESTRIP);
+		Buffer::BindConstantBuffer(context, m_constBuffer, 0);
+		context->OMSetBlendState(m_blendState.Get(), nullptr, 0xffffffff);
+		context->OMSetDepthStencilState(m_depthState.Get(), 0);
+
+		for (const auto& draw : m_draws)
+			if (draw.count > 0)
+				context->DrawInstanced(4, static_cast<UINT>(draw.count), 0, static_cast<UINT>(draw.start));
+
+		context->OMSetBlendState(nullptr, nullptr, 0xffffffff);
+		context->OMSetDepthStencilState(nullptr, 0);
+		context->IASetPrimitiveTopology(D3D11_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	}
+
+	size_t GetCapacity() const { return m_capacity; }
+
+private:
+	struct Draw
+	{
+		size_t start;
+		size_t count;
+	};
+
+	CBParticles m_cbParticles{};
+	std::vector<Draw> m_draws;
+	size_t m_capacity;
+
+	BufferId m_vertexBuffer;
+	BufferId m_constBuffer;
+	ComPtr<ID3D11BlendState> m_blendState;
+	ComPtr<ID3D11DepthStencilState> m_depthState;
+};
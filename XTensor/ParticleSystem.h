@@ -0,0 +1,317 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <vector>
+
+#include "Simd.h"
+#include "ThreadPool.h"
+#include "VectorMath.h"
+
+struct ParticleEmitterDesc
+{
+	Float3 position{0.f, 0.f, 0.f};
+	// Spawn positions are jittered by up to radius along each axis
+	float radius = 0.f;
+	Float3 velocity{0.f, 1.f, 0.f};
+	// Spawn velocities are jittered by up to spread along each axis
+	float spread = 0.5f;
+	Float3 acceleration{0.f, -9.81f, 0.f};
+	// Fraction of the velocity kept per second
+	float drag = 1.f;
+	float minLifetime = 1.f;
+	float maxLifetime = 2.f;
+	// Particles per second
+	float rate = 100.f;
+	float size = 0.05f;
+	Float4 color{1.f, 1.f, 1.f, 1.f};
+	size_t capacity = 1024;
+	uint32_t seed = 1;
+};
+
+// One particle as the particle vertex shader reads it, per instance
+struct ParticleVertex
+{
+	float position[3];
+	float size;
+	// The emitter color, alpha fades with the remaining lifetime
+	float color[4];
+};
+
+// Particles of one emitter in SoA arrays, live ones packed at the front.
+// Update integrates and drops dead particles in one pass. Survivors are moved down without branching,
+// the AVX2 path packs each group of eight with a permutation looked up from the alive mask.
+struct ParticleEmitter
+{
+	explicit ParticleEmitter(const ParticleEmitterDesc& desc)
+		: m_desc(desc), m_capacity((desc.capacity + 7) / 8 * 8), m_random(desc.seed ? desc.seed : 1)
+	{
+		// Every array is padded to a multiple of eight so whole registers can be loaded past the end
+		m_data = static_cast<float*>(Simd::AlignedAlloc(std::max<size_t>(m_capacity, 8) * ArrayCount * sizeof(float), 64));
+		if (!m_data)
+			throw std::bad_alloc{};
+		std::fill(m_data, m_data + std::max<size_t>(m_capacity, 8) * ArrayCount, 0.f);
+	}
+
+	~ParticleEmitter() { Simd::AlignedFree(m_data); }
+
+	ParticleEmitter(const ParticleEmitter&) = delete;
+	ParticleEmitter& operator=(const ParticleEmitter&) = delete;
+
+	// Advances the live particles by dt seconds, then spawns the ones due at the emitter's rate
+	void Update(const float dt)
+	{
+		Simulate(dt);
+
+		m_spawnDebt += m_desc.rate * dt;
+		const auto due = static_cast<size_t>(m_spawnDebt);
+		m_spawnDebt -= static_cast<float>(due);
+		Spawn(due);
+	}
+
+	// Adds up to count particles, fewer when the emitter is full
+	void Spawn(const size_t count)
+	{
+		const auto end = std::min(m_count + count, m_capacity);
+		const auto& d = m_desc;
+		for (auto i = m_count; i < end; ++i)
+		{
+			X()[i] = d.position.x + d.radius * RandomSigned();
+			Y()[i] = d.position.y + d.radius * RandomSigned();
+			Z()[i] = d.position.z + d.radius * RandomSigned();
+			VelocityX()[i] = d.velocity.x + d.spread * RandomSigned();
+			VelocityY()[i] = d.velocity.y + d.spread * RandomSigned();
+			VelocityZ()[i] = d.velocity.z + d.spread * RandomSigned();
+			const auto lifetime = d.minLifetime + (d.maxLifetime - d.minLifetime) * RandomUnit();
+			Life()[i] = lifetime;
+			Fade()[i] = 1.f / lifetime;
+		}
+		m_count = end;
+	}
+
+	// Writes up to capacity live particles in order and returns how many were written.
+	// Meant for a mapped dynamic vertex buffer, so every vertex is written once front to back.
+	size_t WriteVertices(ParticleVertex* out, const size_t capacity) const
+	{
+		const auto& color = m_desc.color;
+		const auto count = std::min(m_count, capacity);
+		for (size_t i = 0; i < count; ++i)
+		{
+			ParticleVertex vertex;
+			vertex.position[0] = X()[i];
+			vertex.position[1] = Y()[i];
+			vertex.position[2] = Z()[i];
+			vertex.size = m_desc.size;
+			vertex.color[0] = color.x;
+			vertex.color[1] = color.y;
+			vertex.color[2] = color.z;
+			vertex.color[3] = color.w * std::min(Life()[i] * Fade()[i], 1.f);
+			out[i] = vertex;
+		}
+		return count;
+	}
+
+	void Clear() { m_count = 0; }
+
+	size_t GetCount() const { return m_count; }
+	size_t GetCapacity() const { return m_capacity; }
+	const ParticleEmitterDesc& GetDesc() const { return m_desc; }
+
+	// SoA views of the live particles
+	const float* GetPositionX() const { return X(); }
+	const float* GetPositionY() const { return Y(); }
+	const float* GetPositionZ() const { return Z(); }
+	const float* GetLife() const { return Life(); }
+
+private:
+	enum : size_t
+	{
+		ArrayCount = 8
+	};
+
+	float* Array(const size_t index) const { return m_data + index * std::max<size_t>(m_capacity, 8); }
+	float* X() const { return Array(0); }
+	float* Y() const { return Array(1); }
+	float* Z() const { return Array(2); }
+	float* VelocityX() const { return Array(3); }
+	float* VelocityY() const { return Array(4); }
+	float* VelocityZ() const { return Array(5); }
+	float* Life() const { return Array(6); }
+	float* Fade() const { return Array(7); }
+
+	// v' = v * drag^dt + a * dt, p' = p + v' * dt, then every particle with life left moves down to the next free slot
+	void Simulate(const float dt)
+	{
+		const auto drag = std::pow(m_desc.drag, dt);
+#if XT_SIMD_X86
+		if (Simd::HasAvx2())
+		{
+			m_count = SimulateAvx2(dt, drag);
+			return;
+		}
+#endif
+		const auto ax = m_desc.acceleration.x * dt, ay = m_desc.acceleration.y * dt, az = m_desc.acceleration.z * dt;
+		float* arrays[ArrayCount];
+		for (size_t a = 0; a < ArrayCount; ++a)
+			arrays[a] = Array(a);
+
+		size_t alive = 0;
+		for (size_t i = 0; i < m_count; ++i)
+		{
+			const auto vx = arrays[3][i] * drag + ax;
+			const auto vy = arrays[4][i] * drag + ay;
+			const auto vz = arrays[5][i] * drag + az;
+			const auto life = arrays[6][i] - dt;
+			const auto fade = arrays[7][i];
+			arrays[0][alive] = arrays[0][i] + vx * dt;
+			arrays[1][alive] = arrays[1][i] + vy * dt;
+			arrays[2][alive] = arrays[2][i] + vz * dt;
+			arrays[3][alive] = vx;
+			arrays[4][alive] = vy;
+			arrays[5][alive] = vz;
+			arrays[6][alive] = life;
+			arrays[7][alive] = fade;
+			alive += life > 0.f ? 1 : 0;
+		}
+		m_count = alive;
+	}
+
+#if XT_SIMD_X86
+	// Lane indices of the set bits of each 8-bit mask, packed to the front, and the number of set bits
+	struct CompactTable
+	{
+		uint8_t lanes[256][8];
+		uint8_t counts[256];
+
+		CompactTable()
+		{
+			for (auto mask = 0; mask < 256; ++mask)
+			{
+				uint8_t count = 0;
+				for (uint8_t lane = 0; lane < 8; ++lane)
+					if (mask & (1 << lane))
+						lanes[mask][count++] = lane;
+				for (auto lane = count; lane < 8; ++lane)
+					lanes[mask][lane] = 0;
+				counts[mask] = count;
+			}
+		}
+	};
+
+	static const CompactTable& GetCompactTable()
+	{
+		static const CompactTable table;
+		return table;
+	}
+
+	// Stores of a packed group may run up to seven lanes past the survivors, which only touches slots
+	// that were already read, at worst those of the group in flight.
+	// Multiply and add stay separate in the scalar loop's order, so the result matches it bit for bit.
+	XT_TARGET_AVX2_NOFMA size_t SimulateAvx2(const float dt, const float drag)
+	{
+		const auto& table = GetCompactTable();
+		const auto vdt = _mm256_set1_ps(dt);
+		const auto vdrag = _mm256_set1_ps(drag);
+		const auto ax = _mm256_set1_ps(m_desc.acceleration.x * dt);
+		const auto ay = _mm256_set1_ps(m_desc.acceleration.y * dt);
+		const auto az = _mm256_set1_ps(m_desc.acceleration.z * dt);
+		const auto zero = _mm256_setzero_ps();
+		const auto laneIndex = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+		const auto count = _mm256_set1_epi32(static_cast<int>(m_count));
+
+		float* arrays[ArrayCount];
+		for (size_t a = 0; a < ArrayCount; ++a)
+			arrays[a] = Array(a);
+
+		size_t alive = 0;
+		for (size_t i = 0; i < m_count; i += 8)
+		{
+			const auto vx = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(arrays[3] + i), vdrag), ax);
+			const auto vy = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(arrays[4] + i), vdrag), ay);
+			const auto vz = _mm256_add_ps(_mm256_mul_ps(_mm256_load_ps(arrays[5] + i), vdrag), az);
+			const auto life = _mm256_sub_ps(_mm256_load_ps(arrays[6] + i), vdt);
+			__m256 values[ArrayCount] = {
+				_mm256_add_ps(_mm256_load_ps(arrays[0] + i), _mm256_mul_ps(vx, vdt)),
+				_mm256_add_ps(_mm256_load_ps(arrays[1] + i), _mm256_mul_ps(vy, vdt)),
+				_mm256_add_ps(_mm256_load_ps(arrays[2] + i), _mm256_mul_ps(vz, vdt)),
+				vx, vy, vz, life,
+				_mm256_load_ps(arrays[7] + i)
+			};
+
+			// Lanes past the last particle of a partial group count as dead
+			const auto inRange = _mm256_cmpgt_epi32(count, _mm256_add_epi32(laneIndex, _mm256_set1_epi32(static_cast<int>(i))));
+			const auto live = _mm256_and_ps(_mm256_cmp_ps(life, zero, _CMP_GT_OQ), _mm256_castsi256_ps(inRange));
+			const auto mask = _mm256_movemask_ps(live);
+
+			const auto permutation = _mm256_cvtepu8_epi32(_mm_loadl_epi64(reinterpret_cast<const __m128i*>(table.lanes[mask])));
+			for (size_t a = 0; a < ArrayCount; ++a)
+				_mm256_storeu_ps(arrays[a] + alive, _mm256_permutevar8x32_ps(values[a], permutation));
+			alive += table.counts[mask];
+		}
+		return alive;
+	}
+#endif
+
+	// xorshift32, every emitter has its own so emitters can spawn on different threads
+	float RandomUnit()
+	{
+		m_random ^= m_random << 13;
+		m_random ^= m_random >> 17;
+		m_random ^= m_random << 5;
+		return static_cast<float>(m_random >> 8) * (1.f / 16777216.f);
+	}
+
+	float RandomSigned() { return RandomUnit() * 2.f - 1.f; }
+
+private:
+	ParticleEmitterDesc m_desc;
+	size_t m_capacity;
+	size_t m_count = 0;
+	float* m_data = nullptr;
+	float m_spawnDebt = 0.f;
+	uint32_t m_random;
+};
+
+// A set of emitters updated together, each emitter integrates and spawns on one pool thread
+struct ParticleSystem
+{
+	explicit ParticleSystem(ThreadPool& pool = ThreadPool::GetDefault())
+		: m_pool(pool)
+	{
+	}
+
+	ParticleEmitter& AddEmitter(const ParticleEmitterDesc& desc)
+	{
+		m_emitters.push_back(std::make_unique<ParticleEmitter>(desc));
+		return *m_emitters.back();
+	}
+
+	void Update(const float dt)
+	{
+		m_pool.ParallelFor(m_emitters.size(), 1, [this, dt](const size_t begin, const size_t end)
+		{
+			for (auto i = begin; i < end; ++i)
+				m_emitters[i]->Update(dt);
+		});
+	}
+
+	size_t GetParticleCount() const
+	{
+		size_t count = 0;
+		for (const auto& emitter : m_emitters)
+			count += emitter->GetCount();
+		return count;
+	}
+
+	size_t GetEmitterCount() const { return m_emitters.size(); }
+	const ParticleEmitter& GetEmitter(const size_t index) const { return *m_emitters[index]; }
+	ParticleEmitter& GetEmitter(const size_t index) { return *m_emitters[index]; }
+	ThreadPool& GetPool() const { return m_pool; }
+
+private:
+	std::vector<std::unique_ptr<ParticleEmitter>> m_emitters;
+	ThreadPool& m_pool;
+};
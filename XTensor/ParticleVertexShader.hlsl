@@ -0,0 +1,27 @@
+struct VS_OUTPUT
+{
+	float4 Position : SV_POSITION;
+	float4 Color : COLOR;
+};
+
+cbuffer CBParticles : register(b0)
+{
+	float4x4 View;
+	float4x4 Projection;
+};
+
+// One camera facing quad per instance, drawn as a 4 vertex triangle strip
+VS_OUTPUT main( float3 center : POSITION, float size : SIZE, float4 color : COLOR, uint vertexId : SV_VertexID )
+{
+	VS_OUTPUT output;
+
+	// Clockwise strip order, the default rasterizer state culls counter-clockwise triangles
+	float2 corner = float2(vertexId >> 1, vertexId & 1) * 2.f - 1.f;
+	float4 viewPosition = mul(float4(center, 1.f), View);
+	viewPosition.xy += corner * size;
+
+	output.Position = mul(viewPosition, Projection);
+	output.Color = color;
+
+	return output;
+}
\ No newline at end of file
@@ -53,9 +53,18 @@ struct Renderer
 		m_dsv.Reset();
 	}
 
-	auto GetRenderTargetView() const { return m_rtv; }
-	auto GetDepthStencilView() const { return m_dsv; }
-	auto GetDeviceContext() const { return m_context; }
+	ComPtr<ID3D11Texture2D> GetBackBuffer() const
+	{
+		ComPtr<ID3D11Resource> resource;
+		m_rtv->GetResource(resource.GetAddressOf());
+		ComPtr<ID3D11Texture2D> backBuffer;
+		resource.As(&backBuffer);
+		return backBuffer;
+	}
+
+	const auto& GetRenderTargetView() const { return m_rtv; }
+	const auto& GetDepthStencilView() const { return m_dsv; }
+	const auto& GetDeviceContext() const { return m_context; }
 
 private:
 	ComPtr<ID3D11RenderTargetView> m_rtv;
@@ -8,12 +8,12 @@ struct VertexShader
 {
 	VertexShader() = default;
 
-	static VertexShader CreateShader(const Device& device, std::wstring fileName, std::string version,
-	                                 std::vector<D3D_SHADER_MACRO> defines,
-	                                 std::vector<ID3DInclude> includes)
+	static VertexShader CreateShader(const Device& device, const std::wstring& fileName, const std::string& version,
+	                                 const std::vector<D3D_SHADER_MACRO>& defines,
+	                                 ID3DInclude* include)
 	{
 		VertexShader shader{};
-		D3DCompileFromFile(fileName.c_str(), defines.data(), includes.data(), "main", version.c_str(), 0, 0,
+		D3DCompileFromFile(fileName.c_str(), defines.data(), include, "main", version.c_str(), 0, 0,
 		                   shader.m_shaderBlob.GetAddressOf(), nullptr);
 		device.GetDevice()->CreateVertexShader(shader.m_shaderBlob->GetBufferPointer(), shader.m_shaderBlob->GetBufferSize(),
 		                                       nullptr,
@@ -35,6 +35,12 @@ struct VertexShader
 		return iaLayout;
 	}
 
+	// CreateShader binds the new shader, call this to switch back when several are in use
+	void Bind(const ComPtr<ID3D11DeviceContext>& context) const
+	{
+		context->VSSetShader(m_shader.Get(), nullptr, 0);
+	}
+
 	void Release()
 	{
 		m_shaderBlob.Reset();
@@ -50,12 +56,12 @@ struct PixelShader
 {
 	PixelShader() = default;
 
-	static PixelShader CreateShader(const Device& device, std::wstring fileName, std::string version,
-	                                std::vector<D3D_SHADER_MACRO> defines,
-	                                std::vector<ID3DInclude> includes)
+	static PixelShader CreateShader(const Device& device, const std::wstring& fileName, const std::string& version,
+	                                const std::vector<D3D_SHADER_MACRO>& defines,
+	                                ID3DInclude* include)
 	{
 		PixelShader shader{};
-		D3DCompileFromFile(fileName.c_str(), defines.data(), includes.data(), "main", version.c_str(), 0, 0,
+		D3DCompileFromFile(fileName.c_str(), defines.data(), include, "main", version.c_str(), 0, 0,
 		                   shader.m_shaderBlob.GetAddressOf(), nullptr);
 		device.GetDevice()->CreatePixelShader(shader.m_shaderBlob->GetBufferPointer(), shader.m_shaderBlob->GetBufferSize(),
 		                                      nullptr,
@@ -64,6 +70,12 @@ struct PixelShader
 		return shader;
 	}
 
+	// CreateShader binds the new shader, call this to switch back when several are in use
+	void Bind(const ComPtr<ID3D11DeviceContext>& context) const
+	{
+		context->PSSetShader(m_shader.Get(), nullptr, 0);
+	}
+
 	void Release()
 	{
 		m_shaderBlob.Reset();
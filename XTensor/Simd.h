@@ -0,0 +1,159 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdlib>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define XT_SIMD_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#else
+#include <cpuid.h>
+#endif
+#else
+#define XT_SIMD_X86 0
+#endif
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+// MSVC emits any intrinsic without /arch, GCC and Clang need the ISA enabled per function
+#if XT_SIMD_X86 && (defined(__GNUC__) || defined(__clang__))
+#define XT_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define XT_TARGET_AVX2 __attribute__((target("avx2,fma")))
+// Without FMA, so GCC cannot contract a multiply and an add whose rounding has to match the scalar path
+#define XT_TARGET_AVX2_NOFMA __attribute__((target("avx2")))
+#else
+#define XT_TARGET_SSE41
+#define XT_TARGET_AVX2
+#define XT_TARGET_AVX2_NOFMA
+#endif
+
+enum class SimdLevel
+{
+	Scalar = 0,
+	Sse41 = 1,
+	Avx2 = 2
+};
+
+struct Simd
+{
+	Simd() = delete;
+
+	static SimdLevel GetLevel()
+	{
+		return Override() < 0 ? Detected() : static_cast<SimdLevel>(Override());
+	}
+
+	// Caps the level used by every dispatching kernel, e.g. to compare paths
+	// Cannot raise the level above what the CPU supports
+	static void SetLevel(const SimdLevel level)
+	{
+		Override() = static_cast<int>(level < Detected() ? level : Detected());
+	}
+
+	static void ResetLevel() { Override() = -1; }
+
+	static bool HasSse41() { return GetLevel() >= SimdLevel::Sse41; }
+	static bool HasAvx2() { return GetLevel() >= SimdLevel::Avx2; }
+
+	// Index of the lowest set bit, mask must not be zero
+	static unsigned int LowestBit(const unsigned int mask)
+	{
+#if defined(_MSC_VER)
+		unsigned long index;
+		_BitScanForward(&index, mask);
+		return static_cast<unsigned int>(index);
+#else
+		return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+	}
+
+	static void* AlignedAlloc(const size_t bytes, const size_t alignment = 64)
+	{
+#if defined(_MSC_VER)
+		return _aligned_malloc(bytes, alignment);
+#else
+		void* ptr = nullptr;
+		if (posix_memalign(&ptr, alignment, bytes) != 0)
+			return nullptr;
+		return ptr;
+#endif
+	}
+
+	static void AlignedFree(void* ptr)
+	{
+#if defined(_MSC_VER)
+		_aligned_free(ptr);
+#else
+		free(ptr);
+#endif
+	}
+
+private:
+	static int& Override()
+	{
+		static int level = -1;
+		return level;
+	}
+
+	static SimdLevel Detected()
+	{
+		static const auto level = Detect();
+		return level;
+	}
+
+	static SimdLevel Detect()
+	{
+#if XT_SIMD_X86
+		unsigned int regs[4]{};
+		CpuId(1, 0, regs);
+		const auto sse41 = (regs[2] & (1u << 19)) != 0;
+		const auto fma = (regs[2] & (1u << 12)) != 0;
+		const auto osxsave = (regs[2] & (1u << 27)) != 0;
+		const auto avx = (regs[2] & (1u << 28)) != 0;
+
+		// The OS has to save the upper halves of the ymm registers on context switches
+		auto ymmState = false;
+		if (osxsave && avx)
+			ymmState = (ReadXcr0() & 0x6) == 0x6;
+
+		CpuId(7, 0, regs);
+		const auto avx2 = (regs[1] & (1u << 5)) != 0;
+
+		if (ymmState && avx2 && fma)
+			return SimdLevel::Avx2;
+		if (sse41)
+			return SimdLevel::Sse41;
+#endif
+		return SimdLevel::Scalar;
+	}
+
+#if XT_SIMD_X86
+	static void CpuId(const unsigned int leaf, const unsigned int subLeaf, unsigned int (&regs)[4])
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuidex(info, static_cast<int>(leaf), static_cast<int>(subLeaf));
+		for (auto i = 0; i < 4; ++i)
+			regs[i] = static_cast<unsigned int>(info[i]);
+#else
+		__cpuid_count(leaf, subLeaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+	}
+
+	static unsigned long long ReadXcr0()
+	{
+#if defined(_MSC_VER)
+		return _xgetbv(0);
+#else
+		unsigned int lo, hi;
+		__asm__ __volatile__("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+		return (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+	}
+#endif
+};
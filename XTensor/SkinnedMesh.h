@@ -0,0 +1,101 @@
+#pragma once
+
+#include "stdafx.h"
+#include "Device.h"
+#include "Buffer.h"
+#include "Renderer.h"
+#include "Animation.h"
+#include "Skinning.h"
+
+// Vertex of SkinnedVertexShader.hlsl, see SkinnedMesh::GetInputElements
+struct SkinnedVertex
+{
+	DirectX::XMFLOAT3 position;
+	DirectX::XMFLOAT4 color;
+	SkinInfluence skin;
+};
+
+static_assert(sizeof(SkinnedVertex) == 52, "SkinnedVertex must match SkinnedMesh::GetInputElements.");
+
+// GPU skinned mesh, the vertex shader blends up to four matrices of a bone palette held in a constant buffer.
+// Draw it with SkinnedVertexShader.hlsl and an input layout made from GetInputElements().
+struct SkinnedMesh
+{
+	enum : size_t
+	{
+		// Must match MAX_BONES in SkinnedVertexShader.hlsl
+		MaxBones = 64
+	};
+
+	struct CBPerObject
+	{
+		Float4x4 wvp;
+	};
+
+	struct CBBones
+	{
+		Float4x4 bones[MaxBones];
+	};
+
+	SkinnedMesh(const Device& device, const std::vector<SkinnedVertex>& vertices, const std::vector<UINT32>& indices)
+		: m_indexCount(indices.size())
+	{
+		m_vertexBuffer = Buffer::CreateVertexBuffer(device, vertices);
+		m_indexBuffer = Buffer::CreateIndexBuffer(device, indices);
+		m_constBuffer = Buffer::CreateConstantBuffer(device, sizeof(CBPerObject));
+		m_boneBuffer = Buffer::CreateConstantBuffer(device, sizeof(CBBones));
+	}
+
+	static std::vector<D3D11_INPUT_ELEMENT_DESC> GetInputElements()
+	{
+		return {
+			{"POSITION", 0, DXGI_FORMAT_R32G32B32_FLOAT, 0, 0, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"COLOR", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 12, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"BLENDINDICES", 0, DXGI_FORMAT_R16G16B16A16_UINT, 0, 28, D3D11_INPUT_PER_VERTEX_DATA, 0},
+			{"BLENDWEIGHT", 0, DXGI_FORMAT_R32G32B32A32_FLOAT, 0, 36, D3D11_INPUT_PER_VERTEX_DATA, 0}
+		};
+	}
+
+	void Destroy(const ComPtr<ID3D11DeviceContext>& context)
+	{
+		Buffer::DeleteBuffer(context, m_vertexBuffer);
+		Buffer::DeleteBuffer(context, m_indexBuffer);
+		Buffer::DeleteBuffer(context, m_constBuffer);
+		Buffer::DeleteBuffer(context, m_boneBuffer);
+	}
+
+	// palette comes from Animator, boneCount at most MaxBones. Matrices are transposed for HLSL like WVP.
+	void Update(const Device& device, const Float4x4& worldViewProjection, const Float4x4* palette,
+	            const size_t boneCount)
+	{
+		assert(boneCount <= MaxBones);
+		m_cbPerObject.wvp = VectorMath::Transpose(worldViewProjection);
+		VectorMath::TransposeBatch(palette, m_cbBones.bones, std::min<size_t>(boneCount, MaxBones));
+
+		const auto& context = device.GetDeviceContext();
+		context->UpdateSubresource(Buffer::GetBuffer(m_constBuffer), 0, nullptr, &m_cbPerObject, 0, 0);
+		context->UpdateSubresource(Buffer::GetBuffer(m_boneBuffer), 0, nullptr, &m_cbBones, 0, 0);
+	}
+
+	// Binds its buffers to the slots the skinned shader declares rather than through Buffer::BindBuffer,
+	// which hands out slots in bind order
+	void Render(const Renderer& renderer) const
+	{
+		const auto& context = renderer.GetDeviceContext();
+		Buffer::BindVertexBuffer(context, m_vertexBuffer, 0, sizeof(SkinnedVertex));
+		Buffer::BindIndexBuffer(context, m_indexBuffer);
+		Buffer::BindConstantBuffer(context, m_constBuffer, 0);
+		Buffer::BindConstantBuffer(context, m_boneBuffer, 1);
+		context->DrawIndexed(static_cast<UINT>(m_indexCount), 0, 0);
+	}
+
+private:
+	CBPerObject m_cbPerObject{};
+	CBBones m_cbBones{};
+
+	BufferId m_vertexBuffer;
+	BufferId m_indexBuffer;
+	BufferId m_constBuffer;
+	BufferId m_boneBuffer;
+	size_t m_indexCount;
+};
@@ -0,0 +1,34 @@
+struct VS_OUTPUT
+{
+	float4 Position : SV_POSITION;
+	float4 Color : COLOR;
+};
+
+// Must match SkinnedMesh::MaxBones
+#define MAX_BONES 64
+
+cbuffer CBPerObject : register(b0)
+{
+	float4x4 WVP;
+};
+
+// Skinning palette, model space matrices relative to the bind pose
+cbuffer CBBones : register(b1)
+{
+	float4x4 Bones[MAX_BONES];
+};
+
+VS_OUTPUT main( float4 pos : POSITION, float4 color : COLOR, uint4 bones : BLENDINDICES, float4 weights : BLENDWEIGHT )
+{
+	VS_OUTPUT output;
+
+	float4x4 skin = Bones[bones.x] * weights.x;
+	skin += Bones[bones.y] * weights.y;
+	skin += Bones[bones.z] * weights.z;
+	skin += Bones[bones.w] * weights.w;
+
+	output.Position = mul(mul(pos, skin), WVP);
+	output.Color = color;
+
+	return output;
+}
\ No newline at end of file
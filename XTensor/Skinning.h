@@ -0,0 +1,101 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <type_traits>
+
+#include "Simd.h"
+#include "VectorMath.h"
+
+// Up to four bones moving a vertex, the weights sum to one and unused slots have weight zero.
+// Laid out like the BLENDINDICES (R16G16B16A16_UINT) and BLENDWEIGHT (R32G32B32A32_FLOAT) vertex elements.
+struct SkinInfluence
+{
+	uint16_t bones[4];
+	float weights[4];
+};
+
+// Linear blend skinning on the CPU, for headless use where no GPU runs the skinned vertex shader.
+// The skinned position is position * (sum of weight * palette[bone]), the same as the shader computes.
+struct Skinning
+{
+	Skinning() = delete;
+
+	// positions and out point at the first float3 of a vertex and advance by their strides in bytes, so
+	// they can read and write interleaved vertex data. out may alias positions.
+	static void SkinPositions(const float* positions, const size_t positionStride,
+	                          const SkinInfluence* influences, const size_t influenceStride, const size_t count,
+	                          const Float4x4* palette, float* out, const size_t outStride)
+	{
+#if XT_SIMD_X86
+		if (Simd::HasAvx2())
+			return SkinPositionsAvx2(positions, positionStride, influences, influenceStride, count, palette, out,
+			                         outStride);
+#endif
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto& influence = *Advance(influences, i * influenceStride);
+			const auto* position = Advance(positions, i * positionStride);
+
+			// Rows 0-2 are enough, the palette is affine
+			float blended[4][3] = {};
+			for (auto k = 0; k < 4; ++k)
+			{
+				const auto weight = influence.weights[k];
+				const auto& bone = palette[influence.bones[k]];
+				for (auto row = 0; row < 4; ++row)
+					for (auto column = 0; column < 3; ++column)
+						blended[row][column] += weight * bone.m[row][column];
+			}
+
+			const auto x = position[0], y = position[1], z = position[2];
+			auto* result = Advance(out, i * outStride);
+			for (auto column = 0; column < 3; ++column)
+				result[column] = (x * blended[0][column] + z * blended[2][column]) + (y * blended[1][column] + blended[3][column]);
+		}
+	}
+
+private:
+	template <class T>
+	static T* Advance(T* ptr, const size_t bytes)
+	{
+		using Byte = typename std::conditional<std::is_const<T>::value, const uint8_t, uint8_t>::type;
+		return reinterpret_cast<T*>(reinterpret_cast<Byte*>(ptr) + bytes);
+	}
+
+#if XT_SIMD_X86
+	// One vertex per iteration: rows 0-1 and rows 2-3 of the four bones are blended in two registers,
+	// then (x, y) and (z, 1) weight them and the two halves are summed.
+	// No fused multiply-adds, the operation order is the scalar loop's so both return identical bits.
+	static XT_TARGET_AVX2_NOFMA void SkinPositionsAvx2(const float* positions, const size_t positionStride,
+	                                                   const SkinInfluence* influences, const size_t influenceStride,
+	                                                   const size_t count, const Float4x4* palette, float* out,
+	                                                   const size_t outStride)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto& influence = *Advance(influences, i * influenceStride);
+			const auto* position = Advance(positions, i * positionStride);
+
+			auto upper = _mm256_setzero_ps();
+			auto lower = _mm256_setzero_ps();
+			for (auto k = 0; k < 4; ++k)
+			{
+				const auto weight = _mm256_broadcast_ss(&influence.weights[k]);
+				const auto& bone = palette[influence.bones[k]];
+				upper = _mm256_add_ps(upper, _mm256_mul_ps(weight, _mm256_loadu_ps(bone.m[0])));
+				lower = _mm256_add_ps(lower, _mm256_mul_ps(weight, _mm256_loadu_ps(bone.m[2])));
+			}
+
+			const auto xy = _mm256_setr_m128(_mm_set1_ps(position[0]), _mm_set1_ps(position[1]));
+			const auto z1 = _mm256_setr_m128(_mm_set1_ps(position[2]), _mm_set1_ps(1.f));
+			const auto sum = _mm256_add_ps(_mm256_mul_ps(xy, upper), _mm256_mul_ps(z1, lower));
+			const auto result = _mm_add_ps(_mm256_castps256_ps128(sum), _mm256_extractf128_ps(sum, 1));
+
+			auto* target = Advance(out, i * outStride);
+			_mm_storel_pi(reinterpret_cast<__m64*>(target), result);
+			_mm_store_ss(target + 2, _mm_movehl_ps(result, result));
+		}
+	}
+#endif
+};
@@ -0,0 +1,267 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstring>
+#include <initializer_list>
+#include <memory>
+#include <numeric>
+#include <vector>
+
+#include "Simd.h"
+
+using TensorShape = std::vector<size_t>;
+using TensorStrides = std::vector<ptrdiff_t>;
+
+// N-dimensional float tensor over shared, 64 byte aligned storage
+// Slice/Transpose/Reshape/BroadcastTo return views that alias the same storage,
+// Clone and Contiguous are the only calls that copy
+struct Tensor
+{
+	Tensor() = default;
+
+	explicit Tensor(const TensorShape& shape)
+		: m_shape(shape), m_strides(ContiguousStrides(shape))
+	{
+		const auto size = GetSize();
+		auto data = static_cast<float*>(Simd::AlignedAlloc(std::max<size_t>(size, 1) * sizeof(float)));
+		std::memset(data, 0, size * sizeof(float));
+		m_storage = std::shared_ptr<float>(data, [](float* ptr) { Simd::AlignedFree(ptr); });
+		m_data = data;
+	}
+
+	Tensor(const TensorShape& shape, const float value)
+		: Tensor(shape)
+	{
+		std::fill(m_data, m_data + GetSize(), value);
+	}
+
+	Tensor(const TensorShape& shape, std::initializer_list<float> values)
+		: Tensor(shape)
+	{
+		assert(values.size() == GetSize() && "Value count does not match the shape.");
+		std::copy(values.begin(), values.end(), m_data);
+	}
+
+	static Tensor FromData(const TensorShape& shape, const float* data)
+	{
+		Tensor tensor(shape);
+		std::memcpy(tensor.m_data, data, tensor.GetSize() * sizeof(float));
+		return tensor;
+	}
+
+	// Wraps memory owned by the caller without copying, the memory must outlive every view
+	static Tensor Wrap(const TensorShape& shape, float* data)
+	{
+		Tensor tensor;
+		tensor.m_shape = shape;
+		tensor.m_strides = ContiguousStrides(shape);
+		tensor.m_data = data;
+		return tensor;
+	}
+
+	static TensorStrides ContiguousStrides(const TensorShape& shape)
+	{
+		TensorStrides strides(shape.size());
+		ptrdiff_t stride = 1;
+		for (auto i = shape.size(); i-- > 0;)
+		{
+			strides[i] = stride;
+			stride *= static_cast<ptrdiff_t>(shape[i]);
+		}
+		return strides;
+	}
+
+	// Numpy style broadcasting, trailing dimensions are aligned and must be equal or 1
+	static bool BroadcastShape(const TensorShape& a, const TensorShape& b, TensorShape& out)
+	{
+		const auto rank = std::max(a.size(), b.size());
+		out.assign(rank, 1);
+		for (size_t i = 0; i < rank; ++i)
+		{
+			const auto da = i < rank - a.size() ? 1 : a[i - (rank - a.size())];
+			const auto db = i < rank - b.size() ? 1 : b[i - (rank - b.size())];
+			if (da != db && da != 1 && db != 1)
+				return false;
+			out[i] = da == 1 ? db : da;
+		}
+		return true;
+	}
+
+	// Keeps every index in [begin, end) that is a multiple of step away from begin
+	Tensor Slice(const size_t dim, const size_t begin, const size_t end, const size_t step = 1) const
+	{
+		assert(dim < GetRank() && begin <= end && end <= m_shape[dim] && step > 0);
+		auto view = *this;
+		view.m_data = m_data + static_cast<ptrdiff_t>(begin) * m_strides[dim];
+		view.m_shape[dim] = (end - begin + step - 1) / step;
+		view.m_strides[dim] = m_strides[dim] * static_cast<ptrdiff_t>(step);
+		return view;
+	}
+
+	// Selects one index along dim and drops that dimension
+	Tensor Index(const size_t dim, const size_t index) const
+	{
+		assert(dim < GetRank() && index < m_shape[dim]);
+		auto view = *this;
+		view.m_data = m_data + static_cast<ptrdiff_t>(index) * m_strides[dim];
+		view.m_shape.erase(view.m_shape.begin() + dim);
+		view.m_strides.erase(view.m_strides.begin() + dim);
+		return view;
+	}
+
+	Tensor Transpose(const size_t dim0, const size_t dim1) const
+	{
+		assert(dim0 < GetRank() && dim1 < GetRank());
+		auto view = *this;
+		std::swap(view.m_shape[dim0], view.m_shape[dim1]);
+		std::swap(view.m_strides[dim0], view.m_strides[dim1]);
+		return view;
+	}
+
+	Tensor Permute(const std::vector<size_t>& order) const
+	{
+		assert(order.size() == GetRank());
+		auto view = *this;
+		for (size_t i = 0; i < order.size(); ++i)
+		{
+			view.m_shape[i] = m_shape[order[i]];
+			view.m_strides[i] = m_strides[order[i]];
+		}
+		return view;
+	}
+
+	// Views the data with a new shape, copies first when the tensor is not contiguous
+	Tensor Reshape(const TensorShape& shape) const
+	{
+		assert(Product(shape) == GetSize() && "Reshape must keep the element count.");
+		auto view = IsContiguous() ? *this : Contiguous();
+		view.m_shape = shape;
+		view.m_strides = ContiguousStrides(shape);
+		return view;
+	}
+
+	// Expands size 1 dimensions with a zero stride, missing leading dimensions are added
+	Tensor BroadcastTo(const TensorShape& shape) const
+	{
+		assert(shape.size() >= GetRank());
+		auto view = *this;
+		const auto offset = shape.size() - GetRank();
+		view.m_shape = shape;
+		view.m_strides.assign(shape.size(), 0);
+		for (size_t i = 0; i < GetRank(); ++i)
+		{
+			assert((m_shape[i] == shape[i + offset] || m_shape[i] == 1) && "Shapes are not broadcastable.");
+			view.m_strides[i + offset] = m_shape[i] == 1 ? 0 : m_strides[i];
+		}
+		return view;
+	}
+
+	Tensor Contiguous() const
+	{
+		if (IsContiguous())
+			return *this;
+		return Clone();
+	}
+
+	Tensor Clone() const
+	{
+		Tensor copy(m_shape);
+		if (IsContiguous())
+		{
+			std::memcpy(copy.m_data, m_data, GetSize() * sizeof(float));
+			return copy;
+		}
+
+		auto dst = copy.m_data;
+		ForEachRow([&](const float* src, const ptrdiff_t stride, const size_t count)
+		{
+			for (size_t i = 0; i < count; ++i)
+				*dst++ = src[static_cast<ptrdiff_t>(i) * stride];
+		});
+		return copy;
+	}
+
+	bool IsContiguous() const { return m_strides == ContiguousStrides(m_shape); }
+
+	// Calls func(rowPointer, innerStride, innerCount) for every innermost row in row-major order
+	template <class Func>
+	void ForEachRow(Func&& func) const
+	{
+		if (GetSize() == 0)
+			return;
+		if (GetRank() == 0)
+		{
+			func(static_cast<const float*>(m_data), ptrdiff_t{1}, size_t{1});
+			return;
+		}
+
+		const auto inner = m_shape.back();
+		const auto rows = GetSize() / inner;
+		for (size_t row = 0; row < rows; ++row)
+			func(static_cast<const float*>(RowPointer(row)), m_strides.back(), inner);
+	}
+
+	// Address of the first element of an innermost row given its flat row index.
+	// A rank-0 tensor is a single row holding its one element.
+	float* RowPointer(size_t row) const
+	{
+		if (GetRank() == 0)
+			return m_data;
+
+		auto ptr = m_data;
+		for (auto dim = GetRank() - 1; dim-- > 0;)
+		{
+			ptr += static_cast<ptrdiff_t>(row % m_shape[dim]) * m_strides[dim];
+			row /= m_shape[dim];
+		}
+		return ptr;
+	}
+
+	float& At(std::initializer_list<size_t> index)
+	{
+		return *(m_data + Offset(index));
+	}
+
+	float At(std::initializer_list<size_t> index) const
+	{
+		return *(m_data + Offset(index));
+	}
+
+	float* Data() { return m_data; }
+	const float* Data() const { return m_data; }
+
+	size_t GetRank() const { return m_shape.size(); }
+	size_t GetSize() const { return Product(m_shape); }
+	size_t GetDim(const size_t dim) const { return m_shape[dim]; }
+	const TensorShape& GetShape() const { return m_shape; }
+	const TensorStrides& GetStrides() const { return m_strides; }
+	bool IsEmpty() const { return m_data == nullptr; }
+
+private:
+	static size_t Product(const TensorShape& shape)
+	{
+		return std::accumulate(shape.begin(), shape.end(), size_t{1},
+		                       [](const size_t a, const size_t b) { return a * b; });
+	}
+
+	ptrdiff_t Offset(std::initializer_list<size_t> index) const
+	{
+		assert(index.size() == GetRank());
+		ptrdiff_t offset = 0;
+		size_t dim = 0;
+		for (const auto i : index)
+		{
+			assert(i < m_shape[dim]);
+			offset += static_cast<ptrdiff_t>(i) * m_strides[dim++];
+		}
+		return offset;
+	}
+
+private:
+	std::shared_ptr<float> m_storage;
+	float* m_data = nullptr;
+	TensorShape m_shape;
+	TensorStrides m_strides;
+};
@@ -0,0 +1,440 @@
+#pragma once
+
+#include <algorithm>
+#include <cassert>
+#include <cfloat>
+#include <utility>
+
+#include "Simd.h"
+#include "Tensor.h"
+#include "ThreadPool.h"
+
+// Elementwise operators for TensorOps::Map
+// Each one has a scalar call operator and an 8-wide Avx2 variant with the same arity,
+// so a whole expression like a * b + c runs as one fused pass over memory
+struct TensorOp
+{
+	TensorOp() = delete;
+
+	struct Add
+	{
+		float operator()(const float a, const float b) const { return a + b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_add_ps(a, b); }
+#endif
+	};
+
+	struct Sub
+	{
+		float operator()(const float a, const float b) const { return a - b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_sub_ps(a, b); }
+#endif
+	};
+
+	struct Mul
+	{
+		float operator()(const float a, const float b) const { return a * b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_mul_ps(a, b); }
+#endif
+	};
+
+	struct Div
+	{
+		float operator()(const float a, const float b) const { return a / b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_div_ps(a, b); }
+#endif
+	};
+
+	struct Max
+	{
+		float operator()(const float a, const float b) const { return a > b ? a : b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_max_ps(a, b); }
+#endif
+	};
+
+	struct Min
+	{
+		float operator()(const float a, const float b) const { return a < b ? a : b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_min_ps(a, b); }
+#endif
+	};
+
+	// a * b + c, the scalar path uses separate rounding so results may differ in the last bit
+	struct MulAdd
+	{
+		float operator()(const float a, const float b, const float c) const { return a * b + c; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b, const __m256 c) const
+		{
+			return _mm256_fmadd_ps(a, b, c);
+		}
+#endif
+	};
+
+	// a + (b - a) * t
+	struct Lerp
+	{
+		float operator()(const float a, const float b, const float t) const { return a + (b - a) * t; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b, const __m256 t) const
+		{
+			return _mm256_fmadd_ps(_mm256_sub_ps(b, a), t, a);
+		}
+#endif
+	};
+
+	// x * scale + bias, e.g. gain/offset on audio or normalizing pixel values
+	struct Affine
+	{
+		float scale;
+		float bias;
+
+		float operator()(const float x) const { return x * scale + bias; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 x) const
+		{
+			return _mm256_fmadd_ps(x, _mm256_set1_ps(scale), _mm256_set1_ps(bias));
+		}
+#endif
+	};
+
+	struct Clamp
+	{
+		float low;
+		float high;
+
+		float operator()(const float x) const { return x < low ? low : (x > high ? high : x); }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 x) const
+		{
+			return _mm256_min_ps(_mm256_max_ps(x, _mm256_set1_ps(low)), _mm256_set1_ps(high));
+		}
+#endif
+	};
+
+	struct Relu
+	{
+		float operator()(const float x) const { return x > 0.f ? x : 0.f; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 x) const { return _mm256_max_ps(x, _mm256_setzero_ps()); }
+#endif
+	};
+
+	// Reduction operators, Identity() is the neutral element
+	struct Sum
+	{
+		static float Identity() { return 0.f; }
+		float operator()(const float a, const float b) const { return a + b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_add_ps(a, b); }
+#endif
+	};
+
+	struct ReduceMax
+	{
+		static float Identity() { return -FLT_MAX; }
+		float operator()(const float a, const float b) const { return a > b ? a : b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_max_ps(a, b); }
+#endif
+	};
+
+	struct ReduceMin
+	{
+		static float Identity() { return FLT_MAX; }
+		float operator()(const float a, const float b) const { return a < b ? a : b; }
+#if XT_SIMD_X86
+		XT_TARGET_AVX2 __m256 Avx2(const __m256 a, const __m256 b) const { return _mm256_min_ps(a, b); }
+#endif
+	};
+};
+
+struct TensorOps
+{
+	TensorOps() = delete;
+
+	// Work below this many elements stays on the calling thread
+	static constexpr size_t ParallelThreshold = 1 << 15;
+
+	// Applies a TensorOp elementwise over broadcast inputs into a new tensor
+	template <class Op, class... Inputs>
+	static Tensor Map(const Op& op, const Inputs&... inputs)
+	{
+		TensorShape shape;
+		BroadcastAll(shape, inputs.GetShape()...);
+		Tensor out(shape);
+		MapInto(out, op, inputs...);
+		return out;
+	}
+
+	// Writes into an existing tensor or view, inputs are broadcast to its shape
+	// out may alias an input when both have the same layout
+	template <class Op, class... Inputs>
+	static void MapInto(Tensor& out, const Op& op, const Inputs&... inputs)
+	{
+		const Tensor views[] = {inputs.BroadcastTo(out.GetShape())...};
+		RunMap(out, op, views, std::index_sequence_for<Inputs...>{});
+	}
+
+	// Like Map but for arbitrary scalar callables without an Avx2 variant
+	template <class Func, class... Inputs>
+	static Tensor Transform(Func func, const Inputs&... inputs)
+	{
+		TensorShape shape;
+		BroadcastAll(shape, inputs.GetShape()...);
+		Tensor out(shape);
+		const Tensor views[] = {inputs.BroadcastTo(shape)...};
+		RunTransform(out, func, views, std::index_sequence_for<Inputs...>{});
+		return out;
+	}
+
+	static Tensor Add(const Tensor& a, const Tensor& b) { return Map(TensorOp::Add{}, a, b); }
+	static Tensor Sub(const Tensor& a, const Tensor& b) { return Map(TensorOp::Sub{}, a, b); }
+	static Tensor Mul(const Tensor& a, const Tensor& b) { return Map(TensorOp::Mul{}, a, b); }
+	static Tensor Div(const Tensor& a, const Tensor& b) { return Map(TensorOp::Div{}, a, b); }
+
+	static Tensor MulAdd(const Tensor& a, const Tensor& b, const Tensor& c)
+	{
+		return Map(TensorOp::MulAdd{}, a, b, c);
+	}
+
+	static Tensor Affine(const Tensor& x, const float scale, const float bias)
+	{
+		return Map(TensorOp::Affine{scale, bias}, x);
+	}
+
+	// Reduces every element to a single value
+	template <class Op>
+	static float Reduce(const Op& op, const Tensor& x)
+	{
+		const auto rows = RowCount(x);
+		const auto inner = x.GetRank() == 0 ? 1 : x.GetShape().back();
+		const auto stride = x.GetRank() == 0 ? 1 : x.GetStrides().back();
+
+		auto& pool = ThreadPool::GetDefault();
+		const auto grain = GrainFor(rows, inner, pool);
+		const auto chunks = (rows + grain - 1) / grain;
+
+		// One partial per chunk keeps the result independent of thread scheduling
+		std::vector<float> partials(chunks, Op::Identity());
+		pool.ParallelFor(rows, grain, [&](const size_t begin, const size_t end)
+		{
+			auto acc = Op::Identity();
+			for (auto row = begin; row < end; ++row)
+				acc = op(acc, ReduceRow(op, x.RowPointer(row), stride, inner));
+			partials[begin / grain] = acc;
+		});
+
+		auto result = Op::Identity();
+		for (const auto partial : partials)
+			result = op(result, partial);
+		return result;
+	}
+
+	// Reduces along one dimension, which is removed from the result shape
+	template <class Op>
+	static Tensor Reduce(const Op& op, const Tensor& x, const size_t dim)
+	{
+		assert(dim < x.GetRank());
+
+		// Move the reduced dimension innermost so every output element is one row
+		std::vector<size_t> order;
+		for (size_t i = 0; i < x.GetRank(); ++i)
+			if (i != dim)
+				order.push_back(i);
+		order.push_back(dim);
+		const auto view = x.Permute(order);
+
+		TensorShape shape(view.GetShape().begin(), view.GetShape().end() - 1);
+		Tensor out(shape);
+		const auto inner = view.GetShape().back();
+		const auto stride = view.GetStrides().back();
+		const auto rows = out.GetSize();
+
+		auto& pool = ThreadPool::GetDefault();
+		pool.ParallelFor(rows, GrainFor(rows, inner, pool), [&](const size_t begin, const size_t end)
+		{
+			for (auto row = begin; row < end; ++row)
+				out.Data()[row] = ReduceRow(op, view.RowPointer(row), stride, inner);
+		});
+		return out;
+	}
+
+	static float Sum(const Tensor& x) { return Reduce(TensorOp::Sum{}, x); }
+	static float Max(const Tensor& x) { return Reduce(TensorOp::ReduceMax{}, x); }
+	static float Min(const Tensor& x) { return Reduce(TensorOp::ReduceMin{}, x); }
+	static float Mean(const Tensor& x) { return Sum(x) / static_cast<float>(x.GetSize()); }
+
+	static Tensor Sum(const Tensor& x, const size_t dim) { return Reduce(TensorOp::Sum{}, x, dim); }
+	static Tensor Max(const Tensor& x, const size_t dim) { return Reduce(TensorOp::ReduceMax{}, x, dim); }
+	static Tensor Min(const Tensor& x, const size_t dim) { return Reduce(TensorOp::ReduceMin{}, x, dim); }
+
+	static Tensor Mean(const Tensor& x, const size_t dim)
+	{
+		auto sum = Sum(x, dim);
+		const auto scale = 1.f / static_cast<float>(x.GetDim(dim));
+		MapInto(sum, TensorOp::Affine{scale, 0.f}, sum);
+		return sum;
+	}
+
+private:
+	static void BroadcastAll(TensorShape&)
+	{
+	}
+
+	template <class... Shapes>
+	static void BroadcastAll(TensorShape& shape, const TensorShape& first, const Shapes&... rest)
+	{
+		TensorShape merged;
+		const auto ok = Tensor::BroadcastShape(shape, first, merged);
+		assert(ok && "Shapes are not broadcastable.");
+		(void)ok;
+		shape = merged;
+		BroadcastAll(shape, rest...);
+	}
+
+	static size_t RowCount(const Tensor& t)
+	{
+		if (t.GetRank() == 0)
+			return 1;
+		return t.GetShape().back() == 0 ? 0 : t.GetSize() / t.GetShape().back();
+	}
+
+	static size_t GrainFor(const size_t rows, const size_t inner, const ThreadPool& pool)
+	{
+		if (rows * inner < ParallelThreshold)
+			return std::max<size_t>(rows, 1);
+		const auto minRows = (ParallelThreshold / 4 + inner - 1) / std::max<size_t>(inner, 1);
+		const auto perThread = (rows + pool.GetThreadCount() * 4 - 1) / (pool.GetThreadCount() * 4);
+		return std::max<size_t>({minRows, perThread, size_t{1}});
+	}
+
+	template <class Op, size_t N, size_t... I>
+	static void RunMap(Tensor& out, const Op& op, const Tensor (&in)[N], std::index_sequence<I...>)
+	{
+		if (out.GetSize() == 0)
+			return;
+
+		const auto rows = RowCount(out);
+		const auto inner = out.GetRank() == 0 ? 1 : out.GetShape().back();
+		const auto outStride = out.GetRank() == 0 ? 1 : out.GetStrides().back();
+		ptrdiff_t strides[N + 1] = {(in[I].GetRank() == 0 ? 1 : in[I].GetStrides().back())...};
+
+		// Vector loads need unit or zero (broadcast) inner strides everywhere
+		auto vectorizable = outStride == 1 && Simd::HasAvx2();
+		for (size_t i = 0; i < N; ++i)
+			vectorizable = vectorizable && (strides[i] == 0 || strides[i] == 1);
+
+		auto& pool = ThreadPool::GetDefault();
+		pool.ParallelFor(rows, GrainFor(rows, inner, pool), [&](const size_t begin, const size_t end)
+		{
+			for (auto row = begin; row < end; ++row)
+			{
+				const float* src[N + 1] = {in[I].RowPointer(row)...};
+				auto dst = out.RowPointer(row);
+#if XT_SIMD_X86
+				if (vectorizable)
+				{
+					MapRowAvx2(op, dst, src, strides, inner, std::index_sequence<I...>{});
+					continue;
+				}
+#endif
+				for (size_t i = 0; i < inner; ++i)
+					dst[static_cast<ptrdiff_t>(i) * outStride] = op(src[I][static_cast<ptrdiff_t>(i) * strides[I]]...);
+			}
+		});
+	}
+
+	template <class Func, size_t N, size_t... I>
+	static void RunTransform(Tensor& out, Func& func, const Tensor (&in)[N], std::index_sequence<I...>)
+	{
+		if (out.GetSize() == 0)
+			return;
+
+		const auto rows = RowCount(out);
+		const auto inner = out.GetRank() == 0 ? 1 : out.GetShape().back();
+		ptrdiff_t strides[N + 1] = {(in[I].GetRank() == 0 ? 1 : in[I].GetStrides().back())...};
+
+		auto& pool = ThreadPool::GetDefault();
+		pool.ParallelFor(rows, GrainFor(rows, inner, pool), [&](const size_t begin, const size_t end)
+		{
+			for (auto row = begin; row < end; ++row)
+			{
+				const float* src[N + 1] = {in[I].RowPointer(row)...};
+				auto dst = out.RowPointer(row);
+				for (size_t i = 0; i < inner; ++i)
+					dst[i] = func(src[I][static_cast<ptrdiff_t>(i) * strides[I]]...);
+			}
+		});
+	}
+
+	template <class Op>
+	static float ReduceRow(const Op& op, const float* src, const ptrdiff_t stride, const size_t count)
+	{
+#if XT_SIMD_X86
+		if (stride == 1 && Simd::HasAvx2())
+			return ReduceRowAvx2(op, src, count);
+#endif
+		auto acc = Op::Identity();
+		for (size_t i = 0; i < count; ++i)
+			acc = op(acc, src[static_cast<ptrdiff_t>(i) * stride]);
+		return acc;
+	}
+
+#if XT_SIMD_X86
+	static XT_TARGET_AVX2 __m256 Load8(const float* src, const ptrdiff_t stride, const size_t i)
+	{
+		return stride == 0 ? _mm256_set1_ps(*src) : _mm256_loadu_ps(src + i);
+	}
+
+	template <class Op, size_t N, size_t... I>
+	static XT_TARGET_AVX2 void MapRowAvx2(const Op& op, float* dst, const float* const (&src)[N],
+	                                      const ptrdiff_t (&strides)[N], const size_t count,
+	                                      std::index_sequence<I...>)
+	{
+		size_t i = 0;
+		for (; i + 8 <= count; i += 8)
+			_mm256_storeu_ps(dst + i, op.Avx2(Load8(src[I], strides[I], i)...));
+		for (; i < count; ++i)
+			dst[i] = op(src[I][static_cast<ptrdiff_t>(i) * strides[I]]...);
+	}
+
+	// Four independent accumulators hide the add/max latency
+	template <class Op>
+	static XT_TARGET_AVX2 float ReduceRowAvx2(const Op& op, const float* src, const size_t count)
+	{
+		const auto identity = _mm256_set1_ps(Op::Identity());
+		auto acc0 = identity;
+		auto acc1 = identity;
+		auto acc2 = identity;
+		auto acc3 = identity;
+
+		size_t i = 0;
+		for (; i + 32 <= count; i += 32)
+		{
+			acc0 = op.Avx2(acc0, _mm256_loadu_ps(src + i));
+			acc1 = op.Avx2(acc1, _mm256_loadu_ps(src + i + 8));
+			acc2 = op.Avx2(acc2, _mm256_loadu_ps(src + i + 16));
+			acc3 = op.Avx2(acc3, _mm256_loadu_ps(src + i + 24));
+		}
+		for (; i + 8 <= count; i += 8)
+			acc0 = op.Avx2(acc0, _mm256_loadu_ps(src + i));
+
+		acc0 = op.Avx2(op.Avx2(acc0, acc1), op.Avx2(acc2, acc3));
+		alignas(32) float lanes[8];
+		_mm256_store_ps(lanes, acc0);
+
+		auto acc = Op::Identity();
+		for (const auto lane : lanes)
+			acc = op(acc, lane);
+		for (; i < count; ++i)
+			acc = op(acc, src[i]);
+		return acc;
+	}
+#endif
+};
@@ -0,0 +1,149 @@
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Fork/join pool for data parallel loops, the calling thread works alongside the workers
+// Nested ParallelFor calls from inside a job run inline on the current thread
+struct ThreadPool
+{
+	explicit ThreadPool(const size_t threadCount = std::max(1u, std::thread::hardware_concurrency()))
+	{
+		// The caller counts as one thread
+		for (size_t i = 1; i < threadCount; ++i)
+			m_workers.emplace_back([this] { WorkerLoop(); });
+	}
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	~ThreadPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_quit = true;
+		}
+		m_wake.notify_all();
+		for (auto& worker : m_workers)
+			worker.join();
+	}
+
+	// Calls func(begin, end) over [0, count) in chunks of at least grain items
+	template <class Func>
+	void ParallelFor(const size_t count, const size_t grain, Func&& func)
+	{
+		if (count == 0)
+			return;
+
+		const auto step = std::max<size_t>(grain, 1);
+		if (count <= step || m_workers.empty() || InsideJob())
+		{
+			func(size_t{0}, count);
+			return;
+		}
+
+		using FuncType = typename std::remove_reference<Func>::type;
+		Job job{};
+		job.context = const_cast<void*>(static_cast<const void*>(&func));
+		job.invoke = [](void* context, const size_t begin, const size_t end)
+		{
+			(*static_cast<FuncType*>(context))(begin, end);
+		};
+		job.count = count;
+		job.grain = step;
+
+		std::lock_guard<std::mutex> dispatch(m_dispatchMutex);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_job = &job;
+			m_finished = 0;
+			++m_generation;
+		}
+		m_wake.notify_all();
+
+		InsideJob() = true;
+		RunJob(job);
+		InsideJob() = false;
+
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_done.wait(lock, [this] { return m_finished == m_workers.size(); });
+		m_job = nullptr;
+	}
+
+	size_t GetThreadCount() const { return m_workers.size() + 1; }
+
+	static ThreadPool& GetDefault()
+	{
+		static ThreadPool pool;
+		return pool;
+	}
+
+private:
+	struct Job
+	{
+		void* context;
+		void (*invoke)(void*, size_t, size_t);
+		size_t count;
+		size_t grain;
+		std::atomic<size_t> next;
+	};
+
+	static void RunJob(Job& job)
+	{
+		for (;;)
+		{
+			const auto begin = job.next.fetch_add(job.grain, std::memory_order_relaxed);
+			if (begin >= job.count)
+				break;
+			job.invoke(job.context, begin, std::min(begin + job.grain, job.count));
+		}
+	}
+
+	void WorkerLoop()
+	{
+		InsideJob() = true;
+		size_t seen = 0;
+		for (;;)
+		{
+			Job* job;
+			{
+				std::unique_lock<std::mutex> lock(m_mutex);
+				m_wake.wait(lock, [&] { return m_quit || m_generation != seen; });
+				if (m_quit)
+					return;
+				seen = m_generation;
+				job = m_job;
+			}
+
+			RunJob(*job);
+
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				++m_finished;
+			}
+			m_done.notify_one();
+		}
+	}
+
+	static bool& InsideJob()
+	{
+		thread_local bool inside = false;
+		return inside;
+	}
+
+private:
+	std::vector<std::thread> m_workers;
+	std::mutex m_dispatchMutex;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	Job* m_job = nullptr;
+	size_t m_generation = 0;
+	size_t m_finished = 0;
+	bool m_quit = false;
+};
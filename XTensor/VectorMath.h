@@ -0,0 +1,538 @@
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include "Simd.h"
+
+struct Float3
+{
+	float x, y, z;
+};
+
+struct alignas(16) Float4
+{
+	float x, y, z, w;
+};
+
+// Row-major with the row vector convention (v' = v * M), the layout of DirectX::XMFLOAT4X4 and XMMATRIX
+struct alignas(16) Float4x4
+{
+	float m[4][4];
+
+	const float* Data() const { return &m[0][0]; }
+	float* Data() { return &m[0][0]; }
+};
+
+// Portable replacement for the DirectXMath calls used by Camera and WVP.
+// Multiply, Transpose, Inverse and Transform dispatch at runtime to AVX2, SSE or scalar code.
+// Every path evaluates the same expression tree without fused multiply-adds, so all levels return
+// identical bits and the scalar path is the reference. That holds as long as the compiler does not
+// contract the scalar code itself: MSVC /fp:precise does not, GCC with FMA enabled needs -ffp-contract=off.
+// Multiply and Transform use the operation order of DirectXMath's SSE XMMatrixMultiply,
+// (x * r0 + z * r2) + (y * r1 + w * r3).
+// The constructors are scalar, they run once per object and not per vertex.
+struct VectorMath
+{
+	VectorMath() = delete;
+
+	static Float4x4 Identity()
+	{
+		return Float4x4{{{1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}, {0.f, 0.f, 0.f, 1.f}}};
+	}
+
+	static Float4x4 Translation(const float x, const float y, const float z)
+	{
+		return Float4x4{{{1.f, 0.f, 0.f, 0.f}, {0.f, 1.f, 0.f, 0.f}, {0.f, 0.f, 1.f, 0.f}, {x, y, z, 1.f}}};
+	}
+
+	static Float4x4 Scaling(const float x, const float y, const float z)
+	{
+		return Float4x4{{{x, 0.f, 0.f, 0.f}, {0.f, y, 0.f, 0.f}, {0.f, 0.f, z, 0.f}, {0.f, 0.f, 0.f, 1.f}}};
+	}
+
+	// Rotation of angle radians around axis, clockwise when looking along the axis towards the origin (left handed)
+	static Float4x4 RotationAxis(const Float3& axis, const float angle)
+	{
+		const auto n = Normalize(axis);
+		const auto s = std::sin(angle);
+		const auto c = std::cos(angle);
+		const auto t = 1.f - c;
+
+		const auto yz = t * (n.y * n.z), zx = t * (n.z * n.x), xy = t * (n.x * n.y);
+		return Float4x4{{
+			{t * (n.x * n.x) + c, xy + s * n.z, zx - s * n.y, 0.f},
+			{xy - s * n.z, t * (n.y * n.y) + c, yz + s * n.x, 0.f},
+			{zx + s * n.y, yz - s * n.x, t * (n.z * n.z) + c, 0.f},
+			{0.f, 0.f, 0.f, 1.f}
+		}};
+	}
+
+	// q is a unit quaternion (x, y, z, w), the rotation matches RotationAxis for the same axis and angle
+	static Float4x4 RotationQuaternion(const Float4& q)
+	{
+		const auto xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+		const auto xy = q.x * q.y, zx = q.z * q.x, yz = q.y * q.z;
+		const auto xw = q.x * q.w, yw = q.y * q.w, zw = q.z * q.w;
+		return Float4x4{{
+			{1.f - 2.f * (yy + zz), 2.f * (xy + zw), 2.f * (zx - yw), 0.f},
+			{2.f * (xy - zw), 1.f - 2.f * (xx + zz), 2.f * (yz + xw), 0.f},
+			{2.f * (zx + yw), 2.f * (yz - xw), 1.f - 2.f * (xx + yy), 0.f},
+			{0.f, 0.f, 0.f, 1.f}
+		}};
+	}
+
+	static Float4 QuaternionRotationAxis(const Float3& axis, const float angle)
+	{
+		const auto n = Normalize(axis);
+		const auto s = std::sin(0.5f * angle);
+		return Float4{n.x * s, n.y * s, n.z * s, std::cos(0.5f * angle)};
+	}
+
+	// a then b, the quaternion counterpart of Multiply(RotationQuaternion(a), RotationQuaternion(b))
+	static Float4 QuaternionMultiply(const Float4& a, const Float4& b)
+	{
+		return Float4{
+			b.w * a.x + b.x * a.w + b.y * a.z - b.z * a.y,
+			b.w * a.y - b.x * a.z + b.y * a.w + b.z * a.x,
+			b.w * a.z + b.x * a.y - b.y * a.x + b.z * a.w,
+			b.w * a.w - b.x * a.x - b.y * a.y - b.z * a.z
+		};
+	}
+
+	static Float4x4 LookAtLH(const Float3& eye, const Float3& target, const Float3& up)
+	{
+		const auto forward = Normalize(Subtract(target, eye));
+		const auto right = Normalize(Cross(up, forward));
+		const auto newUp = Cross(forward, right);
+		const auto negEye = Float3{-eye.x, -eye.y, -eye.z};
+
+		return Float4x4{{
+			{right.x, newUp.x, forward.x, 0.f},
+			{right.y, newUp.y, forward.y, 0.f},
+			{right.z, newUp.z, forward.z, 0.f},
+			{Dot(right, negEye), Dot(newUp, negEye), Dot(forward, negEye), 1.f}
+		}};
+	}
+
+	// D3D clip space, depth maps near to 0 and far to 1
+	static Float4x4 PerspectiveFovLH(const float fovY, const float aspect, const float nearZ, const float farZ)
+	{
+		const auto height = std::cos(0.5f * fovY) / std::sin(0.5f * fovY);
+		const auto width = height / aspect;
+		const auto range = farZ / (farZ - nearZ);
+
+		return Float4x4{{
+			{width, 0.f, 0.f, 0.f},
+			{0.f, height, 0.f, 0.f},
+			{0.f, 0.f, range, 1.f},
+			{0.f, 0.f, -range * nearZ, 0.f}
+		}};
+	}
+
+	static float Dot(const Float3& a, const Float3& b) { return (a.x * b.x + a.y * b.y) + a.z * b.z; }
+
+	static Float3 Cross(const Float3& a, const Float3& b)
+	{
+		return Float3{a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+	}
+
+	static Float3 Subtract(const Float3& a, const Float3& b) { return Float3{a.x - b.x, a.y - b.y, a.z - b.z}; }
+
+	// A zero vector stays zero
+	static Float3 Normalize(const Float3& v)
+	{
+		const auto length = std::sqrt(Dot(v, v));
+		if (length == 0.f)
+			return v;
+		return Float3{v.x / length, v.y / length, v.z / length};
+	}
+
+	// a * b, applies a first then b
+	static Float4x4 Multiply(const Float4x4& a, const Float4x4& b)
+	{
+		Float4x4 result;
+		MultiplyBatch(&a, &b, &result, 1);
+		return result;
+	}
+
+	static Float4x4 Transpose(const Float4x4& m)
+	{
+		Float4x4 result;
+		TransposeBatch(&m, &result, 1);
+		return result;
+	}
+
+	// Cofactor expansion over 2x2 sub-determinants. A singular matrix yields inf/NaN like XMMatrixInverse.
+	static Float4x4 Inverse(const Float4x4& m, float* determinant = nullptr)
+	{
+		Float4x4 result;
+		float det;
+		InverseBatch(&m, &result, 1, &det);
+		if (determinant)
+			*determinant = det;
+		return result;
+	}
+
+	static Float4 Transform(const Float4& v, const Float4x4& m)
+	{
+		Float4 result;
+		TransformBatch(&v, m, &result, 1);
+		return result;
+	}
+
+	// out[i] = a[i] * b[i], out may alias a or b
+	static void MultiplyBatch(const Float4x4* a, const Float4x4* b, Float4x4* out, const size_t count)
+	{
+		MultiplyDispatch(a, b, 1, out, count);
+	}
+
+	// out[i] = a[i] * b, e.g. every world matrix times one view-projection
+	static void MultiplyBatch(const Float4x4* a, const Float4x4& b, Float4x4* out, const size_t count)
+	{
+		MultiplyDispatch(a, &b, 0, out, count);
+	}
+
+	static void TransposeBatch(const Float4x4* in, Float4x4* out, const size_t count)
+	{
+#if XT_SIMD_X86
+		if (Level() != SimdLevel::Scalar)
+			return TransposeSse(in, out, count);
+#endif
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto m = in[i];
+			for (auto row = 0; row < 4; ++row)
+				for (auto column = 0; column < 4; ++column)
+					out[i].m[row][column] = m.m[column][row];
+		}
+	}
+
+	// determinants may be null
+	static void InverseBatch(const Float4x4* in, Float4x4* out, const size_t count, float* determinants = nullptr)
+	{
+#if XT_SIMD_X86
+		if (Level() != SimdLevel::Scalar)
+			return InverseSse(in, out, count, determinants);
+#endif
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto det = InverseScalar(in[i], out[i]);
+			if (determinants)
+				determinants[i] = det;
+		}
+	}
+
+	// out[i] = in[i] * m, out may alias in
+	static void TransformBatch(const Float4* in, const Float4x4& m, Float4* out, const size_t count)
+	{
+#if XT_SIMD_X86
+		const auto level = Level();
+		if (level == SimdLevel::Avx2)
+			return TransformAvx2(in, m, out, count);
+		if (level == SimdLevel::Sse41)
+			return TransformSse(in, m, out, count);
+#endif
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto v = in[i];
+			float result[4];
+			for (auto column = 0; column < 4; ++column)
+				result[column] = (v.x * m.m[0][column] + v.z * m.m[2][column]) + (v.y * m.m[1][column] + v.w * m.m[3][column]);
+			out[i] = Float4{result[0], result[1], result[2], result[3]};
+		}
+	}
+
+private:
+	// Inverse and Transpose gain nothing from 256-bit lanes, their Avx2 level runs the SSE kernels.
+	// The batch loops live inside the target functions, GCC does not inline those into generic code.
+	static SimdLevel Level() { return Simd::GetLevel(); }
+
+	static void MultiplyDispatch(const Float4x4* a, const Float4x4* b, const size_t bStep, Float4x4* out,
+	                             const size_t count)
+	{
+#if XT_SIMD_X86
+		const auto level = Level();
+		if (level == SimdLevel::Avx2)
+			return MultiplyAvx2(a, b, bStep, out, count);
+		if (level == SimdLevel::Sse41)
+			return MultiplySse(a, b, bStep, out, count);
+#endif
+		for (size_t i = 0; i < count; ++i)
+			MultiplyScalar(a[i], b[i * bStep], out[i]);
+	}
+
+	static void MultiplyScalar(const Float4x4& a, const Float4x4& b, Float4x4& out)
+	{
+		Float4x4 result;
+		for (auto row = 0; row < 4; ++row)
+		{
+			const auto x = a.m[row][0], y = a.m[row][1], z = a.m[row][2], w = a.m[row][3];
+			for (auto column = 0; column < 4; ++column)
+				result.m[row][column] = (x * b.m[0][column] + z * b.m[2][column]) + (y * b.m[1][column] + w * b.m[3][column]);
+		}
+		out = result;
+	}
+
+	// Row i of the inverse is ((P * A - Q * B) + R * C) / det, where P, Q and R are signed columns of m
+	// with rows in the order 1, 0, 3, 2, and A, B and C pair a lower and an upper 2x2 sub-determinant.
+	// The scalar and SSE versions walk the same table lane by lane.
+	struct InverseTerms
+	{
+		int p, q, r;
+		int a, b, c;
+		bool negateEven;
+	};
+
+	static const InverseTerms& Terms(const int row)
+	{
+		static const InverseTerms terms[4] = {
+			{1, 2, 3, 5, 4, 3, false},
+			{0, 2, 3, 5, 2, 1, true},
+			{0, 1, 3, 4, 2, 0, false},
+			{0, 1, 2, 3, 1, 0, true}
+		};
+		return terms[row];
+	}
+
+	// Sub-determinants of rows 0-1 (upper) and rows 2-3 (lower) over column pairs
+	// 01, 02, 03, 12, 13, 23. Pair k of the upper rows meets pair 5 - k of the lower rows.
+	static float Determinant(const float* upper, const float* lower)
+	{
+		return ((((upper[0] * lower[5] - upper[1] * lower[4]) + upper[2] * lower[3]) + upper[3] * lower[2]) -
+			upper[4] * lower[1]) + upper[5] * lower[0];
+	}
+
+	static float InverseScalar(const Float4x4& in, Float4x4& out)
+	{
+		const auto& m = in.m;
+		static const int pairs[6][2] = {{0, 1}, {0, 2}, {0, 3}, {1, 2}, {1, 3}, {2, 3}};
+		float upper[6], lower[6];
+		for (auto k = 0; k < 6; ++k)
+		{
+			const auto j = pairs[k][0], l = pairs[k][1];
+			upper[k] = m[0][j] * m[1][l] - m[1][j] * m[0][l];
+			lower[k] = m[2][j] * m[3][l] - m[3][j] * m[2][l];
+		}
+
+		const auto det = Determinant(upper, lower);
+		const auto invDet = 1.f / det;
+		static const int order[4] = {1, 0, 3, 2};
+
+		Float4x4 result;
+		for (auto row = 0; row < 4; ++row)
+		{
+			const auto& t = Terms(row);
+			for (auto lane = 0; lane < 4; ++lane)
+			{
+				const auto negate = (lane % 2 == 0) == t.negateEven;
+				const auto sign = negate ? -1.f : 1.f;
+				const auto p = sign * m[order[lane]][t.p];
+				const auto q = sign * m[order[lane]][t.q];
+				const auto r = sign * m[order[lane]][t.r];
+				// Lanes 0-1 take the lower sub-determinants, lanes 2-3 the upper ones
+				const auto* sub = lane < 2 ? lower : upper;
+				result.m[row][lane] = ((p * sub[t.a] - q * sub[t.b]) + r * sub[t.c]) * invDet;
+			}
+		}
+		out = result;
+		return det;
+	}
+
+#if XT_SIMD_X86
+	static XT_TARGET_SSE41 void MultiplySse(const Float4x4* a, const Float4x4* b, const size_t bStep, Float4x4* out,
+	                                        const size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			MultiplySse(a[i], b[i * bStep], out[i]);
+	}
+
+	static XT_TARGET_SSE41 void MultiplySse(const Float4x4& a, const Float4x4& b, Float4x4& out)
+	{
+		const auto b0 = _mm_load_ps(b.m[0]);
+		const auto b1 = _mm_load_ps(b.m[1]);
+		const auto b2 = _mm_load_ps(b.m[2]);
+		const auto b3 = _mm_load_ps(b.m[3]);
+		__m128 rows[4];
+		for (auto row = 0; row < 4; ++row)
+		{
+			const auto v = _mm_load_ps(a.m[row]);
+			const auto x = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			const auto y = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), b1);
+			const auto z = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), b2);
+			const auto w = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), b3);
+			rows[row] = _mm_add_ps(_mm_add_ps(x, z), _mm_add_ps(y, w));
+		}
+		for (auto row = 0; row < 4; ++row)
+			_mm_store_ps(out.m[row], rows[row]);
+	}
+
+	// Two rows per register, the 128-bit lane shuffles splat each row's own x, y, z and w
+	static XT_TARGET_AVX2_NOFMA void MultiplyAvx2(const Float4x4* a, const Float4x4* b, const size_t bStep,
+	                                              Float4x4* out, const size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+			MultiplyAvx2(a[i], b[i * bStep], out[i]);
+	}
+
+	static XT_TARGET_AVX2_NOFMA void MultiplyAvx2(const Float4x4& a, const Float4x4& b, Float4x4& out)
+	{
+		const auto b0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[0]));
+		const auto b1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[1]));
+		const auto b2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[2]));
+		const auto b3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(b.m[3]));
+		__m256 rows[2];
+		for (auto half = 0; half < 2; ++half)
+		{
+			const auto v = _mm256_loadu_ps(a.m[half * 2]);
+			const auto x = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+			const auto y = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), b1);
+			const auto z = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), b2);
+			const auto w = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), b3);
+			rows[half] = _mm256_add_ps(_mm256_add_ps(x, z), _mm256_add_ps(y, w));
+		}
+		_mm256_storeu_ps(out.m[0], rows[0]);
+		_mm256_storeu_ps(out.m[2], rows[1]);
+	}
+
+	static XT_TARGET_SSE41 void TransposeSse(const Float4x4* in, Float4x4* out, const size_t count)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			auto r0 = _mm_load_ps(in[i].m[0]);
+			auto r1 = _mm_load_ps(in[i].m[1]);
+			auto r2 = _mm_load_ps(in[i].m[2]);
+			auto r3 = _mm_load_ps(in[i].m[3]);
+			_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+			_mm_store_ps(out[i].m[0], r0);
+			_mm_store_ps(out[i].m[1], r1);
+			_mm_store_ps(out[i].m[2], r2);
+			_mm_store_ps(out[i].m[3], r3);
+		}
+	}
+
+	static XT_TARGET_SSE41 void TransformSse(const Float4* in, const Float4x4& m, Float4* out, const size_t count)
+	{
+		const auto m0 = _mm_load_ps(m.m[0]);
+		const auto m1 = _mm_load_ps(m.m[1]);
+		const auto m2 = _mm_load_ps(m.m[2]);
+		const auto m3 = _mm_load_ps(m.m[3]);
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto v = _mm_load_ps(&in[i].x);
+			const auto x = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), m0);
+			const auto y = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), m1);
+			const auto z = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), m2);
+			const auto w = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), m3);
+			_mm_store_ps(&out[i].x, _mm_add_ps(_mm_add_ps(x, z), _mm_add_ps(y, w)));
+		}
+	}
+
+	// Two vectors per register, an odd last one through 128-bit lanes
+	static XT_TARGET_AVX2_NOFMA void TransformAvx2(const Float4* in, const Float4x4& m, Float4* out, const size_t count)
+	{
+		const auto m0 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m.m[0]));
+		const auto m1 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m.m[1]));
+		const auto m2 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m.m[2]));
+		const auto m3 = _mm256_broadcast_ps(reinterpret_cast<const __m128*>(m.m[3]));
+		size_t i = 0;
+		for (; i + 2 <= count; i += 2)
+		{
+			const auto v = _mm256_loadu_ps(&in[i].x);
+			const auto x = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), m0);
+			const auto y = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), m1);
+			const auto z = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), m2);
+			const auto w = _mm256_mul_ps(_mm256_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), m3);
+			_mm256_storeu_ps(&out[i].x, _mm256_add_ps(_mm256_add_ps(x, z), _mm256_add_ps(y, w)));
+		}
+		if (i < count)
+		{
+			const auto v = _mm_load_ps(&in[i].x);
+			const auto x = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(0, 0, 0, 0)), _mm256_castps256_ps128(m0));
+			const auto y = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 1, 1, 1)), _mm256_castps256_ps128(m1));
+			const auto z = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 2, 2)), _mm256_castps256_ps128(m2));
+			const auto w = _mm_mul_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 3, 3)), _mm256_castps256_ps128(m3));
+			_mm_store_ps(&out[i].x, _mm_add_ps(_mm_add_ps(x, z), _mm_add_ps(y, w)));
+		}
+	}
+
+	static XT_TARGET_SSE41 void InverseSse(const Float4x4* in, Float4x4* out, const size_t count, float* determinants)
+	{
+		for (size_t i = 0; i < count; ++i)
+		{
+			const auto det = InverseSse(in[i], out[i]);
+			if (determinants)
+				determinants[i] = det;
+		}
+	}
+
+	static XT_TARGET_SSE41 float InverseSse(const Float4x4& in, Float4x4& out)
+	{
+		const auto r0 = _mm_load_ps(in.m[0]);
+		const auto r1 = _mm_load_ps(in.m[1]);
+		const auto r2 = _mm_load_ps(in.m[2]);
+		const auto r3 = _mm_load_ps(in.m[3]);
+
+		// Column pairs 01 02 03 12 in one register and 13 23 in the low half of another
+		float upper[8], lower[8];
+		_mm_storeu_ps(upper, SubDeterminants0(r0, r1));
+		_mm_storeu_ps(upper + 4, SubDeterminants1(r0, r1));
+		_mm_storeu_ps(lower, SubDeterminants0(r2, r3));
+		_mm_storeu_ps(lower + 4, SubDeterminants1(r2, r3));
+
+		const auto det = Determinant(upper, lower);
+		const auto invDet = _mm_set1_ps(1.f / det);
+
+		__m128 pairs[6];
+		for (auto k = 0; k < 6; ++k)
+			pairs[k] = _mm_setr_ps(lower[k], lower[k], upper[k], upper[k]);
+
+		// Columns with rows reordered 1, 0, 3, 2
+		auto c0 = r0, c1 = r1, c2 = r2, c3 = r3;
+		_MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+		const __m128 columns[4] = {
+			_mm_shuffle_ps(c0, c0, _MM_SHUFFLE(2, 3, 0, 1)),
+			_mm_shuffle_ps(c1, c1, _MM_SHUFFLE(2, 3, 0, 1)),
+			_mm_shuffle_ps(c2, c2, _MM_SHUFFLE(2, 3, 0, 1)),
+			_mm_shuffle_ps(c3, c3, _MM_SHUFFLE(2, 3, 0, 1))
+		};
+		const auto negateOdd = _mm_castsi128_ps(_mm_setr_epi32(0, static_cast<int>(0x80000000), 0, static_cast<int>(0x80000000)));
+		const auto negateEven = _mm_castsi128_ps(_mm_setr_epi32(static_cast<int>(0x80000000), 0, static_cast<int>(0x80000000), 0));
+
+		__m128 rows[4];
+		for (auto row = 0; row < 4; ++row)
+		{
+			const auto& t = Terms(row);
+			const auto sign = t.negateEven ? negateEven : negateOdd;
+			const auto p = _mm_xor_ps(columns[t.p], sign);
+			const auto q = _mm_xor_ps(columns[t.q], sign);
+			const auto r = _mm_xor_ps(columns[t.r], sign);
+			const auto sum = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(p, pairs[t.a]), _mm_mul_ps(q, pairs[t.b])), _mm_mul_ps(r, pairs[t.c]));
+			rows[row] = _mm_mul_ps(sum, invDet);
+		}
+		for (auto row = 0; row < 4; ++row)
+			_mm_store_ps(out.m[row], rows[row]);
+		return det;
+	}
+
+	// a[j] * b[l] - b[j] * a[l] for the pairs 01 02 03 12
+	static XT_TARGET_SSE41 __m128 SubDeterminants0(const __m128 a, const __m128 b)
+	{
+		const auto aj = _mm_shuffle_ps(a, a, _MM_SHUFFLE(1, 0, 0, 0));
+		const auto al = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2, 3, 2, 1));
+		const auto bj = _mm_shuffle_ps(b, b, _MM_SHUFFLE(1, 0, 0, 0));
+		const auto bl = _mm_shuffle_ps(b, b, _MM_SHUFFLE(2, 3, 2, 1));
+		return _mm_sub_ps(_mm_mul_ps(aj, bl), _mm_mul_ps(bj, al));
+	}
+
+	// The same for the pairs 13 23, the upper lanes are unused
+	static XT_TARGET_SSE41 __m128 SubDeterminants1(const __m128 a, const __m128 b)
+	{
+		const auto aj = _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 2, 1));
+		const auto al = _mm_shuffle_ps(a, a, _MM_SHUFFLE(0, 0, 3, 3));
+		const auto bj = _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 2, 1));
+		const auto bl = _mm_shuffle_ps(b, b, _MM_SHUFFLE(0, 0, 3, 3));
+		return _mm_sub_ps(_mm_mul_ps(aj, bl), _mm_mul_ps(bj, al));
+	}
+#endif
+};
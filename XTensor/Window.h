@@ -46,6 +46,7 @@ struct Window
 
 	HWND GetWindow() const { return m_window; }
 	const Device& GetDevice() const { return m_device; }
+	Device& GetDevice() { return m_device; }
 
 	int width;
 	int height;